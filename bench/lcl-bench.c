@@ -0,0 +1,111 @@
+/*
+ * lcl-bench: run an LCL script a few times and report how long it took.
+ *
+ *   lcl-bench [-c] <script.lcl> [runs]
+ *
+ * Each run gets a fresh interpreter, so the numbers include startup and
+ * compilation of the script itself.  With -c the script is precompiled to
+ * an image first and the runs load that instead.  Times are CPU seconds
+ * from clock().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lcl.h"
+
+static int run_once(const char *path, double *secs) {
+  lcl_interp *interp;
+  lcl_value *result = NULL;
+  clock_t start;
+  int rc;
+
+  interp = lcl_interp_new();
+
+  if (!interp) {
+    fprintf(stderr, "lcl-bench: failed to create interpreter\n");
+    return 0;
+  }
+
+  lcl_register_core(interp);
+
+  start = clock();
+  rc = lcl_eval_file(interp, path, &result);
+  *secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  if (rc != LCL_RC_OK) {
+    fprintf(stderr, "lcl-bench: %s failed at line %d\n", path,
+            lcl_interp_error_line(interp));
+  }
+
+  if (result) lcl_ref_dec(result);
+  lcl_interp_free(interp);
+
+  return rc == LCL_RC_OK;
+}
+
+int main(int argc, char **argv) {
+  const char *path;
+  char image[1024];
+  int precompile = 0;
+  int runs = 3;
+  int i;
+  double best = 0.0;
+  double total = 0.0;
+
+  if (argc > 1 && strcmp(argv[1], "-c") == 0) {
+    precompile = 1;
+    argc--;
+    argv++;
+  }
+
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "Usage: lcl-bench [-c] <script.lcl> [runs]\n");
+    return 1;
+  }
+
+  if (argc == 3) {
+    runs = atoi(argv[2]);
+
+    if (runs < 1) runs = 1;
+  }
+
+  path = argv[1];
+
+  if (precompile) {
+    if (strlen(path) + 2 > sizeof(image)) {
+      fprintf(stderr, "lcl-bench: path too long\n");
+      return 1;
+    }
+
+    sprintf(image, "%sc", path);
+
+    if (lcl_compile_file(path, image) != LCL_OK) {
+      fprintf(stderr, "lcl-bench: failed to compile %s\n", path);
+      return 1;
+    }
+
+    path = image;
+  }
+
+  for (i = 0; i < runs; i++) {
+    double secs;
+
+    if (!run_once(path, &secs)) {
+      if (precompile) remove(image);
+      return 1;
+    }
+
+    if (i == 0 || secs < best) best = secs;
+    total += secs;
+  }
+
+  if (precompile) remove(image);
+
+  printf("%s: best %.4fs, mean %.4fs over %d run%s\n", path, best,
+         total / runs, runs, runs == 1 ? "" : "s");
+
+  return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * LCL - memory types
+ *
+ * The allocator hook and memory counters of the public API (lcl.h),
+ * kept apart so the library's own sources share the one definition.
+ */
+
+#ifndef LCL_MEMORY_H
+#define LCL_MEMORY_H
+
+#include <stddef.h>
+
+/* Where an interpreter's memory comes from (lcl_interp_new_with_allocator) */
+typedef struct {
+  void *(*alloc)(void *ctx, size_t n);             /* like malloc */
+  void *(*resize)(void *ctx, void *p, size_t n);   /* like realloc */
+  void (*release)(void *ctx, void *p);             /* like free */
+  void *ctx;                                       /* passed to each */
+  size_t limit;                                    /* bytes, 0 for none */
+} lcl_allocator;
+
+/* What an interpreter has taken from its allocator (lcl_interp_memory_stats) */
+typedef struct {
+  size_t live;              /* bytes held now, bookkeeping included */
+  size_t peak;              /* most ever held at once */
+  size_t limit;             /* the allocator's limit */
+  unsigned long failures;   /* allocations refused or failed */
+  unsigned long allocs;     /* allocations and resizes asked for */
+} lcl_memory_stats;
+
+/* An interpreter's compile cache (lcl_interp_compile_cache_stats) */
+typedef struct {
+  unsigned long hits;    /* lookups answered from the cache */
+  unsigned long misses;  /* lookups that had to compile */
+  size_t entries;        /* scripts currently cached */
+  size_t bytes;          /* approximate memory held by the cache */
+  size_t limit;          /* current byte budget */
+} lcl_cache_stats;
+
+/* An interpreter's value slab (lcl_slab_get_stats) */
+typedef struct {
+  unsigned long allocs;  /* headers handed out */
+  unsigned long frees;   /* headers given back */
+  size_t live;           /* headers in use now */
+  size_t chunks;         /* chunks held */
+  size_t bytes;          /* memory held by those chunks */
+  size_t chunk;          /* headers per new chunk */
+} lcl_slab_stats;
+
+#endif
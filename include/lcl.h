@@ -21,6 +21,8 @@
 
 #include <stddef.h>
 
+#include "lcl-memory.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -97,13 +99,113 @@ int lcl_eval_string(lcl_interp *interp, const char *src, lcl_value **out);
  *
  * Parameters:
  *   interp - the interpreter
- *   path   - path to the .lcl file
+ *   path   - path to the .lcl file, or to an image from lcl_compile_file
  *   out    - receives the result value (caller must lcl_ref_dec it)
  *
+ * If <path>c is an image built from the current contents of path, it is
+ * run instead, skipping the parser.
+ *
  * Returns LCL_RC_OK on success, LCL_RC_ERR on error.
  */
 int lcl_eval_file(lcl_interp *interp, const char *path, lcl_value **out);
 
+/*
+ * Precompile an LCL file to an image (.lclc) for faster startup.
+ *
+ * Parameters:
+ *   path     - path to the .lcl file
+ *   out_path - where to write the image, or NULL for <path>c
+ *
+ * The image records the format version and a hash of the source, so a
+ * stale or foreign image is never picked up in place of its source.
+ *
+ * Returns LCL_OK on success, LCL_ERROR if the file cannot be read,
+ * does not compile, or the image cannot be written.
+ */
+lcl_result lcl_compile_file(const char *path, const char *out_path);
+
+/* ============================================================================
+ * Compile Cache
+ *
+ * eval, subst and lcl_eval_string keep recently compiled scripts in a
+ * per-interpreter LRU cache keyed by source text, so evaluating the same
+ * text again skips parsing entirely. The cache is bounded by an
+ * approximate byte budget (1 MiB by default).
+ *
+ * lcl_cache_stats is defined in lcl-memory.h.
+ * ============================================================================ */
+
+/*
+ * Set the compile cache budget in bytes, evicting old entries as needed.
+ * A budget of 0 empties and disables the cache.
+ */
+void lcl_interp_set_compile_cache(lcl_interp *interp, size_t max_bytes);
+
+/*
+ * Read the compile cache counters.
+ */
+void lcl_interp_compile_cache_stats(lcl_interp *interp, lcl_cache_stats *out);
+
+/* ============================================================================
+ * Value Allocator
+ *
+ * Each interpreter takes value headers from a slab of its own: chunks
+ * of LCL_SLAB_CHUNK (256) headers, with freed headers reused first. The
+ * chunks are returned when none of its values is left alive, which may
+ * be after lcl_interp_free if the host still holds some. Values the host
+ * makes outside any call into an interpreter are allocated one by one.
+ *
+ * lcl_slab_stats is defined in lcl-memory.h.
+ * ============================================================================ */
+
+/*
+ * Set how many headers each new chunk of the interpreter's slab holds; 0
+ * restores the default. Chunks already allocated keep their size.
+ */
+void lcl_slab_set_chunk(lcl_interp *interp, size_t values);
+
+/*
+ * Read the counters of the interpreter's slab.
+ */
+void lcl_slab_get_stats(lcl_interp *interp, lcl_slab_stats *out);
+
+/* ============================================================================
+ * Memory
+ *
+ * All memory the library takes goes through an allocator. Each
+ * interpreter keeps its own account of it: one from lcl_interp_new uses
+ * the C library's, one from lcl_interp_new_with_allocator the one given.
+ * An interpreter is charged for what it allocates while running (inside
+ * lcl_eval_string, lcl_call_proc and the other calls taking it), and
+ * every block goes back to the allocator it came from.
+ *
+ * With a limit set, an allocation that would take the live total past
+ * it fails, and the script that asked for it fails with LCL_RC_ERR.
+ *
+ * Symbols are shared by all interpreters, so they are never charged to
+ * one; they, and values the host makes outside any call, come from the
+ * C library. The allocator must stay usable until all of its memory is
+ * back: lcl_interp_free returns everything but what values the host
+ * still holds need, and that goes back with the last of them.
+ *
+ * Beyond symbols, which are locked, interpreters share no memory, so
+ * separate ones may run on separate threads at once; each one, and the
+ * values it makes, must be used from one thread at a time.
+ *
+ * lcl_allocator and lcl_memory_stats are defined in lcl-memory.h.
+ * ============================================================================ */
+
+/*
+ * Create an interpreter whose memory comes from a, which is copied.
+ * NULL behaves like lcl_interp_new. Returns NULL on failure.
+ */
+lcl_interp *lcl_interp_new_with_allocator(const lcl_allocator *a);
+
+/*
+ * Read the interpreter's memory counters.
+ */
+void lcl_interp_memory_stats(lcl_interp *interp, lcl_memory_stats *out);
+
 /* ============================================================================
  * Error Information
  * ============================================================================ */
@@ -144,8 +246,12 @@ void lcl_ref_dec(lcl_value *value);
 /* ============================================================================
  * Value Creation
  *
- * All lcl_*_new functions return a value with refcount 1.
- * Returns NULL on allocation failure.
+ * All lcl_*_new functions return a value owning one reference, to be
+ * released with lcl_ref_dec.  Returns NULL on allocation failure.
+ *
+ * Values must not be modified once made.  The empty string and small
+ * integers (-256..1024 by default) are shared constants that are never
+ * freed.
  * ============================================================================ */
 
 /*
@@ -161,7 +267,7 @@ lcl_value *lcl_int_new(long n);
 /*
  * Create a new float value.
  */
-lcl_value *lcl_float_new(float f);
+lcl_value *lcl_float_new(double f);
 
 /*
  * Create a new empty list.
@@ -195,6 +301,12 @@ lcl_result lcl_value_to_int(lcl_value *value, long *out);
  */
 lcl_result lcl_value_to_float(lcl_value *value, float *out);
 
+/*
+ * Convert a value to a double.
+ * Returns LCL_OK on success, LCL_ERROR if the value cannot be converted.
+ */
+lcl_result lcl_value_to_double(lcl_value *value, double *out);
+
 /* ============================================================================
  * List Operations
  * ============================================================================ */
@@ -231,6 +343,13 @@ size_t lcl_dict_len(const lcl_value *dict);
  */
 lcl_result lcl_dict_get(const lcl_value *dict, const char *key, lcl_value **out);;
 
+/*
+ * Get an item from a dictionary without taking a reference.
+ * The value is only borrowed: it stays valid while the dictionary does.
+ * Returns NULL if the key is absent.
+ */
+lcl_value *lcl_dict_peek(const lcl_value *dict, const char *key);
+
 /*
  * Puts a value into a dictionary with key.
  */
@@ -4,6 +4,8 @@
 #include <sys/types.h>
 
 #include "hash-table.h"
+#include "lcl-alloc.h"
+#include "lcl-sym.h"
 #include "lcl-values.h"
 
 static unsigned long fnv1a(const char *s) {
@@ -17,6 +19,62 @@ static unsigned long fnv1a(const char *s) {
   return h ? h : 1UL;
 }
 
+unsigned long hash_table_hash(const char *key) {
+  return fnv1a(key);
+}
+
+/* fnv1a of the first n bytes of key */
+unsigned long hash_table_hash_n(const char *key, size_t n) {
+  unsigned long h = 1469598103934665603UL;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    h ^= (unsigned char)key[i];
+    h *= 1099511628211UL;
+  }
+
+  return h ? h : 1UL;
+}
+
+hash_key hash_key_make(const char *s) {
+  hash_key k;
+  unsigned long h = 1469598103934665603UL;
+  const char *p = s;
+
+  while (*p) {
+    h ^= (unsigned char)*p++;
+    h *= 1099511628211UL;
+  }
+
+  k.s = s;
+  k.len = (size_t)(p - s);
+  k.hash = h ? h : 1UL;
+  k.sym = 0;
+
+  return k;
+}
+
+/* Symbols already know their hash, and since every key in a table is a
+ * symbol, lookups with one match by pointer */
+hash_key hash_key_sym(const char *sym) {
+  hash_key k;
+
+  k.s = sym;
+  k.len = lcl_sym_len(sym);
+  k.hash = lcl_sym_hash(sym);
+  k.sym = 1;
+
+  return k;
+}
+
+/* k's symbol, with a reference for the caller.  A key that is a symbol
+ * already only takes a reference, which needs no lock. */
+const char *hash_key_intern(const hash_key *k) {
+  if (k->sym) return lcl_sym_ref(k->s);
+
+  return lcl_sym_intern_key(k->s, k->len, k->hash);
+}
+
 static size_t mask(const hash_table *ht) {
   return ht->cap - 1;
 }
@@ -38,7 +96,8 @@ static ssize_t hash_find(hash_table *ht, const char *key,
       if (*first_tomb == (size_t)-1) {
         *first_tomb = i;
       }
-    } else if (e->hash == hk && strcmp(e->key, key) == 0) {
+    } else if (e->key == key ||
+               (e->hash == hk && strcmp(e->key, key) == 0)) {
       return (ssize_t)i;
     }
 
@@ -51,7 +110,7 @@ static int hash_rehash(hash_table *ht, size_t newcap) {
   size_t oldcap = ht->cap;
   size_t i;
 
-  hash_entry *slots = (hash_entry *)calloc(newcap, sizeof(*slots));
+  hash_entry *slots = (hash_entry *)lcl_calloc(newcap, sizeof(*slots));
 
   if (!slots) {
     return 0;
@@ -74,28 +133,26 @@ static int hash_rehash(hash_table *ht, size_t newcap) {
       e->value = old[i].value;
       ht->len++;
       ht->used++;
-    } else if (old[i].state == H_TOMB) {
-      free(old[i].key);
     }
   }
 
-  free(old);
+  lcl_free(old);
 
   return 1;
 }
 
 hash_table *hash_table_new(void) {
-  hash_table *ht = (hash_table *)calloc(1, sizeof(*ht));
+  hash_table *ht = (hash_table *)lcl_calloc(1, sizeof(*ht));
 
   if (!ht) return NULL;
 
   ht->cap = 32;
   ht->len = 0;
   ht->used = 0;
-  ht->slots = (hash_entry *)calloc(ht->cap, sizeof(*ht->slots));
+  ht->slots = (hash_entry *)lcl_calloc(ht->cap, sizeof(*ht->slots));
 
   if (!ht->slots) {
-    free(ht);
+    lcl_free(ht);
     return NULL;
   }
 
@@ -112,23 +169,21 @@ void hash_table_free(hash_table *ht) {
 
     if (e->state == H_FULL) {
       lcl_ref_dec(e->value);
-      free(e->key);
-    }
-    else if (e->state == H_TOMB) {
-      free(e->key);
+      lcl_sym_release(e->key);
     }
   }
 
-  free(ht->slots);
-  free(ht);
+  lcl_free(ht->slots);
+  lcl_free(ht);
 }
 
-int hash_table_put(hash_table *ht, const char *key, lcl_value *value) {
-  unsigned long hk;
+/* Put k's value, the table taking its own reference to it.  k.s is
+ * interned unless it is a symbol already. */
+int hash_table_put_key(hash_table *ht, const hash_key *k, lcl_value *value) {
   size_t first_tomb;
   ssize_t idx;
   hash_entry *e;
-  char *k;
+  const char *sym;
 
   if ((ht->used + 1) * 10 >= ht->cap * 7) {
     if (!hash_rehash(ht, ht->cap ? ht->cap * 2 : 8)) {
@@ -136,8 +191,7 @@ int hash_table_put(hash_table *ht, const char *key, lcl_value *value) {
     }
   }
 
-  hk = fnv1a(key);
-  idx = hash_find(ht, key, hk, &first_tomb);
+  idx = hash_find(ht, k->s, k->hash, &first_tomb);
   assert(idx >= 0 && (size_t)idx < ht->cap);
   e = &ht->slots[(size_t)idx];
 
@@ -148,16 +202,15 @@ int hash_table_put(hash_table *ht, const char *key, lcl_value *value) {
     return 1;
   }
 
-  k = (char *)malloc(strlen(key) + 1);
+  sym = hash_key_intern(k);
 
-  if (!k) {
+  if (!sym) {
     return 0;
   }
 
-  strcpy(k, key);
   e->state = H_FULL;
-  e->hash = hk;
-  e->key = k;
+  e->hash = k->hash;
+  e->key = sym;
   e->value = lcl_ref_inc(value);
 
   ht->len++;
@@ -166,20 +219,47 @@ int hash_table_put(hash_table *ht, const char *key, lcl_value *value) {
   return 1;
 }
 
-int hash_table_get(hash_table *ht, const char *key,
-                       lcl_value **out) {
-  unsigned long hk = fnv1a(key);
+int hash_table_put(hash_table *ht, const char *key, lcl_value *value) {
+  hash_key k = hash_key_make(key);
+
+  return hash_table_put_key(ht, &k, value);
+}
+
+/* The full entry for k, or NULL */
+static hash_entry *entry_find(hash_table *ht, const hash_key *k) {
   size_t first_tomb;
-  ssize_t idx = hash_find(ht, key, hk, &first_tomb);
+  ssize_t idx = hash_find(ht, k->s, k->hash, &first_tomb);
   hash_entry *e = NULL;
 
   if (idx < 0) {
-    return 0;
+    return NULL;
   }
 
   e = &ht->slots[(size_t)idx];
 
   if (e->state != H_FULL) {
+    return NULL;
+  }
+
+  return e;
+}
+
+lcl_value *hash_table_peek_key(hash_table *ht, const hash_key *k) {
+  hash_entry *e = entry_find(ht, k);
+
+  return e ? e->value : NULL;
+}
+
+lcl_value *hash_table_peek(hash_table *ht, const char *key) {
+  hash_key k = hash_key_make(key);
+
+  return hash_table_peek_key(ht, &k);
+}
+
+int hash_table_get_key(hash_table *ht, const hash_key *k, lcl_value **out) {
+  hash_entry *e = entry_find(ht, k);
+
+  if (!e) {
     return 0;
   }
 
@@ -188,10 +268,15 @@ int hash_table_get(hash_table *ht, const char *key,
   return 1;
 }
 
-int hash_table_delete(hash_table *ht, const char *key) {
-  unsigned long hk = fnv1a(key);
+int hash_table_get(hash_table *ht, const char *key, lcl_value **out) {
+  hash_key k = hash_key_make(key);
+
+  return hash_table_get_key(ht, &k, out);
+}
+
+int hash_table_delete_key(hash_table *ht, const hash_key *k) {
   size_t first_tomb;
-  ssize_t idx = hash_find(ht, key, hk, &first_tomb);
+  ssize_t idx = hash_find(ht, k->s, k->hash, &first_tomb);
   hash_entry *e = NULL;
 
   if (idx < 0) {
@@ -205,7 +290,7 @@ int hash_table_delete(hash_table *ht, const char *key) {
   }
 
   lcl_ref_dec(e->value);
-  free(e->key);
+  lcl_sym_release(e->key);
   e->key = NULL;
   e->value = NULL;
   e->state = H_TOMB;
@@ -215,8 +300,14 @@ int hash_table_delete(hash_table *ht, const char *key) {
   return 1;
 }
 
-int hash_table_iterate(hash_table *ht, hash_iter *it,
-                       const char **key, lcl_value **value) {
+int hash_table_delete(hash_table *ht, const char *key) {
+  hash_key k = hash_key_make(key);
+
+  return hash_table_delete_key(ht, &k);
+}
+
+int hash_table_next(hash_table *ht, hash_iter *it,
+                    const char **key, lcl_value **value) {
   size_t i = it->i;
 
   while (i < ht->cap) {
@@ -225,10 +316,21 @@ int hash_table_iterate(hash_table *ht, hash_iter *it,
     if (e->state == H_FULL) {
       it->i =  i;
       *key = e->key;
-      *value = lcl_ref_inc(e->value);
+      *value = e->value;
       return 1;
     }
   }
 
   return 0;
 }
+
+int hash_table_iterate(hash_table *ht, hash_iter *it,
+                       const char **key, lcl_value **value) {
+  if (!hash_table_next(ht, it, key, value)) {
+    return 0;
+  }
+
+  lcl_ref_inc(*value);
+
+  return 1;
+}
@@ -13,12 +13,21 @@ typedef struct {
 } hash_iter;
 
 typedef struct {
-  char *key;
+  const char *key;  /* a symbol (lcl-sym.h) */
   lcl_value *value;
   unsigned long hash;
   unsigned char state;
 } hash_entry;
 
+/* A key with its hash worked out in advance, so callers holding a
+ * constant key (a symbol, a literal) can look it up without rehashing */
+typedef struct {
+  const char *s;
+  size_t len;
+  unsigned long hash;
+  int sym;  /* s is a symbol, so storing it needs no intern */
+} hash_key;
+
 typedef struct {
   hash_entry *slots;
   size_t cap;
@@ -26,12 +35,29 @@ typedef struct {
   size_t used;
 } hash_table;
 
+unsigned long hash_table_hash(const char *key);
+unsigned long hash_table_hash_n(const char *key, size_t n);
 hash_table *hash_table_new(void);
 void hash_table_free(hash_table *ht);
 int hash_table_put(hash_table *ht, const char *key, lcl_value *value);
 int hash_table_get(hash_table *ht, const char *key,
                    lcl_value **out);
+hash_key hash_key_make(const char *s);
+hash_key hash_key_sym(const char *sym);
+const char *hash_key_intern(const hash_key *k);
+int hash_table_put_key(hash_table *ht, const hash_key *k, lcl_value *value);
+int hash_table_get_key(hash_table *ht, const hash_key *k, lcl_value **out);
+int hash_table_delete_key(hash_table *ht, const hash_key *k);
 int hash_table_delete(hash_table *ht, const char *key);
 int hash_table_iterate(hash_table *ht, hash_iter *it,
                        const char **key, lcl_value **value);
+
+/* Borrowed reads: the value stays owned by the table and is only good
+ * until the table is next changed, so callers that merely look at it
+ * skip the increment and decrement.  A peek gives NULL for a missing
+ * key, which a table used as a set (NULL values) must test with get. */
+lcl_value *hash_table_peek(hash_table *ht, const char *key);
+lcl_value *hash_table_peek_key(hash_table *ht, const hash_key *k);
+int hash_table_next(hash_table *ht, hash_iter *it,
+                    const char **key, lcl_value **value);
 #endif
@@ -0,0 +1,231 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lcl-alloc.h"
+#include "lcl-thread.h"
+
+/* Each block starts with a header naming the heap it came from and its
+ * size, so a free needs no other context and live bytes stay exact.
+ * The heap in use is private to each thread, switched by the public
+ * entry points of an interpreter to its own heap and put back when they
+ * return.  A heap is only touched by the thread running its
+ * interpreter, so none is locked; the default heap, which any thread
+ * may use, is the C library's and keeps no counts. */
+
+typedef union {
+  struct {
+    lcl_heap *heap;
+    size_t size;
+  } h;
+  long double align;  /* what follows is aligned for any type */
+} block_header;
+
+struct lcl_heap {
+  lcl_allocator a;
+  lcl_memory_stats stats;
+  unsigned long blocks;  /* handed out and not yet freed */
+  int open;              /* until lcl_heap_close */
+};
+
+static void *sys_alloc(void *ctx, size_t n) {
+  (void)ctx;
+
+  return malloc(n);
+}
+
+static void *sys_resize(void *ctx, void *p, size_t n) {
+  (void)ctx;
+
+  return realloc(p, n);
+}
+
+static void sys_release(void *ctx, void *p) {
+  (void)ctx;
+
+  free(p);
+}
+
+static lcl_heap default_heap = {
+  { sys_alloc, sys_resize, sys_release, NULL, 0 },
+  { 0, 0, 0, 0, 0 },
+  0,
+  1
+};
+
+static LCL_THREAD_LOCAL lcl_heap *current = &default_heap;
+
+/* Whether n more bytes would take h past its limit */
+static int over_limit(const lcl_heap *h, size_t n) {
+  size_t limit = h->stats.limit;
+
+  return limit && (n > limit || h->stats.live > limit - n);
+}
+
+static void heap_add(lcl_heap *h, size_t n) {
+  if (h == &default_heap) return;
+
+  h->stats.live += n;
+
+  if (h->stats.live > h->stats.peak) {
+    h->stats.peak = h->stats.live;
+  }
+}
+
+static void heap_fail(lcl_heap *h) {
+  if (h != &default_heap) h->stats.failures++;
+}
+
+/* A closed heap goes with its last block */
+static void heap_release(lcl_heap *h) {
+  lcl_allocator a;
+
+  if (h->open || h->blocks || h == &default_heap) return;
+
+  a = h->a;
+  a.release(a.ctx, h);
+}
+
+void *lcl_malloc(size_t n) {
+  lcl_heap *h = current;
+  block_header *b;
+  size_t total = sizeof(*b) + n;
+
+  if (h != &default_heap) h->stats.allocs++;
+
+  if (total < n || over_limit(h, total)) {
+    heap_fail(h);
+    return NULL;
+  }
+
+  b = (block_header *)h->a.alloc(h->a.ctx, total);
+
+  if (!b) {
+    heap_fail(h);
+    return NULL;
+  }
+
+  b->h.heap = h;
+  b->h.size = n;
+  if (h != &default_heap) h->blocks++;
+  heap_add(h, total);
+
+  return b + 1;
+}
+
+void *lcl_calloc(size_t n, size_t size) {
+  void *p;
+
+  if (size && n > (size_t)-1 / size) {
+    heap_fail(current);
+    return NULL;
+  }
+
+  p = lcl_malloc(n * size);
+
+  if (p) memset(p, 0, n * size);
+
+  return p;
+}
+
+void *lcl_realloc(void *p, size_t n) {
+  block_header *b, *nb;
+  lcl_heap *h;
+  size_t old;
+
+  if (!p) return lcl_malloc(n);
+
+  b = (block_header *)p - 1;
+  h = b->h.heap;
+  old = b->h.size;
+
+  if (h != &default_heap) h->stats.allocs++;
+
+  if (sizeof(*b) + n < n || (n > old && over_limit(h, n - old))) {
+    heap_fail(h);
+    return NULL;
+  }
+
+  nb = (block_header *)h->a.resize(h->a.ctx, b, sizeof(*b) + n);
+
+  if (!nb) {
+    heap_fail(h);
+    return NULL;
+  }
+
+  nb->h.size = n;
+  if (h != &default_heap) h->stats.live -= old;
+  heap_add(h, n);
+
+  return nb + 1;
+}
+
+void lcl_free(void *p) {
+  block_header *b;
+  lcl_heap *h;
+
+  if (!p) return;
+
+  b = (block_header *)p - 1;
+  h = b->h.heap;
+
+  if (h != &default_heap) {
+    h->stats.live -= sizeof(*b) + b->h.size;
+    h->blocks--;
+  }
+
+  h->a.release(h->a.ctx, b);
+
+  heap_release(h);
+}
+
+lcl_heap *lcl_heap_default(void) {
+  return &default_heap;
+}
+
+lcl_heap *lcl_heap_new(const lcl_allocator *a) {
+  lcl_heap *h;
+
+  if (!a) a = &default_heap.a;
+
+  if (!a->alloc || !a->resize || !a->release) return NULL;
+
+  h = (lcl_heap *)a->alloc(a->ctx, sizeof(*h));
+
+  if (!h) return NULL;
+
+  h->a = *a;
+  h->stats.live = 0;
+  h->stats.peak = 0;
+  h->stats.limit = a->limit;
+  h->stats.failures = 0;
+  h->stats.allocs = 0;
+  h->blocks = 0;
+  h->open = 1;
+
+  return h;
+}
+
+void lcl_heap_close(lcl_heap *h) {
+  if (!h || h == &default_heap) return;
+
+  h->open = 0;
+  heap_release(h);
+}
+
+void lcl_heap_get_stats(const lcl_heap *h, lcl_memory_stats *out) {
+  if (!h || !out) return;
+
+  *out = h->stats;
+}
+
+lcl_heap *lcl_heap_enter(lcl_heap *h) {
+  lcl_heap *prev = current;
+
+  if (h) current = h;
+
+  return prev;
+}
+
+void lcl_heap_leave(lcl_heap *prev) {
+  current = prev;
+}
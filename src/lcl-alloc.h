@@ -0,0 +1,35 @@
+#ifndef LCL_ALLOC_H
+#define LCL_ALLOC_H
+
+#include <stdlib.h>
+
+#include "../include/lcl-memory.h"
+
+/* All heap memory the library uses comes and goes through these, with
+ * the same contracts as the C functions they stand for, so it can be
+ * accounted for in one place. */
+void *lcl_malloc(size_t n);
+void *lcl_calloc(size_t n, size_t size);
+void *lcl_realloc(void *p, size_t n);
+void lcl_free(void *p);
+
+/* A heap is an allocator with its accounting.  Allocations are made
+ * from the current heap and remember it, so each block goes back to the
+ * heap it came from whichever heap is current when it is freed.  A heap
+ * lives until it is closed and its last block is freed.
+ *
+ * The default heap is current wherever no other is: it is the C
+ * library's, shared by every thread, and keeps no counts.  A new heap
+ * with no allocator uses the C library's too, but counts. */
+typedef struct lcl_heap lcl_heap;
+
+lcl_heap *lcl_heap_default(void);
+lcl_heap *lcl_heap_new(const lcl_allocator *a);
+void lcl_heap_close(lcl_heap *h);
+void lcl_heap_get_stats(const lcl_heap *h, lcl_memory_stats *out);
+
+/* Make h current and return the heap that was, for lcl_heap_leave */
+lcl_heap *lcl_heap_enter(lcl_heap *h);
+void lcl_heap_leave(lcl_heap *prev);
+
+#endif
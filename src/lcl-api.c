@@ -10,74 +10,42 @@
 #include "lcl-compile.h"
 #include "lcl-values.h"
 #include "lcl-eval.h"
-
-/* Helper: read entire file into a malloc'd string */
-static char *api_read_file(const char *path) {
-  FILE *f;
-  long len;
-  char *buf;
-  size_t nread;
-
-  f = fopen(path, "rb");
-  if (!f) return NULL;
-
-  if (fseek(f, 0, SEEK_END) != 0) {
-    fclose(f);
-    return NULL;
-  }
-
-  len = ftell(f);
-  if (len < 0) {
-    fclose(f);
-    return NULL;
-  }
-
-  if (fseek(f, 0, SEEK_SET) != 0) {
-    fclose(f);
-    return NULL;
-  }
-
-  buf = malloc((size_t)len + 1);
-  if (!buf) {
-    fclose(f);
-    return NULL;
-  }
-
-  nread = fread(buf, 1, (size_t)len, f);
-  fclose(f);
-
-  if ((long)nread != len) {
-    free(buf);
-    return NULL;
-  }
-
-  buf[len] = '\0';
-  return buf;
-}
+#include "lcl-image.h"
 
 /* ============================================================================
  * Evaluation
  * ============================================================================ */
 
 int lcl_eval_file(lcl_interp *interp, const char *path, lcl_value **out) {
-  char *src;
-  int rc;
+  lcl_interp *prev;
+  lcl_program *prog;
+  int rc = LCL_RC_ERR;
 
   if (!interp || !path) {
     return LCL_RC_ERR;
   }
 
-  src = api_read_file(path);
-  if (!src) {
-    return LCL_RC_ERR;
+  prev = lcl_interp_enter(interp);
+
+  /* Files are normally run once, so they bypass the compile cache */
+  prog = lcl_image_load(path, "<string>");
+
+  if (prog) {
+    rc = lcl_eval_program(interp, prog, out);
+    lcl_program_ref_dec(prog);
   }
 
-  rc = lcl_eval_string(interp, src, out);
-  free(src);
+  lcl_interp_leave(prev);
 
   return rc;
 }
 
+lcl_result lcl_compile_file(const char *path, const char *out_path) {
+  if (!path) return LCL_ERROR;
+
+  return lcl_image_save(path, out_path) ? LCL_OK : LCL_ERROR;
+}
+
 /* ============================================================================
  * Error Information
  * ============================================================================ */
@@ -92,23 +60,67 @@ int lcl_interp_error_line(lcl_interp *interp) {
   return interp->err_line;
 }
 
+/* ============================================================================
+ * Compile Cache
+ * ============================================================================ */
+
+void lcl_interp_set_compile_cache(lcl_interp *interp, size_t max_bytes) {
+  if (!interp) return;
+  lcl_cache_set_limit(&interp->cache, max_bytes);
+}
+
+void lcl_interp_compile_cache_stats(lcl_interp *interp, lcl_cache_stats *out) {
+  if (!interp || !out) return;
+  *out = interp->cache.stats;
+}
+
+/* ============================================================================
+ * Memory
+ * ============================================================================ */
+
+void lcl_interp_memory_stats(lcl_interp *interp, lcl_memory_stats *out) {
+  if (!interp || !out) return;
+  lcl_heap_get_stats(interp->heap, out);
+}
+
 /* ============================================================================
  * Variable/Definition Access
  * ============================================================================ */
 
 lcl_result lcl_define(lcl_interp *interp, const char *name, lcl_value *value) {
+  lcl_interp *prev;
+  lcl_result r;
+
   if (!interp || !name || !value) return LCL_ERROR;
-  return lcl_env_let(&interp->env, name, value);
+  prev = lcl_interp_enter(interp);
+  r = lcl_env_let(&interp->env, name, value);
+  lcl_interp_leave(prev);
+
+  return r;
 }
 
 lcl_result lcl_define_take(lcl_interp *interp, const char *name, lcl_value *value) {
+  lcl_interp *prev;
+  lcl_result r;
+
   if (!interp || !name || !value) return LCL_ERROR;
-  return lcl_env_let_take(&interp->env, name, value);
+  prev = lcl_interp_enter(interp);
+  r = lcl_env_let_take(&interp->env, name, value);
+  lcl_interp_leave(prev);
+
+  return r;
 }
 
 lcl_result lcl_get(lcl_interp *interp, const char *name, lcl_value **out) {
+  lcl_interp *prev;
+  lcl_result r;
+
   if (!interp || !name || !out) return LCL_ERROR;
-  return lcl_env_get_value(&interp->env, name, out);
+  prev = lcl_interp_enter(interp);
+  r = lcl_env_get_value(&interp->env, name, out);
+  lcl_interp_leave(prev);
+
+  return r;
 }
 
 /* ============================================================================
@@ -116,25 +128,33 @@ lcl_result lcl_get(lcl_interp *interp, const char *name, lcl_value **out) {
  * ============================================================================ */
 
 lcl_result lcl_register_proc(lcl_interp *interp, const char *name, lcl_c_proc_fn fn) {
+  lcl_interp *prev;
   lcl_value *proc;
+  lcl_result r;
 
   if (!interp || !name || !fn) return LCL_ERROR;
 
+  prev = lcl_interp_enter(interp);
   proc = lcl_c_proc_new(name, fn);
-  if (!proc) return LCL_ERROR;
+  r = proc ? lcl_env_let_take(&interp->env, name, proc) : LCL_ERROR;
+  lcl_interp_leave(prev);
 
-  return lcl_env_let_take(&interp->env, name, proc);
+  return r;
 }
 
 lcl_result lcl_register_spec(lcl_interp *interp, const char *name, lcl_c_spec_fn fn) {
+  lcl_interp *prev;
   lcl_value *spec;
+  lcl_result r;
 
   if (!interp || !name || !fn) return LCL_ERROR;
 
+  prev = lcl_interp_enter(interp);
   spec = lcl_c_spec_new(name, fn);
-  if (!spec) return LCL_ERROR;
+  r = spec ? lcl_env_let_take(&interp->env, name, spec) : LCL_ERROR;
+  lcl_interp_leave(prev);
 
-  return lcl_env_let_take(&interp->env, name, spec);
+  return r;
 }
 
 /* ============================================================================
@@ -153,6 +173,7 @@ lcl_return_code lcl_call_proc(lcl_interp *interp,
                                lcl_value **out) {
   lcl_return_code rc;
   lcl_value *dummy = NULL;
+  lcl_interp *prev;
 
   if (!interp || !proc) return LCL_RC_ERR;
 
@@ -164,9 +185,13 @@ lcl_return_code lcl_call_proc(lcl_interp *interp,
     if (proc->as.c_proc.fn->kind == LCL_CK_SPECIAL) {
       return LCL_RC_ERR;  /* Can't call special forms this way */
     }
+    prev = lcl_interp_enter(interp);
     rc = proc->as.c_proc.fn->fn.proc(interp, argc, argv, out);
+    lcl_interp_leave(prev);
   } else if (proc->type == LCL_PROC) {
+    prev = lcl_interp_enter(interp);
     rc = lcl_call_user_proc(interp, proc->as.procedure.proc, argc, argv, out);
+    lcl_interp_leave(prev);
     /* Convert RETURN to OK (normal proc return) */
     if (rc == LCL_RC_RETURN) {
       rc = LCL_RC_OK;
@@ -0,0 +1,104 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "lcl-alloc.h"
+#include "lcl-arena.h"
+
+/* Bytes in the first chunk; each further chunk doubles, up to the cap */
+#define ARENA_FIRST 1024
+#define ARENA_MAX (64 * 1024)
+
+typedef union {
+  long l;
+  double d;
+  void *p;
+} lcl_arena_align;
+
+struct lcl_arena_chunk {
+  lcl_arena_chunk *prev;
+  size_t size;
+  size_t used;
+  lcl_arena_align data[1];
+};
+
+#define ALIGN_UP(n) \
+  (((n) + sizeof(lcl_arena_align) - 1) & ~(sizeof(lcl_arena_align) - 1))
+
+void lcl_arena_init(lcl_arena *a) {
+  a->chunk = NULL;
+  a->bytes = 0;
+}
+
+void lcl_arena_free(lcl_arena *a) {
+  lcl_arena_chunk *c = a->chunk;
+
+  while (c) {
+    lcl_arena_chunk *prev = c->prev;
+    lcl_free(c);
+    c = prev;
+  }
+
+  lcl_arena_init(a);
+}
+
+static lcl_arena_chunk *arena_chunk(lcl_arena *a, size_t need) {
+  size_t size = a->chunk ? a->chunk->size * 2 : ARENA_FIRST;
+  lcl_arena_chunk *c;
+
+  if (size > ARENA_MAX) size = ARENA_MAX;
+  if (size < need) size = need;
+
+  c = (lcl_arena_chunk *)lcl_malloc(offsetof(lcl_arena_chunk, data) + size);
+  if (!c) return NULL;
+
+  c->prev = a->chunk;
+  c->size = size;
+  c->used = 0;
+  a->chunk = c;
+  a->bytes += size;
+
+  return c;
+}
+
+void *lcl_arena_alloc(lcl_arena *a, size_t n) {
+  lcl_arena_chunk *c = a->chunk;
+  char *p;
+
+  n = ALIGN_UP(n ? n : 1);
+
+  if (!c || c->size - c->used < n) {
+    c = arena_chunk(a, n);
+    if (!c) return NULL;
+  }
+
+  p = (char *)c->data + c->used;
+  c->used += n;
+
+  return p;
+}
+
+void *lcl_arena_grow(lcl_arena *a, void *p, size_t old, size_t n) {
+  lcl_arena_chunk *c = a->chunk;
+  void *np;
+
+  if (!p) return lcl_arena_alloc(a, n);
+
+  old = ALIGN_UP(old);
+
+  /* the newest block ends where the chunk's free space starts */
+  if (c && (char *)p + old == (char *)c->data + c->used) {
+    size_t start = (size_t)((char *)p - (char *)c->data);
+
+    if (ALIGN_UP(n) <= c->size - start) {
+      c->used = start + ALIGN_UP(n);
+      return p;
+    }
+  }
+
+  np = lcl_arena_alloc(a, n);
+  if (!np) return NULL;
+
+  memcpy(np, p, old < n ? old : n);
+
+  return np;
+}
@@ -0,0 +1,29 @@
+#ifndef LCL_ARENA_H
+#define LCL_ARENA_H
+
+#include <stdlib.h>
+
+/* Bump allocation for things that are built piece by piece and freed all
+ * at once, like the arrays of a compiled program.  Memory comes from a
+ * chain of chunks, each larger than the last, and is only given back by
+ * lcl_arena_free. */
+
+typedef struct lcl_arena_chunk lcl_arena_chunk;
+
+typedef struct {
+  lcl_arena_chunk *chunk;  /* newest; older chunks hang off it */
+  size_t bytes;            /* held in all chunks */
+} lcl_arena;
+
+void lcl_arena_init(lcl_arena *a);
+void lcl_arena_free(lcl_arena *a);
+
+/* n bytes aligned for any type, or NULL */
+void *lcl_arena_alloc(lcl_arena *a, size_t n);
+
+/* Resize p, of old bytes, to n bytes.  The newest block grows in place
+ * when its chunk has room; others are copied and the old space is left
+ * unused until the arena goes. */
+void *lcl_arena_grow(lcl_arena *a, void *p, size_t old, size_t n);
+
+#endif
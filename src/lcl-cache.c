@@ -0,0 +1,197 @@
+#include <string.h>
+
+#include "hash-table.h"
+#include "lcl-alloc.h"
+#include "lcl-cache.h"
+
+struct lcl_cache_entry {
+  lcl_cache_entry *chain;  /* next entry in the same bucket */
+  lcl_cache_entry *newer;
+  lcl_cache_entry *older;
+  unsigned long hash;
+  const char *file;        /* callers pass static tags; not copied */
+  lcl_program *program;
+  size_t bytes;
+  char *src;               /* stored inline after the entry */
+};
+
+static int same_file(const char *a, const char *b) {
+  if (a == b) return 1;
+  if (!a || !b) return 0;
+
+  return strcmp(a, b) == 0;
+}
+
+static void lru_unlink(lcl_compile_cache *c, lcl_cache_entry *e) {
+  if (e->newer) e->newer->older = e->older;
+  else c->newest = e->older;
+
+  if (e->older) e->older->newer = e->newer;
+  else c->oldest = e->newer;
+
+  e->newer = e->older = NULL;
+}
+
+static void lru_push_newest(lcl_compile_cache *c, lcl_cache_entry *e) {
+  e->newer = NULL;
+  e->older = c->newest;
+
+  if (c->newest) c->newest->newer = e;
+  else c->oldest = e;
+
+  c->newest = e;
+}
+
+static void evict(lcl_compile_cache *c, lcl_cache_entry *e) {
+  lcl_cache_entry **pp = &c->buckets[e->hash & (c->nbuckets - 1)];
+
+  while (*pp != e) {
+    pp = &(*pp)->chain;
+  }
+
+  *pp = e->chain;
+  lru_unlink(c, e);
+
+  c->stats.entries--;
+  c->stats.bytes -= e->bytes;
+
+  /* Programs still running keep their own reference */
+  lcl_program_ref_dec(e->program);
+  lcl_free(e);
+}
+
+static void trim(lcl_compile_cache *c) {
+  while (c->oldest && c->stats.bytes > c->stats.limit) {
+    evict(c, c->oldest);
+  }
+}
+
+static int grow(lcl_compile_cache *c) {
+  size_t n = c->nbuckets ? c->nbuckets * 2 : 64;
+  lcl_cache_entry **b = (lcl_cache_entry **)lcl_calloc(n, sizeof(*b));
+  size_t i;
+
+  if (!b) return 0;
+
+  for (i = 0; i < c->nbuckets; i++) {
+    lcl_cache_entry *e = c->buckets[i];
+
+    while (e) {
+      lcl_cache_entry *next = e->chain;
+      size_t slot = e->hash & (n - 1);
+
+      e->chain = b[slot];
+      b[slot] = e;
+      e = next;
+    }
+  }
+
+  lcl_free(c->buckets);
+  c->buckets = b;
+  c->nbuckets = n;
+
+  return 1;
+}
+
+void lcl_cache_init(lcl_compile_cache *c, size_t limit) {
+  memset(c, 0, sizeof(*c));
+  c->stats.limit = limit;
+}
+
+void lcl_cache_clear(lcl_compile_cache *c) {
+  while (c->oldest) {
+    evict(c, c->oldest);
+  }
+
+  lcl_free(c->buckets);
+  c->buckets = NULL;
+  c->nbuckets = 0;
+}
+
+void lcl_cache_set_limit(lcl_compile_cache *c, size_t limit) {
+  c->stats.limit = limit;
+
+  if (limit == 0) {
+    lcl_cache_clear(c);
+  } else {
+    trim(c);
+  }
+}
+
+/* Returns a new reference to the cached program, or NULL on a miss. */
+lcl_program *lcl_cache_get(lcl_compile_cache *c, const char *src,
+                           const char *file) {
+  unsigned long hk;
+  lcl_cache_entry *e;
+
+  if (c->stats.limit == 0) return NULL;
+
+  if (c->nbuckets) {
+    hk = hash_table_hash(src);
+
+    for (e = c->buckets[hk & (c->nbuckets - 1)]; e; e = e->chain) {
+      if (e->hash == hk && same_file(e->file, file) &&
+          strcmp(e->src, src) == 0) {
+        lru_unlink(c, e);
+        lru_push_newest(c, e);
+        c->stats.hits++;
+
+        return lcl_program_ref_inc(e->program);
+      }
+    }
+  }
+
+  c->stats.misses++;
+
+  return NULL;
+}
+
+/* Remember p for src.  The cache takes its own reference; programs that
+ * would not fit in the budget on their own are not cached at all. */
+void lcl_cache_put(lcl_compile_cache *c, const char *src, const char *file,
+                   lcl_program *p) {
+  size_t len = strlen(src);
+  size_t bytes = sizeof(lcl_cache_entry) + len + 1 + lcl_program_size(p);
+  lcl_cache_entry *e;
+  size_t slot;
+
+  if (!p || bytes > c->stats.limit) return;
+
+  if (c->stats.entries >= c->nbuckets && !grow(c)) return;
+
+  e = (lcl_cache_entry *)lcl_malloc(sizeof(*e) + len + 1);
+  if (!e) return;
+
+  e->src = (char *)(e + 1);
+  memcpy(e->src, src, len + 1);
+  e->hash = hash_table_hash(src);
+  e->file = file;
+  e->program = lcl_program_ref_inc(p);
+  e->bytes = bytes;
+
+  slot = e->hash & (c->nbuckets - 1);
+  e->chain = c->buckets[slot];
+  c->buckets[slot] = e;
+  lru_push_newest(c, e);
+
+  c->stats.entries++;
+  c->stats.bytes += bytes;
+
+  trim(c);
+}
+
+/* Compile src through the cache.  Returns a new program reference. */
+lcl_program *lcl_cache_compile(lcl_compile_cache *c, const char *src,
+                               const char *file) {
+  lcl_program *p = lcl_cache_get(c, src, file);
+
+  if (p) return p;
+
+  p = lcl_program_compile(src, file);
+
+  if (p) {
+    lcl_cache_put(c, src, file, p);
+  }
+
+  return p;
+}
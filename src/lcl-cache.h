@@ -0,0 +1,32 @@
+#ifndef LCL_CACHE_H
+#define LCL_CACHE_H
+
+#include "../include/lcl-memory.h"
+#include "lcl-lex.h"
+
+/* Default memory budget for an interpreter's compile cache */
+#define LCL_COMPILE_CACHE_DEFAULT (1024UL * 1024UL)
+
+typedef struct lcl_cache_entry lcl_cache_entry;
+
+/* LRU map from (source text, file tag) to compiled program, bounded by
+ * an approximate byte budget.  A limit of 0 disables the cache. */
+typedef struct {
+  lcl_cache_entry **buckets;
+  size_t nbuckets;
+  lcl_cache_entry *newest;
+  lcl_cache_entry *oldest;
+  lcl_cache_stats stats;
+} lcl_compile_cache;
+
+void lcl_cache_init(lcl_compile_cache *c, size_t limit);
+void lcl_cache_clear(lcl_compile_cache *c);
+void lcl_cache_set_limit(lcl_compile_cache *c, size_t limit);
+lcl_program *lcl_cache_get(lcl_compile_cache *c, const char *src,
+                           const char *file);
+void lcl_cache_put(lcl_compile_cache *c, const char *src, const char *file,
+                   lcl_program *p);
+lcl_program *lcl_cache_compile(lcl_compile_cache *c, const char *src,
+                               const char *file);
+
+#endif
@@ -1,8 +1,9 @@
+#include "lcl-alloc.h"
 #include "lcl-compile.h"
 #include "lcl-values.h"
 
 lcl_value *lcl_cell_new(lcl_value *init) {
-  lcl_value *c = (lcl_value *)calloc(1, sizeof(*c));
+  lcl_value *c = lcl_value_alloc();
 
   if (!c) {
     return NULL;
@@ -25,6 +26,13 @@ lcl_result lcl_cell_get(lcl_value *cell, lcl_value **out) {
   return LCL_OK;
 }
 
+/* The cell's contents without a reference, or NULL if cell is not one */
+lcl_value *lcl_cell_peek(const lcl_value *cell) {
+  if (!cell || cell->type != LCL_CELL) return NULL;
+
+  return cell->as.cell.inner;
+}
+
 lcl_result lcl_cell_set(lcl_value *cell, lcl_value *v) {
   if (!cell || cell->type != LCL_CELL || !v) {
     return LCL_ERROR;
@@ -36,7 +44,7 @@ lcl_result lcl_cell_set(lcl_value *cell, lcl_value *v) {
     lcl_ref_dec(old);
 
     if (cell->str_repr) {
-      free(cell->str_repr);
+      lcl_free(cell->str_repr);
       cell->str_repr = NULL;
     }
   }
@@ -1,44 +1,25 @@
 #include <memory.h>
 
 #include "lcl-lex.h"
+#include "lcl-values.h"
 
 void lcl_command_free(lcl_command *cmd) {
   int i;
-  int j;
 
   for (i = 0; i < cmd->argc; i++) {
-    lcl_word *w = &cmd->w[i];
-
-    for (j = 0; j < w->np; j++) {
-      lcl_word_piece *pc = &w->wp[j];
-
-      switch (pc->kind) {
-      case LCL_WP_LIT:
-        free(pc->as.lit.s);
-        break;
-      case LCL_WP_VAR:
-        free(pc->as.var.name);
-        break;
-      case LCL_WP_SUBCMD:
-        lcl_program_free(pc->as.sub.program);
-        break;
-      }
-    }
-
-    free(w->wp);
+    lcl_word_free(&cmd->w[i]);
   }
 
-  free(cmd->w);
   memset(cmd, 0, sizeof(*cmd));
 }
 
-int lcl_command_push_word(lcl_command *cmd, lcl_word *w) {
+int lcl_command_push_word(lcl_arena *a, lcl_command *cmd, lcl_word *w) {
   int idx;
 
   if (cmd->argc >= cmd->cap) {
     int newcap = cmd->cap ? cmd->cap * 2 : 4;
-    size_t bytes = (size_t)newcap * sizeof(*cmd->w);
-    void *nv = realloc(cmd->w, bytes);
+    void *nv = lcl_arena_grow(a, cmd->w, (size_t)cmd->cap * sizeof(*cmd->w),
+                              (size_t)newcap * sizeof(*cmd->w));
 
     if (!nv) return 0;
 
@@ -2,10 +2,13 @@
 #define LCL_COMPILE_H
 
 #include "hash-table.h"
+#include "lcl-alloc.h"
+#include "lcl-cache.h"
 #include "lcl-lex.h"
 
 /* Forward declarations */
 typedef struct lcl_interp lcl_interp;
+typedef struct lcl_slab lcl_slab;
 typedef struct lcl_frame lcl_frame;
 
 typedef enum { LCL_OK, LCL_ERROR } lcl_result;
@@ -23,25 +26,73 @@ typedef struct {
   lcl_value *value;
 } lcl_result_value;
 
+/* Slot names of a proc frame: the params first, then every name the body
+ * reads or binds with let/var.  Resolved once per body and shared by all
+ * frames of procs built from it. */
+struct lcl_layout {
+  int refc;
+  int nslots;
+  int nparams;           /* leading slots filled positionally from argv */
+  const char **names;    /* symbols (lcl-sym.h) */
+};
+
+lcl_layout *lcl_layout_ref_inc(lcl_layout *l);
+void lcl_layout_ref_dec(lcl_layout *l);
+int lcl_layout_slot(const lcl_layout *l, const char *name);
+
+/* Names bound outside the layout are kept in a few pairs, searched in
+ * order, and only moved to a locals table when they outgrow them */
+#define LCL_FRAME_PAIRS 4
+
+typedef struct {
+  const char *name;     /* symbol */
+  lcl_value *value;
+} lcl_frame_pair;
+
 struct lcl_frame {
   struct lcl_frame *parent;
-  hash_table *locals;
+  hash_table *locals;   /* NULL until the pairs overflow */
+  lcl_slab *slab;       /* whose cache it goes back to, or NULL */
   int refc;
   int owns_locals;  /* 0 if locals is borrowed (e.g., from a namespace) */
+  lcl_layout *layout;   /* slot frames only */
+  lcl_value **slots;    /* one binding per layout name, NULL if unbound */
+  int npairs;           /* pairs in use; 0 once locals exists */
+  lcl_frame_pair pairs[LCL_FRAME_PAIRS];
 };
 
+/* Dropped frames an interpreter keeps for reuse, by slot count, in its
+ * slab (lcl-frame.c).  Larger frames go straight back to the heap. */
+#define LCL_FRAME_CACHE_SLOTS 8
+
+typedef struct {
+  lcl_frame *free[LCL_FRAME_CACHE_SLOTS + 1];  /* linked by parent */
+  int cached[LCL_FRAME_CACHE_SLOTS + 1];
+  size_t live;  /* frames made and not yet freed */
+} lcl_frame_cache;
+
 lcl_frame *lcl_frame_new(lcl_frame *parent);
 lcl_frame *lcl_frame_new_ns(lcl_frame *parent, hash_table *ns_locals);
+lcl_frame *lcl_frame_new_slots(lcl_frame *parent, lcl_layout *layout);
 void lcl_frame_free(lcl_frame *f);
 lcl_frame *lcl_frame_ref_inc(lcl_frame *f);
 void lcl_frame_ref_dec(lcl_frame *f);
 void lcl_frame_clear(lcl_frame *f);
 int lcl_frame_get_binding(lcl_frame *f, const char *name, lcl_value **out);
+int lcl_frame_get_binding_key(lcl_frame *f, const hash_key *k,
+                              lcl_value **out);
+int lcl_frame_lookup(lcl_frame *f, const char *name, lcl_value **out);
+int lcl_frame_lookup_key(lcl_frame *f, const hash_key *k, lcl_value **out);
+int lcl_frame_put(lcl_frame *f, const char *name, lcl_value *value);
+int lcl_frame_put_key(lcl_frame *f, const hash_key *k, lcl_value *value);
 
 typedef struct lcl_env {
   lcl_frame *frame;
   lcl_value *current_ns;
   lcl_value *global_ns;
+  unsigned long epoch;     /* bumped when a binding call sites cached changes */
+  hash_table *cmd_names;   /* names some call site has cached (a set) */
+  unsigned long nnames;    /* grows whenever cmd_names does */
 } lcl_env;
 
 lcl_env *lcl_env_new(void);
@@ -50,9 +101,16 @@ void lcl_env_free(lcl_env *env);
 lcl_result lcl_env_let_take(lcl_env *env, const char *name, lcl_value *value);
 lcl_result lcl_env_let(lcl_env *env, const char *name, lcl_value *value);
 lcl_result lcl_env_get_value(lcl_env *env, const char *key, lcl_value **out);
+lcl_result lcl_env_get_sym(lcl_env *env, const char *sym, lcl_value **out);
 lcl_result lcl_env_get_command(lcl_env *env, const char *key, lcl_value **out);
 lcl_result lcl_env_var(lcl_env *env, const char *name, lcl_value *value);
 lcl_result lcl_env_set_bang(lcl_env *eng, const char *name, lcl_value *value);
+lcl_result lcl_env_get_command_cached(lcl_env *env, const char *key,
+                                      lcl_call_cache *cc, lcl_value **out);
+lcl_value *lcl_call_cache_get(const lcl_env *env, const lcl_call_cache *cc);
+int lcl_env_shadows_command(lcl_env *env, const char *name);
+
+typedef struct lcl_stack_block lcl_stack_block;
 
 struct lcl_interp {
   lcl_env env;
@@ -62,11 +120,34 @@ struct lcl_interp {
   int err_line;
   int depth;
   int max_depth;
+  lcl_compile_cache cache;  /* eval/subst/lcl_eval_string programs */
+  lcl_stack_block *stack;   /* argument stack, its block in use */
+  lcl_heap *heap;           /* where its allocations are charged */
+  lcl_slab *slab;           /* where its values come from (lcl-slab.c) */
 };
 
 lcl_interp *lcl_interp_new(void);
+lcl_interp *lcl_interp_new_with_allocator(const lcl_allocator *a);
+void lcl_interp_memory_stats(lcl_interp *interp, lcl_memory_stats *out);
 void lcl_interp_free(lcl_interp *interp);
 
+/* Make interp the one running on this thread, so what it allocates comes
+ * from its heap and its slab, and return the one that was, for
+ * lcl_interp_leave.  Every public call taking an interpreter brackets
+ * its work with the two. */
+lcl_interp *lcl_interp_enter(lcl_interp *interp);
+void lcl_interp_leave(lcl_interp *prev);
+
+/* The argument stack holds the argv of calls being made and the
+ * registers of code too big for the C stack.  Slices are pushed and
+ * popped in call order and never move while pushed; blocks are kept for
+ * reuse, so once a script has warmed up its calls take no heap.
+ * lcl_stack_push returns n NULL entries, or NULL if memory runs out. */
+#define LCL_STACK_BLOCK 256
+
+lcl_value **lcl_stack_push(lcl_interp *interp, size_t n);
+void lcl_stack_pop(lcl_interp *interp, size_t n);
+
 typedef int (*lcl_c_proc_fn)(lcl_interp *,
                              int argc,
                              lcl_value **argv,
@@ -93,7 +174,7 @@ typedef struct {
 
 /* Upvalue: a captured variable from the enclosing scope */
 typedef struct {
-  char *name;           /* Variable name (owned, must be freed) */
+  const char *name;     /* Variable name (a symbol, reference owned) */
   int is_cell;          /* 1 if cell (mutable), 0 if immutable value */
   lcl_value *value;     /* The captured cell or value (refcounted) */
 } lcl_upvalue;
@@ -105,6 +186,9 @@ typedef struct {
   lcl_program *body;    /* Compiled body */
   int capture_ns;       /* Whether to capture current namespace */
   lcl_value *captured_ns; /* Captured namespace (if capture_ns) */
+  lcl_layout *layout;   /* Slots of this proc's call frames (may be NULL) */
+  unsigned long nnames_seen; /* env->nnames when shadows was computed */
+  int shadows;          /* a param/upvalue name is a cached command name */
 } lcl_proc;
 
 /* Build upvalues by capturing referenced variables from current environment.
@@ -113,4 +197,8 @@ typedef struct {
 lcl_upvalue *lcl_build_upvalues(lcl_interp *interp, const lcl_program *body,
                                 lcl_value *params_list, int *nout);
 
+/* Frame layout for a proc with these params and body.  Cached on the body,
+ * so procs made from the same body share it.  Returns a new reference. */
+lcl_layout *lcl_layout_for(lcl_value *params_list, lcl_program *body);
+
 #endif
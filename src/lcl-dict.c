@@ -1,7 +1,8 @@
+#include "lcl-alloc.h"
 #include "lcl-values.h"
 
 lcl_value *lcl_dict_new(void) {
-  lcl_value *v = (lcl_value *)calloc(1, sizeof(*v));
+  lcl_value *v = lcl_value_alloc();
 
   if (!v) return NULL;
 
@@ -10,7 +11,7 @@ lcl_value *lcl_dict_new(void) {
   v->as.dict.dictionary = hash_table_new();
 
   if (!v->as.dict.dictionary) {
-    free(v);
+    lcl_value_free(v);
     return NULL;
   }
 
@@ -34,6 +35,30 @@ lcl_result lcl_dict_get(const lcl_value *dict, const char *key,
   return LCL_OK;
 }
 
+lcl_result lcl_dict_get_key(const lcl_value *dict, const hash_key *k,
+                            lcl_value **out) {
+  if (dict->type != LCL_DICT) return LCL_ERROR;
+
+  if (!hash_table_get_key(dict->as.dict.dictionary, k, out)) {
+    return LCL_ERROR;
+  }
+
+  return LCL_OK;
+}
+
+/* Borrowed lookups: the value belongs to dict */
+lcl_value *lcl_dict_peek(const lcl_value *dict, const char *key) {
+  if (dict->type != LCL_DICT) return NULL;
+
+  return hash_table_peek(dict->as.dict.dictionary, key);
+}
+
+lcl_value *lcl_dict_peek_key(const lcl_value *dict, const hash_key *k) {
+  if (dict->type != LCL_DICT) return NULL;
+
+  return hash_table_peek_key(dict->as.dict.dictionary, k);
+}
+
 static lcl_value *lcl_dict_clone_shallow(lcl_value *dict) {
   hash_iter it = {0};
   const char *k;
@@ -44,7 +69,10 @@ static lcl_value *lcl_dict_clone_shallow(lcl_value *dict) {
   if (!new_dict) return NULL;
 
   while (hash_table_iterate(dict->as.dict.dictionary, &it, &k, &value)) {
-    hash_table_put(new_dict->as.dict.dictionary, k, value);
+    /* Keys are symbols, so their hashes come along for free */
+    hash_key key = hash_key_sym(k);
+
+    hash_table_put_key(new_dict->as.dict.dictionary, &key, value);
     lcl_ref_dec(value);
   }
 
@@ -59,11 +87,13 @@ lcl_result lcl_dict_put(lcl_value **dict_io, const char *key,
 
   if (dict->refc > 1) {
     lcl_value *new_dict = lcl_dict_clone_shallow(dict);
+
+    if (!new_dict) return LCL_ERROR;
     lcl_ref_dec(dict);
     *dict_io = dict = new_dict;
   }
 
-  free(dict->str_repr);
+  lcl_free(dict->str_repr);
   dict->str_repr = NULL;
 
   if (!hash_table_put(dict->as.dict.dictionary, key, value)) {
@@ -80,11 +110,13 @@ lcl_result lcl_dict_del(lcl_value **dict_io, const char *key) {
 
   if (dict->refc > 1) {
     lcl_value *new_dict = lcl_dict_clone_shallow(dict);
+
+    if (!new_dict) return LCL_ERROR;
     lcl_ref_dec(dict);
     *dict_io = dict = new_dict;
   }
 
-  free(dict->str_repr);
+  lcl_free(dict->str_repr);
   dict->str_repr = NULL;
 
 
@@ -110,3 +142,18 @@ lcl_result lcl_dict_iter(const lcl_value **dict_io, lcl_dict_it *it, const char
 
   return found ? LCL_OK : LCL_ERROR;
 }
+
+/* lcl_dict_iter without the reference: each value is borrowed from dict */
+lcl_result lcl_dict_next(const lcl_value *dict, lcl_dict_it *it,
+                         const char **key, lcl_value **value) {
+  hash_iter hit;
+  int found;
+
+  if (dict->type != LCL_DICT) return LCL_ERROR;
+
+  hit.i = it->i;
+  found = hash_table_next(dict->as.dict.dictionary, &hit, key, value);
+  it->i = hit.i;
+
+  return found ? LCL_OK : LCL_ERROR;
+}
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "hash-table.h"
+#include "lcl-alloc.h"
 #include "lcl-compile.h"
 #include "lcl-values.h"
 
@@ -19,11 +20,12 @@ void lcl_env_free(lcl_env *env) {
     lcl_ref_dec(env->global_ns);
   }
 
-  free(env);
+  hash_table_free(env->cmd_names);
+  lcl_free(env);
 }
 
 lcl_env *lcl_env_new(void) {
-  lcl_env *env = (lcl_env *)calloc(1, sizeof(*env));
+  lcl_env *env = (lcl_env *)lcl_calloc(1, sizeof(*env));
 
   if (!env) {
     return NULL;
@@ -32,7 +34,7 @@ lcl_env *lcl_env_new(void) {
   env->frame = lcl_frame_new(NULL);
 
   if (!env->frame) {
-    free(env);
+    lcl_free(env);
     return NULL;
   }
 
@@ -47,13 +49,108 @@ lcl_env *lcl_env_new(void) {
   return env;
 }
 
+/* ============================================================================
+ * Call-site caches
+ *
+ * A command whose name is a literal remembers the callee it resolved to
+ * (lcl_command.cache).  Only bindings that outlive the current call frames
+ * are cached - those in the root frame, in a namespace frame or in a
+ * namespace - and an entry holds while env->epoch is unchanged.  The epoch
+ * moves when:
+ *  - a name some call site cached is bound or rebound in any frame,
+ *  - anything is bound in a namespace frame, or one is pushed or popped,
+ *  - a proc whose params or upvalues use a cached name is called.
+ * Bindings made without lcl_env_let/lcl_env_var must invalidate on their
+ * own; lcl_ns_def does not, so namespaces filled through it must be
+ * complete before scripts run.
+ * ============================================================================ */
+
+static lcl_result env_get(lcl_env *env, const char *key, lcl_value **out,
+                          int *stable);
+
+int lcl_env_shadows_command(lcl_env *env, const char *name) {
+  lcl_value *unused = NULL;
+
+  return env->cmd_names && hash_table_get(env->cmd_names, name, &unused);
+}
+
+static void env_note_binding(lcl_env *env, lcl_frame *f, const char *name) {
+  if (!f->owns_locals || lcl_env_shadows_command(env, name)) {
+    env->epoch++;
+  }
+}
+
+/* Record that a call site depends on bindings of name */
+static int env_note_name(lcl_env *env, const char *name) {
+  if (lcl_env_shadows_command(env, name)) return 1;
+
+  if (!env->cmd_names) {
+    env->cmd_names = hash_table_new();
+    if (!env->cmd_names) return 0;
+  }
+
+  if (!hash_table_put(env->cmd_names, name, NULL)) return 0;
+
+  env->nnames++;
+
+  return 1;
+}
+
+lcl_value *lcl_call_cache_get(const lcl_env *env, const lcl_call_cache *cc) {
+  if (cc->callee && cc->env == (const void *)env &&
+      cc->epoch == env->epoch && cc->ns == env->current_ns) {
+    return lcl_ref_inc(cc->callee);
+  }
+
+  return NULL;
+}
+
+/* lcl_env_get_command for a call site with a literal name */
+lcl_result lcl_env_get_command_cached(lcl_env *env, const char *key,
+                                      lcl_call_cache *cc, lcl_value **out) {
+  char first[256];
+  const char *rest = NULL;
+  int stable = 0;
+
+  if (!env || !out) return LCL_ERROR;
+
+  *out = lcl_call_cache_get(env, cc);
+
+  if (*out) return LCL_OK;
+
+  if (env_get(env, key, out, &stable) != LCL_OK) {
+    return LCL_ERROR;
+  }
+
+  if (!stable ||
+      ((*out)->type != LCL_PROC && (*out)->type != LCL_CPROC)) {
+    return LCL_OK;
+  }
+
+  /* A qualified name also depends on its leading namespace binding */
+  if (!env_note_name(env, key) ||
+      (lcl_ns_split(key, first, sizeof(first), &rest) &&
+       !env_note_name(env, first))) {
+    return LCL_OK;
+  }
+
+  cc->callee = *out;
+  cc->ns = env->current_ns;
+  cc->env = env;
+  cc->epoch = env->epoch;
+
+  return LCL_OK;
+}
+
 lcl_result lcl_env_let(lcl_env *env, const char *name, lcl_value *value) {
   if (!env || !env->frame) return LCL_ERROR;
 
-  if (!hash_table_put(env->frame->locals, name, value)) {
+  if (!lcl_frame_put(env->frame, name, value)) {
     return LCL_ERROR;
   }
 
+  env_note_binding(env, env->frame, name);
+
   return LCL_OK;
 }
 
@@ -72,7 +169,8 @@ lcl_result lcl_env_var(lcl_env *env, const char *name, lcl_value *value) {
 
     if (!cell) return LCL_ERROR;
 
-    r = hash_table_put(env->frame->locals, name, cell) ? LCL_RC_OK : LCL_ERROR;
+    r = lcl_frame_put(env->frame, name, cell) ? LCL_RC_OK : LCL_ERROR;
+    env_note_binding(env, env->frame, name);
 
     lcl_ref_dec(cell);
 
@@ -81,19 +179,29 @@ lcl_result lcl_env_var(lcl_env *env, const char *name, lcl_value *value) {
 }
 
 /* Simple lookup without qualified names */
-static lcl_result env_get_simple(lcl_env *env, const char *key, lcl_value **out) {
-  lcl_value *b = NULL;
+static lcl_result env_get_simple(lcl_env *env, const hash_key *key,
+                                 lcl_value **out, int *stable) {
+  lcl_frame *f;
+
+  if (stable) {
+    /* Walk frame by frame to learn which one holds the binding */
+    for (f = env->frame; f; f = f->parent) {
+      if (lcl_frame_lookup_key(f, key, out)) {
+        *stable = !f->parent || !f->owns_locals;
+        return LCL_OK;
+      }
+    }
 
-  if (lcl_frame_get_binding(env->frame, key, &b)) {
-    *out = b;
+    *stable = 1;
+  } else if (lcl_frame_get_binding_key(env->frame, key, out)) {
     return LCL_OK;
   }
 
-  if (env->current_ns && lcl_ns_get(env->current_ns, key, out) == LCL_OK) {
+  if (env->current_ns && lcl_ns_get_key(env->current_ns, key, out) == LCL_OK) {
     return LCL_OK;
   }
 
-  if (env->global_ns && lcl_ns_get(env->global_ns, key, out) == LCL_OK) {
+  if (env->global_ns && lcl_ns_get_key(env->global_ns, key, out) == LCL_OK) {
     return LCL_OK;
   }
 
@@ -106,17 +214,13 @@ lcl_result lcl_env_get_command(lcl_env *env, const char *key, lcl_value **out) {
   return lcl_env_get_value(env, key, out);
 }
 
-lcl_result lcl_env_get_value(lcl_env *env, const char *key, lcl_value **out) {
+/* Lookup of a qualified name a::b::c, once a direct lookup has failed */
+static lcl_result env_get_qualified(lcl_env *env, const char *key,
+                                    lcl_value **out, int *stable) {
   char first[256];
   const char *rest = NULL;
   lcl_value *current = NULL;
-
-  if (!env || !out) return LCL_ERROR;
-
-  /* First try direct lookup (handles command names containing ::) */
-  if (env_get_simple(env, key, out) == LCL_OK) {
-    return LCL_OK;
-  }
+  hash_key k;
 
   /* Check for qualified name (contains ::) */
   if (!lcl_ns_split(key, first, sizeof(first), &rest)) {
@@ -125,7 +229,9 @@ lcl_result lcl_env_get_value(lcl_env *env, const char *key, lcl_value **out) {
   }
 
   /* Look up first part in env */
-  if (env_get_simple(env, first, &current) != LCL_OK) {
+  k = hash_key_make(first);
+
+  if (env_get_simple(env, &k, &current, stable) != LCL_OK) {
     return LCL_ERROR;
   }
 
@@ -165,6 +271,40 @@ lcl_result lcl_env_get_value(lcl_env *env, const char *key, lcl_value **out) {
   return LCL_OK;
 }
 
+/* Full lookup.  If stable is given, it is set to whether the binding
+ * found outlives the current call frames (see the call-site caches). */
+static lcl_result env_get(lcl_env *env, const char *key, lcl_value **out,
+                          int *stable) {
+  hash_key k;
+
+  if (!env || !out) return LCL_ERROR;
+
+  /* First try direct lookup (handles command names containing ::) */
+  k = hash_key_make(key);
+
+  if (env_get_simple(env, &k, out, stable) == LCL_OK) {
+    return LCL_OK;
+  }
+
+  return env_get_qualified(env, key, out, stable);
+}
+
+lcl_result lcl_env_get_value(lcl_env *env, const char *key, lcl_value **out) {
+  return env_get(env, key, out, NULL);
+}
+
+/* lcl_env_get_value for a name that is a symbol, such as a variable in a
+ * compiled word: its hash is known and matches are found by pointer. */
+lcl_result lcl_env_get_sym(lcl_env *env, const char *sym, lcl_value **out) {
+  hash_key k = hash_key_sym(sym);
+
+  if (env_get_simple(env, &k, out, NULL) == LCL_OK) {
+    return LCL_OK;
+  }
+
+  return env_get_qualified(env, sym, out, NULL);
+}
+
 lcl_result lcl_env_set_bang(lcl_env *env, const char *name, lcl_value *value) {
   if (!env) return LCL_ERROR;
 
@@ -174,7 +314,7 @@ lcl_result lcl_env_set_bang(lcl_env *env, const char *name, lcl_value *value) {
     while (f) {
       lcl_value *b = NULL;
 
-      if (hash_table_get(f->locals, name, &b)) {
+      if (lcl_frame_lookup(f, name, &b)) {
         if (b->type == LCL_CELL) {
           lcl_result r = lcl_cell_set(b, value);
           lcl_ref_dec(b);
@@ -1,15 +1,22 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "lcl-alloc.h"
 #include "lcl-eval.h"
 #include "lcl-compile.h"
 #include "lcl-lex.h"
 #include "lcl-values.h"
+#include "lcl-vm.h"
+
+/* Raw argument words a special form gets from the C stack */
+#define LCL_RAW_LOCAL 16
 
 /* Forward declaration */
 int lcl_eval_word(lcl_interp *interp, const lcl_word *w,
                   lcl_value **out);
 
+/* Evaluate the argument words of cmd into a slice of the argument stack,
+ * which the caller pops once it is done with them */
 static int build_argv(lcl_interp *interp, const lcl_command *cmd, int *argc_out,
                       lcl_value ***argv_out) {
   int i;
@@ -17,13 +24,13 @@ static int build_argv(lcl_interp *interp, const lcl_command *cmd, int *argc_out,
   int rc;
   lcl_value **argv;
 
-  if (argc < 0) {
+  if (argc <= 0) {
     *argc_out = 0;
     *argv_out = NULL;
     return LCL_RC_OK;
   }
   
-  argv = (lcl_value **)calloc((size_t)argc, sizeof(*argv));
+  argv = lcl_stack_push(interp, (size_t)argc);
   
   if (!argv) return LCL_RC_ERR;
   
@@ -35,7 +42,7 @@ static int build_argv(lcl_interp *interp, const lcl_command *cmd, int *argc_out,
         lcl_ref_dec(argv[i]);
       }
       
-      free(argv);
+      lcl_stack_pop(interp, (size_t)argc);
 
       return rc;
     }
@@ -47,6 +54,28 @@ static int build_argv(lcl_interp *interp, const lcl_command *cmd, int *argc_out,
   return LCL_RC_OK;  
 }
 
+static int proc_binds_command_name(lcl_interp *interp, const lcl_proc *p) {
+  int n = (int)lcl_list_len(p->params);
+  int shadows = 0;
+  int i;
+
+  for (i = 0; i < p->nupvals && !shadows; i++) {
+    shadows = lcl_env_shadows_command(&interp->env, p->upvals[i].name);
+  }
+
+  for (i = 0; i < n && !shadows; i++) {
+    lcl_value *nameV = NULL;
+
+    if (lcl_list_get(p->params, i, &nameV) == LCL_OK) {
+      shadows = lcl_env_shadows_command(&interp->env,
+                                        lcl_value_to_string(nameV));
+      lcl_ref_dec(nameV);
+    }
+  }
+
+  return shadows;
+}
+
 int lcl_call_user_proc(lcl_interp *interp, lcl_proc *p,
                        int argc, lcl_value **argv, lcl_value **out) {
   int i;
@@ -54,7 +83,8 @@ int lcl_call_user_proc(lcl_interp *interp, lcl_proc *p,
   lcl_env saved = interp->env;
   /* Use caller's frame as parent for command lookup - no cycle because proc
    * doesn't store a reference to this frame (uses upvalues instead) */
-  lcl_frame *child = lcl_frame_new(saved.frame);
+  lcl_frame *child = p->layout ? lcl_frame_new_slots(saved.frame, p->layout)
+                               : lcl_frame_new(saved.frame);
 
   if (!child) {
     return LCL_RC_ERR;
@@ -76,20 +106,43 @@ int lcl_call_user_proc(lcl_interp *interp, lcl_proc *p,
     return LCL_RC_ERR;
   }
 
+  /* Params and upvalues bind names without going through lcl_env_let, so
+   * if one of them is a cached command name, drop the call-site caches */
+  if (interp->env.cmd_names) {
+    if (p->nnames_seen != interp->env.nnames) {
+      p->shadows = proc_binds_command_name(interp, p);
+      p->nnames_seen = interp->env.nnames;
+    }
+
+    if (p->shadows) {
+      interp->env.epoch++;
+    }
+  }
+
   /* Inject upvalues into the child frame as regular bindings.
-   * hash_table_put will handle the refcount increment. */
+   * lcl_frame_put_key will handle the refcount increment; the names are
+   * symbols, so their keys need no hashing. */
   for (i = 0; i < p->nupvals; i++) {
-    hash_table_put(child->locals, p->upvals[i].name, p->upvals[i].value);
-  }
+    hash_key k = hash_key_sym(p->upvals[i].name);
 
-  for (i = 0; i < argc; i++) {
-    lcl_value *nameV = NULL;
-    const char *pname;
+    lcl_frame_put_key(child, &k, p->upvals[i].value);
+  }
 
-    lcl_list_get(p->params, i, &nameV);
-    pname = lcl_value_to_string(nameV);
-    lcl_env_let(&interp->env, pname, argv[i]);
-    lcl_ref_dec(nameV);
+  if (p->layout && p->layout->nparams == argc) {
+    /* Params occupy the leading slots in order */
+    for (i = 0; i < argc; i++) {
+      child->slots[i] = lcl_ref_inc(argv[i]);
+    }
+  } else {
+    for (i = 0; i < argc; i++) {
+      lcl_value *nameV = NULL;
+      const char *pname;
+
+      lcl_list_get(p->params, i, &nameV);
+      pname = lcl_value_to_string(nameV);
+      lcl_env_let(&interp->env, pname, argv[i]);
+      lcl_ref_dec(nameV);
+    }
   }
 
   rc = lcl_eval_program(interp, (lcl_program *)p->body, out);
@@ -114,17 +167,15 @@ int lcl_eval_word(lcl_interp *interp, const lcl_word *w,
     switch (wp->kind) {
     case LCL_WP_VAR: {
       lcl_value *val = NULL;
-      if (lcl_env_get_value(&interp->env, wp->as.var.name, &val) != LCL_OK) {
+      if (lcl_env_get_sym(&interp->env, wp->as.var.name, &val) != LCL_OK) {
         return LCL_RC_ERR;
       }
       /* Unwrap cell if needed */
       if (val->type == LCL_CELL) {
-        lcl_value *inner = NULL;
-        if (lcl_cell_get(val, &inner) != LCL_OK) {
-          lcl_ref_dec(val);
-          return LCL_RC_ERR;
-        }
+        lcl_value *inner = lcl_ref_inc(lcl_cell_peek(val));
+
         lcl_ref_dec(val);
+        if (!inner) return LCL_RC_ERR;
         val = inner;
       }
       *out = val;
@@ -143,28 +194,41 @@ int lcl_eval_word(lcl_interp *interp, const lcl_word *w,
   return lcl_eval_word_to_str(interp, w, out);
 }
 
-int lcl_call_from_words(lcl_interp *interp, const lcl_command *cmd,
-                        lcl_value **out) {
-  lcl_value *callee = NULL;
-  int rc;
-
-  if (cmd->argc == 0) {
-    *out = lcl_value_new_string("");
+/* A word that is one literal piece, e.g. a plain command name */
+int lcl_word_is_name(const lcl_word *w) {
+  return w->np == 1 && w->wp[0].kind == LCL_WP_LIT;
+}
 
-    return LCL_RC_OK;
+/* Turn the evaluated first word of a command of argc words into something
+ * to call.  Consumes head.  Either sets *callee to a procedure, or - for a
+ * single-word command whose head names no procedure - sets *callee to
+ * NULL and *out to the command's value.  cc is the command's call-site
+ * cache when its first word is a literal name, else NULL. */
+int lcl_resolve_callee(lcl_interp *interp, lcl_value *head, int argc,
+                       lcl_call_cache *cc, lcl_value **callee,
+                       lcl_value **out) {
+  lcl_value *name;
+  lcl_result found;
+
+  *callee = NULL;
+
+  if (!head) {
+    head = lcl_string_empty();
+    if (!head) return LCL_RC_ERR;
   }
 
-  /* Evaluate first word to get command/callee value */
-  rc = lcl_eval_word(interp, &cmd->w[0], &callee);
-  if (rc != LCL_RC_OK) return rc;
-
   /* Look up command by name if result is a string or convertible to one */
-  if (callee->type == LCL_STRING) {
-    lcl_value *name = callee;
-    callee = NULL;
-    if (lcl_env_get_command(&interp->env, lcl_value_to_string(name), &callee) != LCL_OK) {
+  if (head->type == LCL_STRING) {
+    name = head;
+    found = cc ? lcl_env_get_command_cached(&interp->env,
+                                            lcl_value_to_string(name), cc,
+                                            callee)
+               : lcl_env_get_command(&interp->env, lcl_value_to_string(name),
+                                     callee);
+    if (found != LCL_OK) {
       /* If lookup fails and this is a single-word command, return the value itself */
-      if (cmd->argc == 1) {
+      *callee = NULL;
+      if (argc == 1) {
         *out = name;
         return LCL_RC_OK;
       }
@@ -173,51 +237,102 @@ int lcl_call_from_words(lcl_interp *interp, const lcl_command *cmd,
     }
     lcl_ref_dec(name);
     /* Check if the looked-up value is callable; if not and single-word, return it */
-    if (callee->type != LCL_PROC && callee->type != LCL_CPROC) {
-      if (cmd->argc == 1) {
-        *out = callee;
+    if ((*callee)->type != LCL_PROC && (*callee)->type != LCL_CPROC) {
+      if (argc == 1) {
+        *out = *callee;
+        *callee = NULL;
         return LCL_RC_OK;
       }
       /* Non-callable with args - error */
-      lcl_ref_dec(callee);
+      lcl_ref_dec(*callee);
+      *callee = NULL;
       return LCL_RC_ERR;
     }
-  } else if (callee->type != LCL_PROC && callee->type != LCL_CPROC) {
+  } else if (head->type != LCL_PROC && head->type != LCL_CPROC) {
     /* Non-callable value - for single-word command, return the value itself */
-    if (cmd->argc == 1) {
-      *out = callee;
+    if (argc == 1) {
+      *out = head;
       return LCL_RC_OK;
     }
     /* Otherwise try to look it up as a command name */
-    {
-      lcl_value *name = callee;
-      callee = NULL;
-      if (lcl_env_get_command(&interp->env, lcl_value_to_string(name), &callee) != LCL_OK) {
-        lcl_ref_dec(name);
-        return LCL_RC_ERR;
-      }
+    name = head;
+    if (lcl_env_get_command(&interp->env, lcl_value_to_string(name), callee) != LCL_OK) {
+      *callee = NULL;
       lcl_ref_dec(name);
+      return LCL_RC_ERR;
     }
+    lcl_ref_dec(name);
+  } else {
+    *callee = head;
+  }
+
+  return LCL_RC_OK;
+}
+
+/* Call a resolved procedure value with evaluated arguments */
+int lcl_invoke(lcl_interp *interp, lcl_value *callee,
+               int argc, lcl_value **argv, lcl_value **out) {
+  if (callee->type == LCL_CPROC) {
+    return callee->as.c_proc.fn->fn.proc(interp, argc, argv, out);
+  }
+
+  if (callee->type == LCL_PROC) {
+    return lcl_call_user_proc(interp, (lcl_proc *)callee->as.procedure.proc,
+                              argc, argv, out);
+  }
+
+  return LCL_RC_ERR;
+}
+
+int lcl_call_from_words(lcl_interp *interp, const lcl_command *cmd,
+                        lcl_value **out) {
+  lcl_value *callee = NULL;
+  lcl_value *head = NULL;
+  lcl_call_cache *cc = NULL;
+  int rc;
+
+  if (cmd->argc == 0) {
+    *out = lcl_string_empty();
+
+    return LCL_RC_OK;
+  }
+
+  if (lcl_word_is_name(&cmd->w[0])) {
+    cc = (lcl_call_cache *)&cmd->cache;
+    callee = lcl_call_cache_get(&interp->env, cc);
+  }
+
+  if (!callee) {
+    /* Evaluate first word to get command/callee value */
+    rc = lcl_eval_word(interp, &cmd->w[0], &head);
+    if (rc != LCL_RC_OK) return rc;
+
+    rc = lcl_resolve_callee(interp, head, cmd->argc, cc, &callee, out);
+    if (rc != LCL_RC_OK || !callee) return rc;
   }
 
   if (callee->type == LCL_CPROC && callee->as.c_proc.fn->kind == LCL_CK_SPECIAL) {
     int spec_argc = cmd->argc - 1;
-    const lcl_word **raw = NULL;
+    const lcl_word *small[LCL_RAW_LOCAL];
+    const lcl_word **raw = small;
     int i;
 
-    if (spec_argc > 0) {
-      raw = (const lcl_word **)malloc((size_t)spec_argc * sizeof(*raw));
+    /* Special forms take the words themselves; the VM keeps these arrays
+     * with its code, here they go on the C stack unless there are many */
+    if (spec_argc > LCL_RAW_LOCAL) {
+      raw = (const lcl_word **)lcl_malloc((size_t)spec_argc * sizeof(*raw));
       if (!raw) {
         lcl_ref_dec(callee);
         return LCL_RC_ERR;
       }
-      for (i = 0; i < spec_argc; i++) {
-        raw[i] = &cmd->w[i + 1];
-      }
+    }
+
+    for (i = 0; i < spec_argc; i++) {
+      raw[i] = &cmd->w[i + 1];
     }
 
     rc = callee->as.c_proc.fn->fn.spec(interp, spec_argc, raw, out);
-    free(raw);
+    if (raw != small) lcl_free(raw);
     lcl_ref_dec(callee);
 
     return rc;
@@ -235,31 +350,54 @@ int lcl_call_from_words(lcl_interp *interp, const lcl_command *cmd,
       return rc;
     }
 
-    if (callee->type == LCL_CPROC) {
-      rc = callee->as.c_proc.fn->fn.proc(interp, argc, argv, out);
-    } else if (callee->type == LCL_PROC) {
-      rc = lcl_call_user_proc(interp, (lcl_proc *)callee->as.procedure.proc,
-                              argc, argv, out);
-    } else {
-      rc = LCL_RC_ERR;
-    }
+    rc = lcl_invoke(interp, callee, argc, argv, out);
 
     for (i = 0; i < argc; i++) lcl_ref_dec(argv[i]);
-    free(argv);
+    if (argc) lcl_stack_pop(interp, (size_t)argc);
     lcl_ref_dec(callee);
     
     return rc;
   }
 }
 
+/* Compile a word that is used as a script body (if/while/for/foreach/lambda).
+ * A braced word is a plain literal, so its program is compiled on first use
+ * and cached on the word; anything else is substituted and compiled afresh.
+ * Returns a new program reference, or NULL if the body does not compile. */
+lcl_program *lcl_word_program(lcl_interp *interp, const lcl_word *w,
+                              const char *file) {
+  lcl_value *src = NULL;
+  lcl_program *p;
+
+  if (w->braced && w->np == 1 && w->wp[0].kind == LCL_WP_LIT) {
+    if (!w->program) {
+      ((lcl_word *)w)->program = lcl_program_compile(w->wp[0].as.lit.s, file);
+    }
+
+    return lcl_program_ref_inc(w->program);
+  }
+
+  if (lcl_eval_word_to_str(interp, w, &src) != LCL_RC_OK) {
+    return NULL;
+  }
+
+  p = lcl_program_compile(lcl_value_to_string(src), file);
+  lcl_ref_dec(src);
+
+  return p;
+}
+
 int lcl_eval_string(lcl_interp *interp, const char *src, lcl_value **out) {
-  lcl_program *P = lcl_program_compile(src, "<string>");
-  int rc;
+  lcl_interp *prev = lcl_interp_enter(interp);
+  lcl_program *P = lcl_cache_compile(&interp->cache, src, "<string>");
+  int rc = LCL_RC_ERR;
 
-  if (!P) return LCL_RC_ERR;
+  if (P) {
+    rc = lcl_eval_program(interp, P, out);
+    lcl_program_ref_dec(P);
+  }
 
-  rc = lcl_eval_program(interp, P, out);
-  lcl_program_free(P);
+  lcl_interp_leave(prev);
 
   return rc;
 }
@@ -273,19 +411,14 @@ int lcl_eval_word_to_str(lcl_interp *interp,
   int i;
 
   if (!w || w->np == 0) {
-    *out = lcl_value_new_string("");
+    *out = lcl_string_empty();
     return *out ? LCL_RC_OK : LCL_RC_ERR;
   }
 
   /* Fast path: single literal piece */
   if (w->np == 1 && w->wp[0].kind == LCL_WP_LIT) {
-    char *s = (char *)malloc(w->wp[0].as.lit.n + 1);
-    if (!s) return LCL_RC_ERR;
-    memcpy(s, w->wp[0].as.lit.s, w->wp[0].as.lit.n);
-    s[w->wp[0].as.lit.n] = '\0';
-    *out = lcl_value_new_string(s);
-    free(s);
-    return *out ? LCL_RC_OK : LCL_RC_ERR;
+    *out = lcl_ref_inc(w->wp[0].as.lit.value);
+    return LCL_RC_OK;
   }
 
   /* Build string from pieces */
@@ -299,8 +432,8 @@ int lcl_eval_word_to_str(lcl_interp *interp,
         size_t newcap = cap ? cap * 2 : 64;
         char *newbuf;
         while (newcap < need) newcap *= 2;
-        newbuf = (char *)realloc(buf, newcap);
-        if (!newbuf) { free(buf); return LCL_RC_ERR; }
+        newbuf = (char *)lcl_realloc(buf, newcap);
+        if (!newbuf) { lcl_free(buf); return LCL_RC_ERR; }
         buf = newbuf;
         cap = newcap;
       }
@@ -314,25 +447,16 @@ int lcl_eval_word_to_str(lcl_interp *interp,
       size_t slen;
       size_t need;
 
-      if (lcl_env_get_value(&interp->env, wp->as.var.name, &val) != LCL_OK) {
-        free(buf);
+      if (lcl_env_get_sym(&interp->env, wp->as.var.name, &val) != LCL_OK) {
+        lcl_free(buf);
         return LCL_RC_ERR;
       }
 
-      /* Unwrap cell if needed */
-      if (val->type == LCL_CELL) {
-        lcl_value *inner = NULL;
-        if (lcl_cell_get(val, &inner) != LCL_OK) {
-          lcl_ref_dec(val);
-          free(buf);
-          return LCL_RC_ERR;
-        }
-        lcl_ref_dec(val);
-        val = inner;
-      }
-
-      s = lcl_value_to_string(val);
-      slen = strlen(s);
+      /* Read through a cell; the cell keeps its contents alive until
+       * val is dropped */
+      s = lcl_value_to_string_n(val->type == LCL_CELL ? lcl_cell_peek(val)
+                                                      : val,
+                                &slen);
       need = len + slen + 1;
 
       if (need > cap) {
@@ -343,11 +467,11 @@ int lcl_eval_word_to_str(lcl_interp *interp,
           newcap *= 2;
         }
 
-        newbuf = (char *)realloc(buf, newcap);
+        newbuf = (char *)lcl_realloc(buf, newcap);
 
         if (!newbuf) {
           lcl_ref_dec(val);
-          free(buf);
+          lcl_free(buf);
           return LCL_RC_ERR;
         }
 
@@ -368,12 +492,11 @@ int lcl_eval_word_to_str(lcl_interp *interp,
       int rc = lcl_eval_program(interp, wp->as.sub.program, &result);
 
       if (rc != LCL_RC_OK) {
-        free(buf);
+        lcl_free(buf);
         return rc;
       }
 
-      s = lcl_value_to_string(result);
-      slen = strlen(s);
+      s = lcl_value_to_string_n(result, &slen);
       need = len + slen + 1;
 
       if (need > cap) {
@@ -384,11 +507,11 @@ int lcl_eval_word_to_str(lcl_interp *interp,
           newcap *= 2;
         }
 
-        newbuf = (char *)realloc(buf, newcap);
+        newbuf = (char *)lcl_realloc(buf, newcap);
 
         if (!newbuf) {
           lcl_ref_dec(result);
-          free(buf);
+          lcl_free(buf);
           return LCL_RC_ERR;
         }
 
@@ -406,14 +529,14 @@ int lcl_eval_word_to_str(lcl_interp *interp,
 
   /* Null-terminate */
   if (len == 0) {
-    free(buf);
-    *out = lcl_value_new_string("");
+    lcl_free(buf);
+    *out = lcl_string_empty();
   } else {
     if (len >= cap) {
-      char *newbuf = (char *)realloc(buf, len + 1);
+      char *newbuf = (char *)lcl_realloc(buf, len + 1);
 
       if (!newbuf) {
-        free(buf);
+        lcl_free(buf);
         return LCL_RC_ERR;
       }
 
@@ -422,7 +545,7 @@ int lcl_eval_word_to_str(lcl_interp *interp,
     
     buf[len] = '\0';
     *out = lcl_value_new_string(buf);
-    free(buf);
+    lcl_free(buf);
   }
 
   return *out ? LCL_RC_OK : LCL_RC_ERR;
@@ -430,38 +553,22 @@ int lcl_eval_word_to_str(lcl_interp *interp,
 
 int lcl_eval_program(lcl_interp *interp, const lcl_program *pr,
                      lcl_value **out) {
-  int i;
-  lcl_return_code rc = LCL_RC_OK;
   lcl_value *last = NULL;
+  int rc;
 
   if (interp->max_depth && interp->depth >= interp->max_depth) {
     return LCL_RC_ERR;
   }
 
-  interp->depth++;
-
-  for (i = 0; i < pr->ncmd; i++) {
-    lcl_command *cmd = &pr->cmd[i];
+  /* Flatten the program on first run; later runs reuse the code */
+  if (!pr->code) {
+    ((lcl_program *)pr)->code = lcl_code_compile((lcl_program *)pr);
 
-    if (last) {
-      lcl_ref_dec(last);
-      last = NULL;
-    }
-
-    rc = lcl_call_from_words(interp, cmd, &last);
-
-    /* Propagate RETURN - let caller (e.g., lcl_call_user_proc) handle it */
-    if (rc == LCL_RC_RETURN) {
-      break;
-    }
-
-    if (rc != LCL_RC_OK) {
-      interp->err_line = cmd->line;
-      interp->err_file = pr->file;
-      break;
-    }
+    if (!pr->code) return LCL_RC_ERR;
   }
 
+  interp->depth++;
+  rc = lcl_vm_exec(interp, pr, &last);
   interp->depth--;
 
   if (out) {
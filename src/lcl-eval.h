@@ -6,6 +6,15 @@
 int lcl_call_user_proc(lcl_interp *interp, lcl_proc *p,
                        int argc, lcl_value **argv, lcl_value **out);
 
+int lcl_word_is_name(const lcl_word *w);
+
+int lcl_resolve_callee(lcl_interp *interp, lcl_value *head, int argc,
+                       lcl_call_cache *cc, lcl_value **callee,
+                       lcl_value **out);
+
+int lcl_invoke(lcl_interp *interp, lcl_value *callee,
+               int argc, lcl_value **argv, lcl_value **out);
+
 int lcl_call_from_words(lcl_interp *interp, const lcl_command *cmd,
                         lcl_value **out);
 
@@ -20,6 +29,9 @@ int lcl_eval_word_to_str(lcl_interp *interp, const lcl_word *w,
 int lcl_eval_word(lcl_interp *interp, const lcl_word *w,
                   lcl_value **out);
 
+lcl_program *lcl_word_program(lcl_interp *interp, const lcl_word *w,
+                              const char *file);
+
 lcl_return_code lcl_call(lcl_interp *interp, const lcl_command *command,
                          lcl_value **out);
 
@@ -0,0 +1,541 @@
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+
+#include "lcl-alloc.h"
+#include "lcl-eval.h"
+#include "lcl-expr.h"
+#include "lcl-sym.h"
+#include "lcl-values.h"
+
+/**
+   Expression code
+
+   The parser emits straight into a register program: an operand lands in
+   the register its depth in the expression gives it, and a binary
+   operator combines r[r] and r[r + 1] into r[r].  Registers are plain
+   lcl_numbers on the C stack, so nothing is allocated while an
+   expression runs except by the variables and scripts it reads.
+**/
+
+typedef enum {
+  X_NUM,   /* r = num */
+  X_VAR,   /* r = value of variable p */
+  X_CMD,   /* r = result of script p */
+  X_NEG,   /* r = -r */
+  X_NOT,   /* r = !r */
+  X_BOOL,  /* r = r != 0 */
+  X_ADD,   /* r = r op r+1 ... */
+  X_SUB,
+  X_MUL,
+  X_DIV,
+  X_MOD,
+  X_LT,
+  X_LE,
+  X_GT,
+  X_GE,
+  X_EQ,
+  X_NE,    /* ... through here */
+  X_JZ,    /* if r is 0, continue at a */
+  X_JNZ,   /* if r is not 0, continue at a */
+  X_END
+} expr_op;
+
+typedef struct {
+  int op;
+  int r;
+  int a;
+  lcl_number num;
+  const void *p;        /* variable name (a symbol) or script */
+  int slot;             /* VAR: slot of the name in `layout`, or -1 */
+  lcl_layout *layout;   /* VAR: layout slot was resolved against */
+} expr_insn;
+
+struct lcl_expr {
+  expr_insn *insn;
+  int ninsn;
+  int cap;
+};
+
+/* Registers, and so nesting of operands, an expression may use */
+#define LCL_EXPR_MAX_REGS 32
+
+/* Nesting of parentheses and unary operators */
+#define LCL_EXPR_MAX_DEPTH 256
+
+typedef struct {
+  const char *s;
+  lcl_expr *e;
+  int depth;
+} expr_parser;
+
+/* ============================================================================
+ * Parsing
+ * ============================================================================ */
+
+static int emit(lcl_expr *e, int op, int r) {
+  expr_insn *in;
+
+  if (e->ninsn >= e->cap) {
+    int newcap = e->cap ? e->cap * 2 : 8;
+    void *nv = lcl_realloc(e->insn, (size_t)newcap * sizeof(*e->insn));
+
+    if (!nv) return -1;
+
+    e->insn = (expr_insn *)nv;
+    e->cap = newcap;
+  }
+
+  in = &e->insn[e->ninsn];
+  memset(in, 0, sizeof(*in));
+  in->op = op;
+  in->r = r;
+  in->slot = -1;
+
+  return e->ninsn++;
+}
+
+static void skip_ws(expr_parser *ps) {
+  while (isspace((unsigned char)*ps->s)) ps->s++;
+}
+
+/* Take the operator op if it comes next */
+static int accept(expr_parser *ps, const char *op) {
+  size_t n = strlen(op);
+
+  skip_ws(ps);
+
+  if (strncmp(ps->s, op, n) != 0) return 0;
+
+  ps->s += n;
+  return 1;
+}
+
+static int is_name(int c) {
+  return c == '_' || c == ':' || isalnum(c);
+}
+
+static int parse_or(expr_parser *ps, int r);
+
+static int parse_number(expr_parser *ps, int r) {
+  const char *start = ps->s;
+  const char *p = start;
+  char *end;
+  int at;
+
+  while (isdigit((unsigned char)*p)) p++;
+
+  if (*p == '.') {
+    p++;
+    while (isdigit((unsigned char)*p)) p++;
+  }
+
+  if ((*p == 'e' || *p == 'E') &&
+      (isdigit((unsigned char)p[1]) ||
+       ((p[1] == '+' || p[1] == '-') && isdigit((unsigned char)p[2])))) {
+    p += 2;
+    while (isdigit((unsigned char)*p)) p++;
+  }
+
+  if (p == start || (p == start + 1 && *start == '.')) return 0;
+
+  if ((at = emit(ps->e, X_NUM, r)) < 0) return 0;
+
+  /* Digits past the range of a long are a double, as in lcl-num.c */
+  errno = 0;
+  ps->e->insn[at].num.i = strtol(start, &end, 10);
+  ps->e->insn[at].num.is_int = end == p && errno != ERANGE;
+
+  if (!ps->e->insn[at].num.is_int) {
+    ps->e->insn[at].num.f = strtod(start, NULL);
+  }
+
+  ps->s = p;
+  return 1;
+}
+
+static int parse_var(expr_parser *ps, int r) {
+  const char *name = ps->s;
+  size_t n = 0;
+  int at;
+
+  if (*name == '{') {
+    name++;
+
+    while (name[n] && name[n] != '}') n++;
+
+    if (!name[n] || n == 0) return 0;
+
+    ps->s = name + n + 1;
+  } else {
+    if (!isalpha((unsigned char)*name) && *name != '_') return 0;
+
+    while (is_name((unsigned char)name[n])) n++;
+
+    ps->s = name + n;
+  }
+
+  if ((at = emit(ps->e, X_VAR, r)) < 0) return 0;
+
+  ps->e->insn[at].p = lcl_sym_intern_n(name, n);
+  return ps->e->insn[at].p != NULL;
+}
+
+/* A bracketed script, from just after its '[' */
+static int parse_script(expr_parser *ps, int r) {
+  const char *start = ps->s;
+  const char *p = start;
+  int depth = 1;
+  char *src;
+  int at;
+
+  for (; *p; p++) {
+    if (*p == '[') depth++;
+    if (*p == ']' && --depth == 0) break;
+  }
+
+  if (!*p) return 0;
+
+  src = (char *)lcl_malloc((size_t)(p - start) + 1);
+  if (!src) return 0;
+
+  memcpy(src, start, (size_t)(p - start));
+  src[p - start] = '\0';
+
+  if ((at = emit(ps->e, X_CMD, r)) >= 0) {
+    ps->e->insn[at].p = lcl_program_compile(src, "<expr>");
+  }
+
+  lcl_free(src);
+  ps->s = p + 1;
+
+  return at >= 0 && ps->e->insn[at].p != NULL;
+}
+
+static int parse_unary(expr_parser *ps, int r) {
+  int ok;
+
+  if (r >= LCL_EXPR_MAX_REGS || ps->depth >= LCL_EXPR_MAX_DEPTH) return 0;
+
+  skip_ws(ps);
+
+  switch (*ps->s) {
+  case '-':
+  case '+':
+  case '!': {
+    char c = *ps->s++;
+
+    ps->depth++;
+    ok = parse_unary(ps, r);
+    ps->depth--;
+
+    if (!ok) return 0;
+    if (c == '-') return emit(ps->e, X_NEG, r) >= 0;
+    if (c == '!') return emit(ps->e, X_NOT, r) >= 0;
+    return 1;
+  }
+  case '(':
+    ps->s++;
+    ps->depth++;
+    ok = parse_or(ps, r);
+    ps->depth--;
+
+    return ok && accept(ps, ")");
+  case '$':
+    ps->s++;
+    return parse_var(ps, r);
+  case '[':
+    ps->s++;
+    return parse_script(ps, r);
+  default:
+    return parse_number(ps, r);
+  }
+}
+
+/* Binary operators of one precedence level; levels[] runs loosest first */
+typedef struct {
+  const char *text;
+  int op;
+} expr_binop;
+
+static const expr_binop mul_ops[] = {
+  {"*", X_MUL}, {"/", X_DIV}, {"%", X_MOD}, {NULL, 0}
+};
+
+static const expr_binop add_ops[] = {
+  {"+", X_ADD}, {"-", X_SUB}, {NULL, 0}
+};
+
+static const expr_binop rel_ops[] = {
+  {"<=", X_LE}, {">=", X_GE}, {"<", X_LT}, {">", X_GT}, {NULL, 0}
+};
+
+static const expr_binop eq_ops[] = {
+  {"==", X_EQ}, {"!=", X_NE}, {NULL, 0}
+};
+
+static int parse_level(expr_parser *ps, int r, int level);
+
+static const expr_binop *const levels[] = { eq_ops, rel_ops, add_ops, mul_ops };
+
+#define NLEVELS ((int)(sizeof(levels) / sizeof(levels[0])))
+
+static int parse_operand(expr_parser *ps, int r, int level) {
+  return level + 1 < NLEVELS ? parse_level(ps, r, level + 1)
+                             : parse_unary(ps, r);
+}
+
+static int parse_level(expr_parser *ps, int r, int level) {
+  if (!parse_operand(ps, r, level)) return 0;
+
+  for (;;) {
+    const expr_binop *b;
+
+    for (b = levels[level]; b->text; b++) {
+      if (accept(ps, b->text)) break;
+    }
+
+    if (!b->text) return 1;
+
+    if (r + 1 >= LCL_EXPR_MAX_REGS || !parse_operand(ps, r + 1, level) ||
+        emit(ps->e, b->op, r) < 0) {
+      return 0;
+    }
+  }
+}
+
+/* && and ||: the right side only runs if the left does not decide */
+static int parse_logic(expr_parser *ps, int r, const char *text, int jump,
+                       int (*operand)(expr_parser *, int)) {
+  if (!operand(ps, r)) return 0;
+
+  while (accept(ps, text)) {
+    int at = emit(ps->e, jump, r);
+
+    if (at < 0 || !operand(ps, r)) return 0;
+
+    ps->e->insn[at].a = ps->e->ninsn;
+
+    if (emit(ps->e, X_BOOL, r) < 0) return 0;
+  }
+
+  return 1;
+}
+
+static int parse_eq(expr_parser *ps, int r) {
+  return parse_level(ps, r, 0);
+}
+
+static int parse_and(expr_parser *ps, int r) {
+  return parse_logic(ps, r, "&&", X_JZ, parse_eq);
+}
+
+static int parse_or(expr_parser *ps, int r) {
+  return parse_logic(ps, r, "||", X_JNZ, parse_and);
+}
+
+lcl_expr *lcl_expr_compile(const char *src) {
+  expr_parser ps;
+  lcl_expr *e = (lcl_expr *)lcl_calloc(1, sizeof(*e));
+
+  if (!e) return NULL;
+
+  ps.s = src;
+  ps.e = e;
+  ps.depth = 0;
+
+  if (!parse_or(&ps, 0) || (skip_ws(&ps), *ps.s != '\0') ||
+      emit(e, X_END, 0) < 0) {
+    lcl_expr_free(e);
+    return NULL;
+  }
+
+  return e;
+}
+
+void lcl_expr_free(lcl_expr *e) {
+  int i;
+
+  if (!e) return;
+
+  for (i = 0; i < e->ninsn; i++) {
+    expr_insn *in = &e->insn[i];
+
+    if (in->op == X_VAR) {
+      lcl_sym_release((const char *)in->p);
+      lcl_layout_ref_dec(in->layout);
+    } else if (in->op == X_CMD) {
+      lcl_program_ref_dec((lcl_program *)in->p);
+    }
+  }
+
+  lcl_free(e->insn);
+  lcl_free(e);
+}
+
+const lcl_expr *lcl_word_expr(const lcl_word *w) {
+  if (!w->braced || w->np != 1 || w->wp[0].kind != LCL_WP_LIT) {
+    return NULL;
+  }
+
+  if (!w->expr) {
+    ((lcl_word *)w)->expr = lcl_expr_compile(w->wp[0].as.lit.s);
+  }
+
+  return w->expr;
+}
+
+/* ============================================================================
+ * Evaluation
+ * ============================================================================ */
+
+static int truth(const lcl_number *n) {
+  return n->is_int ? n->i != 0 : n->f != 0.0;
+}
+
+static void set_int(lcl_number *n, long i) {
+  n->is_int = 1;
+  n->i = i;
+}
+
+/* A variable as a number.  In a proc frame the name's slot is resolved
+ * once per layout, as the VM does. */
+static int read_var(lcl_interp *interp, const expr_insn *ip,
+                    lcl_number *out) {
+  lcl_frame *f = interp->env.frame;
+  lcl_value *val = NULL;
+  lcl_result res;
+
+  if (f->layout) {
+    if (ip->layout != f->layout) {
+      expr_insn *in = (expr_insn *)ip;
+
+      lcl_layout_ref_dec(in->layout);
+      in->layout = lcl_layout_ref_inc(f->layout);
+      in->slot = lcl_layout_slot(f->layout, (const char *)ip->p);
+    }
+
+    if (ip->slot >= 0 && f->slots[ip->slot]) {
+      val = lcl_ref_inc(f->slots[ip->slot]);
+    }
+  }
+
+  if (!val && lcl_env_get_sym(&interp->env, (const char *)ip->p,
+                              &val) != LCL_OK) {
+    return 0;
+  }
+
+  /* Read through a cell without taking the contents */
+  if (val->type == LCL_CELL) {
+    lcl_value *inner = lcl_cell_peek(val);
+
+    res = inner ? lcl_value_to_number(inner, out) : LCL_ERROR;
+  } else {
+    res = lcl_value_to_number(val, out);
+  }
+
+  lcl_ref_dec(val);
+
+  return res == LCL_OK;
+}
+
+static int run_script(lcl_interp *interp, const expr_insn *ip,
+                      lcl_number *out) {
+  lcl_value *val = NULL;
+  lcl_result res;
+
+  if (lcl_eval_program(interp, (const lcl_program *)ip->p, &val) !=
+      LCL_RC_OK) {
+    lcl_ref_dec(val);
+    return 0;
+  }
+
+  res = lcl_value_to_number(val, out);
+  lcl_ref_dec(val);
+
+  return res == LCL_OK;
+}
+
+int lcl_expr_eval(lcl_interp *interp, const lcl_expr *e, lcl_value **out) {
+  lcl_number reg[LCL_EXPR_MAX_REGS];
+  const expr_insn *ip = e->insn;
+
+  for (;; ip++) {
+    lcl_number *x = &reg[ip->r];
+    lcl_number *y = x + 1;
+    int c;
+
+    switch (ip->op) {
+    case X_NUM:
+      *x = ip->num;
+      break;
+    case X_VAR:
+      if (!read_var(interp, ip, x)) return LCL_RC_ERR;
+      break;
+    case X_CMD:
+      if (!run_script(interp, ip, x)) return LCL_RC_ERR;
+      break;
+    case X_NEG:
+      if (x->is_int && x->i != LONG_MIN) {
+        x->i = -x->i;
+      } else {
+        x->f = x->is_int ? -(double)x->i : -x->f;
+        x->is_int = 0;
+      }
+      break;
+    case X_NOT:
+      set_int(x, !truth(x));
+      break;
+    case X_BOOL:
+      set_int(x, truth(x));
+      break;
+    case X_ADD:
+      lcl_number_add(x, y);
+      break;
+    case X_SUB:
+      lcl_number_sub(x, y);
+      break;
+    case X_MUL:
+      lcl_number_mul(x, y);
+      break;
+    case X_DIV:
+      if (lcl_number_div(x, y) != LCL_OK) return LCL_RC_ERR;
+      break;
+    case X_MOD:
+      /* Integers only, as for % */
+      if (!x->is_int || !y->is_int || y->i == 0) return LCL_RC_ERR;
+      x->i = y->i == -1 ? 0 : x->i % y->i;
+      break;
+    case X_LT:
+      set_int(x, lcl_number_cmp(x, y) == -1);
+      break;
+    case X_LE:
+      c = lcl_number_cmp(x, y);
+      set_int(x, c == -1 || c == 0);
+      break;
+    case X_GT:
+      set_int(x, lcl_number_cmp(x, y) == 1);
+      break;
+    case X_GE:
+      c = lcl_number_cmp(x, y);
+      set_int(x, c == 1 || c == 0);
+      break;
+    case X_EQ:
+      set_int(x, lcl_number_cmp(x, y) == 0);
+      break;
+    case X_NE:
+      set_int(x, lcl_number_cmp(x, y) != 0);
+      break;
+    case X_JZ:
+      if (!truth(x)) ip = &e->insn[ip->a] - 1;
+      break;
+    case X_JNZ:
+      if (truth(x)) ip = &e->insn[ip->a] - 1;
+      break;
+    default:
+      *out = lcl_number_new(&reg[0]);
+      return *out ? LCL_RC_OK : LCL_RC_ERR;
+    }
+  }
+}
@@ -0,0 +1,34 @@
+#ifndef LCL_EXPR_H
+#define LCL_EXPR_H
+
+#include "lcl-compile.h"
+
+/* Infix arithmetic for the expr command.  An expression is parsed once
+ * into code for a small machine whose registers hold plain numbers, so
+ * operators neither dispatch commands nor box intermediate results.
+ *
+ *   or   := and ('||' and)*
+ *   and  := eq ('&&' eq)*
+ *   eq   := rel (('==' | '!=') rel)*
+ *   rel  := add (('<' | '<=' | '>' | '>=') add)*
+ *   add  := mul (('+' | '-') mul)*
+ *   mul  := un (('*' | '/' | '%') un)*
+ *   un   := ('-' | '+' | '!') un | number | $name | ${name} | [script]
+ *         | '(' or ')'
+ *
+ * Arithmetic follows the + - * / % commands: integers until they
+ * overflow, then double.  Comparisons and logic give 0 or 1, and && and
+ * || skip their right side when the left decides. */
+
+/* Parse src; NULL if it is not a well-formed expression */
+lcl_expr *lcl_expr_compile(const char *src);
+void lcl_expr_free(lcl_expr *e);
+
+/* Run e in the current frame; only the result is boxed */
+int lcl_expr_eval(lcl_interp *interp, const lcl_expr *e, lcl_value **out);
+
+/* The expression of a braced word, compiled on first use and kept on the
+ * word like its program.  Returns NULL for other words. */
+const lcl_expr *lcl_word_expr(const lcl_word *w);
+
+#endif
@@ -1,46 +1,156 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #ifdef DEBUG_REFC
 #endif
 
 #include "hash-table.h"
+#include "lcl-alloc.h"
 #include "lcl-compile.h"
+#include "lcl-sym.h"
 #include "lcl-values.h"
 
-lcl_frame *lcl_frame_new(lcl_frame *parent) {
-  lcl_frame *f = malloc(sizeof(*f));
-  hash_table *locals;
+/* Frames are made and dropped on every proc call, so freed frames are
+ * kept on a free list per slot count and handed out again instead of
+ * going back to malloc.  The lists belong to the interpreter that made
+ * the frames, in its slab, and are emptied when its last frame goes.
+ * Frames made while no interpreter runs are not kept. */
 
-  if (!f) return NULL;
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/asan_interface.h>
+#define POISON(p, n) ASAN_POISON_MEMORY_REGION((p), (n))
+#define UNPOISON(p, n) ASAN_UNPOISON_MEMORY_REGION((p), (n))
+#else
+#define POISON(p, n) ((void)0)
+#define UNPOISON(p, n) ((void)0)
+#endif
+
+#define FRAME_CACHE_DEPTH 32  /* frames kept per slot count */
+
+static size_t frame_bytes(size_t nslots) {
+  return sizeof(lcl_frame) + nslots * sizeof(lcl_value *);
+}
+
+static void frame_cache_drain(lcl_frame_cache *c) {
+  size_t n;
+
+  for (n = 0; n <= LCL_FRAME_CACHE_SLOTS; n++) {
+    while (c->free[n]) {
+      lcl_frame *f = c->free[n];
+
+      UNPOISON(f, frame_bytes(n));
+      c->free[n] = f->parent;
+      lcl_free(f);
+    }
 
-  locals = hash_table_new();
-  if (!locals) {
-    free(f);
-    return NULL;
+    c->cached[n] = 0;
   }
+}
+
+static lcl_frame *frame_alloc(lcl_frame *parent, size_t nslots) {
+  lcl_slab *sl = lcl_slab_current();
+  lcl_frame_cache *c = sl ? lcl_slab_frames(sl) : NULL;
+  lcl_frame *f;
+
+  if (c && nslots <= LCL_FRAME_CACHE_SLOTS && c->free[nslots]) {
+    f = c->free[nslots];
+    UNPOISON(f, frame_bytes(nslots));
+    c->free[nslots] = f->parent;
+    c->cached[nslots]--;
+  } else {
+    f = lcl_malloc(frame_bytes(nslots));
+    if (!f) return NULL;
+  }
+
+  if (c) c->live++;
 
+  f->slab = sl;
   f->refc = 1;
-  f->locals = locals;
+  f->locals = NULL;
   f->parent = lcl_frame_ref_inc(parent);
   f->owns_locals = 1;
+  f->layout = NULL;
+  f->slots = NULL;
+  f->npairs = 0;
 
   return f;
 }
 
+static void frame_release(lcl_frame *f, size_t nslots) {
+  lcl_slab *sl = f->slab;
+  lcl_frame_cache *c;
+
+  if (!sl) {
+    lcl_free(f);
+    return;
+  }
+
+  c = lcl_slab_frames(sl);
+
+  if (!--c->live) {
+    lcl_free(f);
+    frame_cache_drain(c);
+    lcl_slab_release(sl);
+    return;
+  }
+
+  if (nslots > LCL_FRAME_CACHE_SLOTS ||
+      c->cached[nslots] >= FRAME_CACHE_DEPTH) {
+    lcl_free(f);
+    return;
+  }
+
+  f->parent = c->free[nslots];
+  c->free[nslots] = f;
+  c->cached[nslots]++;
+  POISON(f, frame_bytes(nslots));
+}
+
+lcl_frame *lcl_frame_new(lcl_frame *parent) {
+  return frame_alloc(parent, 0);
+}
+
 lcl_frame *lcl_frame_new_ns(lcl_frame *parent, hash_table *ns_locals) {
-  lcl_frame *f = malloc(sizeof(*f));
+  lcl_frame *f = frame_alloc(parent, 0);
 
   if (!f) return NULL;
 
-  f->refc = 1;
   f->locals = ns_locals;  /* Borrowed from namespace */
-  f->parent = lcl_frame_ref_inc(parent);
   f->owns_locals = 0;
 
   return f;
 }
 
+/* A proc call frame: bindings for the layout's names live in slots
+ * allocated with the frame; anything else goes to the pairs. */
+lcl_frame *lcl_frame_new_slots(lcl_frame *parent, lcl_layout *layout) {
+  size_t n = (size_t)layout->nslots;
+  lcl_frame *f = frame_alloc(parent, n);
+
+  if (!f) return NULL;
+
+  f->layout = lcl_layout_ref_inc(layout);
+  f->slots = (lcl_value **)(f + 1);
+  memset(f->slots, 0, n * sizeof(*f->slots));
+
+  return f;
+}
+
+static void drop_pairs(lcl_frame *f) {
+  int i;
+
+  for (i = 0; i < f->npairs; i++) {
+    lcl_sym_release(f->pairs[i].name);
+    lcl_ref_dec(f->pairs[i].value);
+  }
+
+  f->npairs = 0;
+}
+
 void lcl_frame_free(lcl_frame *f) {
+  size_t nslots = 0;
+
   if (!f) return;
 
   if (f->parent) {
@@ -51,7 +161,21 @@ void lcl_frame_free(lcl_frame *f) {
     hash_table_free(f->locals);
   }
 
-  free(f);
+  drop_pairs(f);
+
+  if (f->layout) {
+    int i;
+
+    nslots = (size_t)f->layout->nslots;
+
+    for (i = 0; i < f->layout->nslots; i++) {
+      if (f->slots[i]) lcl_ref_dec(f->slots[i]);
+    }
+
+    lcl_layout_ref_dec(f->layout);
+  }
+
+  frame_release(f, nslots);
 }
 
 lcl_frame *lcl_frame_ref_inc(lcl_frame *f) {
@@ -77,14 +201,39 @@ void lcl_frame_clear(lcl_frame *f) {
   hash_iter it = {0};
   const char *key;
   lcl_value *val;
+  int i;
 
-  if (!f || !f->locals) return;
+  if (!f) return;
 
   /* Break reference cycles through cells before freeing.
    * This handles mutual recursion cases where:
    * cell A -> lambda A -> upvalues -> cell B -> lambda B -> upvalues -> cell A
    * By clearing cell contents first, we break the cycle.
    */
+  if (f->layout) {
+    for (i = 0; i < f->layout->nslots; i++) {
+      val = f->slots[i];
+
+      if (val && val->type == LCL_CELL && val->as.cell.inner) {
+        lcl_ref_dec(val->as.cell.inner);
+        val->as.cell.inner = NULL;
+      }
+    }
+  }
+
+  for (i = 0; i < f->npairs; i++) {
+    val = f->pairs[i].value;
+
+    if (val->type == LCL_CELL && val->as.cell.inner) {
+      lcl_ref_dec(val->as.cell.inner);
+      val->as.cell.inner = NULL;
+    }
+  }
+
+  drop_pairs(f);
+
+  if (!f->locals) return;
+
   while (hash_table_iterate(f->locals, &it, &key, &val)) {
     if (val->type == LCL_CELL && val->as.cell.inner) {
       lcl_ref_dec(val->as.cell.inner);
@@ -97,9 +246,150 @@ void lcl_frame_clear(lcl_frame *f) {
   f->locals = NULL;
 }
 
-int lcl_frame_get_binding(lcl_frame *f, const char *name, lcl_value **out) {
+/* Symbols match by pointer; anything else by hash and text */
+static int sym_matches(const char *sym, const hash_key *k) {
+  return sym == k->s ||
+         (lcl_sym_hash(sym) == k->hash && strcmp(sym, k->s) == 0);
+}
+
+/* Slot of k in l, or -1.  Names from compiled words are symbols, as
+ * are the layout's, and match by pointer. */
+static int layout_find(const lcl_layout *l, const hash_key *k) {
+  int i;
+
+  for (i = 0; i < l->nslots; i++) {
+    if (sym_matches(l->names[i], k)) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static int pair_find(const lcl_frame *f, const hash_key *k) {
+  int i;
+
+  for (i = 0; i < f->npairs; i++) {
+    if (sym_matches(f->pairs[i].name, k)) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+/* Move the pairs into a new locals table */
+static int spill_pairs(lcl_frame *f) {
+  hash_table *ht = hash_table_new();
+  int i;
+
+  if (!ht) return 0;
+
+  for (i = 0; i < f->npairs; i++) {
+    hash_key k = hash_key_sym(f->pairs[i].name);
+
+    if (!hash_table_put_key(ht, &k, f->pairs[i].value)) {
+      hash_table_free(ht);
+      return 0;
+    }
+  }
+
+  drop_pairs(f);
+  f->locals = ht;
+
+  return 1;
+}
+
+/* Binding of k in f itself, not its parents */
+int lcl_frame_lookup_key(lcl_frame *f, const hash_key *k, lcl_value **out) {
+  int i;
+
+  if (f->layout) {
+    i = layout_find(f->layout, k);
+
+    if (i >= 0) {
+      if (!f->slots[i]) return 0;
+
+      *out = lcl_ref_inc(f->slots[i]);
+      return 1;
+    }
+  }
+
+  if (f->locals) {
+    return hash_table_get_key(f->locals, k, out);
+  }
+
+  i = pair_find(f, k);
+  if (i < 0) return 0;
+
+  *out = lcl_ref_inc(f->pairs[i].value);
+  return 1;
+}
+
+int lcl_frame_lookup(lcl_frame *f, const char *name, lcl_value **out) {
+  hash_key k = hash_key_make(name);
+
+  return lcl_frame_lookup_key(f, &k, out);
+}
+
+/* Bind k in f, replacing any earlier binding.  Like hash_table_put,
+ * takes its own reference to value. */
+int lcl_frame_put_key(lcl_frame *f, const hash_key *k, lcl_value *value) {
+  lcl_value *old;
+  int i;
+
+  if (f->layout) {
+    i = layout_find(f->layout, k);
+
+    if (i >= 0) {
+      old = f->slots[i];
+      f->slots[i] = lcl_ref_inc(value);
+      if (old) lcl_ref_dec(old);
+
+      return 1;
+    }
+  }
+
+  if (!f->locals) {
+    i = pair_find(f, k);
+
+    if (i >= 0) {
+      old = f->pairs[i].value;
+      f->pairs[i].value = lcl_ref_inc(value);
+      lcl_ref_dec(old);
+
+      return 1;
+    }
+
+    if (f->npairs < LCL_FRAME_PAIRS) {
+      const char *sym = hash_key_intern(k);
+
+      if (!sym) return 0;
+
+      f->pairs[f->npairs].name = sym;
+      f->pairs[f->npairs].value = lcl_ref_inc(value);
+      f->npairs++;
+
+      return 1;
+    }
+
+    if (!spill_pairs(f)) return 0;
+  }
+
+  return hash_table_put_key(f->locals, k, value);
+}
+
+int lcl_frame_put(lcl_frame *f, const char *name, lcl_value *value) {
+  hash_key k = hash_key_make(name);
+
+  return lcl_frame_put_key(f, &k, value);
+}
+
+/* Binding of k in f or the nearest parent that has one */
+int lcl_frame_get_binding_key(lcl_frame *f, const hash_key *k,
+                              lcl_value **out) {
   while (f) {
-    if (hash_table_get(f->locals, name, out)) {
+    if (lcl_frame_lookup_key(f, k, out)) {
       return 1;
     }
 
@@ -108,3 +398,40 @@ int lcl_frame_get_binding(lcl_frame *f, const char *name, lcl_value **out) {
 
   return 0;
 }
+
+int lcl_frame_get_binding(lcl_frame *f, const char *name, lcl_value **out) {
+  hash_key k = hash_key_make(name);
+
+  return lcl_frame_get_binding_key(f, &k, out);
+}
+
+/* ============================================================================
+ * Layouts
+ * ============================================================================ */
+
+lcl_layout *lcl_layout_ref_inc(lcl_layout *l) {
+  if (l) l->refc++;
+
+  return l;
+}
+
+void lcl_layout_ref_dec(lcl_layout *l) {
+  int i;
+
+  if (!l) return;
+  if (--l->refc > 0) return;
+
+  for (i = 0; i < l->nslots; i++) {
+    lcl_sym_release(l->names[i]);
+  }
+
+  lcl_free(l->names);
+  lcl_free(l);
+}
+
+/* Slot index of name in l, or -1 */
+int lcl_layout_slot(const lcl_layout *l, const char *name) {
+  hash_key k = hash_key_make(name);
+
+  return layout_find(l, &k);
+}
@@ -0,0 +1,548 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "lcl-alloc.h"
+#include "lcl-image.h"
+
+/*
+ * Image layout.  The version is an unsigned 32-bit little-endian
+ * integer; every other integer is unsigned, up to 32 bits, written in
+ * as few bytes as it needs (wr_uint):
+ *
+ *   image   := magic version n source NUL program
+ *   program := ncmd command*
+ *   command := line argc word*
+ *   word    := flags:u8 np piece* [program, if flags has IMG_PROGRAM]
+ *   piece   := kind:u8 (n bytes NUL  for literals and variables
+ *                       | off n      for IMG_SPAN literals
+ *                       | program    for [subcommands])
+ *
+ * Braced words that compile are written with their program as well as
+ * their text, so proc and loop bodies skip the scanner too.  A braced
+ * word's text is a slice of the source, and of any body it is nested
+ * in, so it is written as a span of the source the image carries rather
+ * than copied again at each level of nesting.  Other literals longer
+ * than a span are written as one too, where the body holds their text.
+ * The source also tells whether a sibling image is stale: it must match
+ * byte for byte.
+ *
+ * Images are trusted input, like the source they stand for.  Reading
+ * one checks its bounds, but it is not a sandbox for hostile files.
+ */
+
+#define IMG_QUOTED  1u
+#define IMG_BRACED  2u
+#define IMG_PROGRAM 4u
+
+/* Piece kind for a literal that is a span of the source */
+#define IMG_SPAN 0x80u
+
+/* Nesting limit while reading, so a damaged image cannot blow the stack */
+#define IMG_MAX_DEPTH 256
+
+static char *image_read_file(const char *path, size_t *out_len) {
+  FILE *f;
+  long len;
+  char *buf;
+  size_t nread;
+
+  f = fopen(path, "rb");
+  if (!f) return NULL;
+
+  if (fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) < 0 ||
+      fseek(f, 0, SEEK_SET) != 0) {
+    fclose(f);
+    return NULL;
+  }
+
+  buf = lcl_malloc((size_t)len + 1);
+  if (!buf) {
+    fclose(f);
+    return NULL;
+  }
+
+  nread = fread(buf, 1, (size_t)len, f);
+  fclose(f);
+
+  if ((long)nread != len) {
+    lcl_free(buf);
+    return NULL;
+  }
+
+  buf[len] = '\0';
+  *out_len = (size_t)len;
+  return buf;
+}
+
+/* ============================================================================
+ * Writing
+ * ============================================================================ */
+
+static void wr_u8(FILE *f, unsigned v) {
+  putc((int)(v & 0xffu), f);
+}
+
+static void wr_u32(FILE *f, unsigned long v) {
+  wr_u8(f, (unsigned)v);
+  wr_u8(f, (unsigned)(v >> 8));
+  wr_u8(f, (unsigned)(v >> 16));
+  wr_u8(f, (unsigned)(v >> 24));
+}
+
+/* Seven bits a byte, low first, the high bit set on all but the last */
+static void wr_uint(FILE *f, unsigned long v) {
+  while (v >= 0x80u) {
+    wr_u8(f, (unsigned)(v & 0x7fu) | 0x80u);
+    v >>= 7;
+  }
+
+  wr_u8(f, (unsigned)v);
+}
+
+static void wr_bytes(FILE *f, const char *s, size_t n) {
+  wr_uint(f, (unsigned long)n);
+  fwrite(s, 1, n, f);
+  wr_u8(f, 0);
+}
+
+/* The source an image is written from, and the part of it the words
+ * being written came from */
+typedef struct {
+  FILE *f;
+  const char *src;
+  size_t off;
+  size_t n;
+} img_writer;
+
+/* Where the m bytes at s occur within wr's window, or -1.  Any
+ * occurrence will do, since it holds the same bytes. */
+static long find_span(const img_writer *wr, const char *s, size_t m) {
+  const char *base = wr->src + wr->off;
+  size_t i;
+
+  if (m == 0 || m > wr->n) return -1;
+
+  for (i = 0; i + m <= wr->n; i++) {
+    if (base[i] == s[0] && memcmp(base + i, s, m) == 0) {
+      return (long)(wr->off + i);
+    }
+  }
+
+  return -1;
+}
+
+static void write_program(img_writer *wr, lcl_program *p);
+
+static void write_word(img_writer *wr, lcl_word *w, const char *file) {
+  FILE *f = wr->f;
+  unsigned flags = 0;
+  long span = -1;
+  int i;
+
+  /* Compile bodies now, as lcl_word_program would on first use */
+  if (w->braced && w->np == 1 && w->wp[0].kind == LCL_WP_LIT &&
+      !w->program) {
+    w->program = lcl_program_compile(w->wp[0].as.lit.s, file);
+  }
+
+  if (w->quoted) flags |= IMG_QUOTED;
+  if (w->braced) flags |= IMG_BRACED;
+  if (w->program) flags |= IMG_PROGRAM;
+
+  wr_u8(f, flags);
+  wr_uint(f, (unsigned long)w->np);
+
+  for (i = 0; i < w->np; i++) {
+    const lcl_word_piece *pc = &w->wp[i];
+
+    span = -1;
+
+    if (pc->kind == LCL_WP_LIT && (w->braced || pc->as.lit.n > 2)) {
+      span = find_span(wr, pc->as.lit.s, pc->as.lit.n);
+    }
+
+    if (span >= 0) {
+      wr_u8(f, IMG_SPAN);
+      wr_uint(f, (unsigned long)span);
+      wr_uint(f, (unsigned long)pc->as.lit.n);
+      continue;
+    }
+
+    wr_u8(f, (unsigned)pc->kind);
+
+    switch (pc->kind) {
+    case LCL_WP_LIT:
+      wr_bytes(f, pc->as.lit.s, pc->as.lit.n);
+      break;
+    case LCL_WP_VAR:
+      wr_bytes(f, pc->as.var.name, strlen(pc->as.var.name));
+      break;
+    case LCL_WP_SUBCMD:
+      write_program(wr, pc->as.sub.program);
+      break;
+    }
+  }
+
+  /* The body's own words lie within its text */
+  if (w->program) {
+    img_writer inner = *wr;
+
+    if (span >= 0) {
+      inner.off = (size_t)span;
+      inner.n = w->wp[0].as.lit.n;
+    }
+
+    write_program(&inner, w->program);
+  }
+}
+
+static void write_program(img_writer *wr, lcl_program *p) {
+  FILE *f = wr->f;
+  int i, j;
+
+  wr_uint(f, (unsigned long)p->ncmd);
+
+  for (i = 0; i < p->ncmd; i++) {
+    lcl_command *cmd = &p->cmd[i];
+
+    wr_uint(f, (unsigned long)cmd->line);
+    wr_uint(f, (unsigned long)cmd->argc);
+
+    for (j = 0; j < cmd->argc; j++) {
+      write_word(wr, &cmd->w[j], p->file);
+    }
+  }
+}
+
+int lcl_image_save(const char *src_path, const char *out_path) {
+  char *src;
+  char *sibling = NULL;
+  size_t len;
+  lcl_program *p;
+  img_writer wr;
+  FILE *f;
+  int ok;
+
+  src = image_read_file(src_path, &len);
+  if (!src) return 0;
+
+  p = lcl_program_compile(src, NULL);
+
+  if (!p) {
+    lcl_free(src);
+    return 0;
+  }
+
+  if (!out_path) {
+    size_t n = strlen(src_path);
+
+    sibling = lcl_malloc(n + 2);
+
+    if (!sibling) {
+      lcl_program_free(p);
+      lcl_free(src);
+      return 0;
+    }
+
+    memcpy(sibling, src_path, n);
+    sibling[n] = 'c';
+    sibling[n + 1] = '\0';
+    out_path = sibling;
+  }
+
+  f = fopen(out_path, "wb");
+  ok = f != NULL;
+
+  if (f) {
+    fwrite(LCL_IMAGE_MAGIC, 1, 4, f);
+    wr_u32(f, LCL_IMAGE_VERSION);
+    wr_bytes(f, src, len);
+
+    wr.f = f;
+    wr.src = src;
+    wr.off = 0;
+    wr.n = len;
+    write_program(&wr, p);
+
+    ok = !ferror(f);
+    if (fclose(f) != 0) ok = 0;
+    if (!ok) remove(out_path);
+  }
+
+  lcl_free(sibling);
+  lcl_program_free(p);
+  lcl_free(src);
+
+  return ok;
+}
+
+/* ============================================================================
+ * Reading
+ * ============================================================================ */
+
+typedef struct {
+  const unsigned char *p;
+  const unsigned char *end;
+  const char *src;  /* the source carried by the image */
+  size_t srclen;
+  int depth;
+} img_reader;
+
+static int rd_u8(img_reader *r, unsigned *out) {
+  if (r->p >= r->end) return 0;
+
+  *out = *r->p++;
+  return 1;
+}
+
+static int rd_u32(img_reader *r, unsigned long *out) {
+  if (r->end - r->p < 4) return 0;
+
+  *out = (unsigned long)r->p[0] | ((unsigned long)r->p[1] << 8) |
+         ((unsigned long)r->p[2] << 16) | ((unsigned long)r->p[3] << 24);
+  r->p += 4;
+  return 1;
+}
+
+/* An integer from wr_uint, no more than 32 bits */
+static int rd_uint(img_reader *r, unsigned long *out) {
+  unsigned long v = 0;
+  unsigned b;
+  int shift;
+
+  for (shift = 0; shift < 35; shift += 7) {
+    if (!rd_u8(r, &b)) return 0;
+
+    v |= (unsigned long)(b & 0x7fu) << shift;
+
+    if (!(b & 0x80u)) {
+      if (v > 0xffffffffUL) return 0;
+
+      *out = v;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* A count of things that each take at least one byte, so a damaged
+ * image cannot ask for more than it holds */
+static int rd_count(img_reader *r, int *out) {
+  unsigned long n;
+
+  if (!rd_uint(r, &n) || n > (unsigned long)(r->end - r->p) || n > 0x7fffffffUL) {
+    return 0;
+  }
+
+  *out = (int)n;
+  return 1;
+}
+
+/* Points *s into the image at n bytes followed by their NUL */
+static int rd_bytes(img_reader *r, const char **s, size_t *n) {
+  unsigned long len;
+
+  if (!rd_uint(r, &len) || len >= (unsigned long)(r->end - r->p) ||
+      r->p[len] != '\0') {
+    return 0;
+  }
+
+  *s = (const char *)r->p;
+  *n = (size_t)len;
+  r->p += len + 1;
+  return 1;
+}
+
+static lcl_program *read_program(img_reader *r, const char *file);
+
+static int read_word(img_reader *r, lcl_arena *a, lcl_word *w,
+                     const char *file) {
+  unsigned flags, kind;
+  const char *s;
+  size_t n;
+  int np, i;
+
+  if (!rd_u8(r, &flags) || !rd_count(r, &np)) return 0;
+
+  w->quoted = (flags & IMG_QUOTED) != 0;
+  w->braced = (flags & IMG_BRACED) != 0;
+
+  for (i = 0; i < np; i++) {
+    if (!rd_u8(r, &kind)) return 0;
+
+    switch (kind) {
+    case LCL_WP_LIT:
+      if (!rd_bytes(r, &s, &n) || !lcl_word_add_lit(a, w, s, n)) return 0;
+      break;
+    case LCL_WP_VAR:
+      if (!rd_bytes(r, &s, &n) || !lcl_word_add_var(a, w, s)) return 0;
+      break;
+    case IMG_SPAN: {
+      unsigned long off, len;
+
+      if (!rd_uint(r, &off) || !rd_uint(r, &len) || off > r->srclen ||
+          len > r->srclen - off ||
+          !lcl_word_add_lit(a, w, r->src + off, (size_t)len)) {
+        return 0;
+      }
+      break;
+    }
+    case LCL_WP_SUBCMD: {
+      lcl_program *sub = read_program(r, NULL);
+
+      if (!sub) return 0;
+
+      if (!lcl_word_add_sub(a, w, sub)) {
+        lcl_program_free(sub);
+        return 0;
+      }
+      break;
+    }
+    default:
+      return 0;
+    }
+  }
+
+  if (flags & IMG_PROGRAM) {
+    w->program = read_program(r, file);
+
+    if (!w->program) return 0;
+  }
+
+  return 1;
+}
+
+static int read_command(img_reader *r, lcl_arena *a, lcl_command *cmd,
+                        const char *file) {
+  unsigned long line;
+  int argc, i;
+
+  if (!rd_uint(r, &line) || !rd_count(r, &argc)) return 0;
+
+  cmd->line = (int)line;
+
+  for (i = 0; i < argc; i++) {
+    lcl_word w;
+    memset(&w, 0, sizeof(w));
+
+    /* The command owns the word before it is filled in */
+    if (!lcl_command_push_word(a, cmd, &w) ||
+        !read_word(r, a, &cmd->w[cmd->argc - 1], file)) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static lcl_program *read_program(img_reader *r, const char *file) {
+  lcl_program *p;
+  int ncmd, i;
+
+  if (r->depth >= IMG_MAX_DEPTH || !rd_count(r, &ncmd)) return NULL;
+
+  p = lcl_program_new(file);
+  if (!p) return NULL;
+
+  r->depth++;
+
+  for (i = 0; i < ncmd; i++) {
+    lcl_command cmd;
+    memset(&cmd, 0, sizeof(cmd));
+
+    if (!read_command(r, &p->arena, &cmd, file) ||
+        !lcl_program_push_command(p, &cmd)) {
+      lcl_command_free(&cmd);
+      lcl_program_free(p);
+      p = NULL;
+      break;
+    }
+  }
+
+  r->depth--;
+  return p;
+}
+
+static int is_image(const char *buf, size_t len) {
+  return len >= 4 && memcmp(buf, LCL_IMAGE_MAGIC, 4) == 0;
+}
+
+/* Decode an image.  With src, only an image built from exactly that
+ * source is accepted. */
+static lcl_program *image_decode(const char *buf, size_t len,
+                                 const char *file,
+                                 const char *src, size_t srclen) {
+  img_reader r;
+  unsigned long version;
+  lcl_program *p;
+
+  r.p = (const unsigned char *)buf + 4;
+  r.end = (const unsigned char *)buf + len;
+  r.depth = 0;
+
+  if (!is_image(buf, len) || !rd_u32(&r, &version) ||
+      version != LCL_IMAGE_VERSION ||
+      !rd_bytes(&r, &r.src, &r.srclen)) {
+    return NULL;
+  }
+
+  if (src && (r.srclen != srclen || memcmp(r.src, src, srclen) != 0)) {
+    return NULL;
+  }
+
+  p = read_program(&r, file);
+
+  if (p && r.p != r.end) {
+    lcl_program_free(p);
+    return NULL;
+  }
+
+  return p;
+}
+
+static lcl_program *load_sibling(const char *path, const char *src,
+                                 size_t srclen, const char *file) {
+  size_t n = strlen(path);
+  char *sibling = lcl_malloc(n + 2);
+  char *buf;
+  size_t len;
+  lcl_program *p = NULL;
+
+  if (!sibling) return NULL;
+
+  memcpy(sibling, path, n);
+  sibling[n] = 'c';
+  sibling[n + 1] = '\0';
+
+  buf = image_read_file(sibling, &len);
+  lcl_free(sibling);
+
+  if (buf) {
+    p = image_decode(buf, len, file, src, srclen);
+    lcl_free(buf);
+  }
+
+  return p;
+}
+
+lcl_program *lcl_image_load(const char *path, const char *file) {
+  char *buf;
+  size_t len;
+  lcl_program *p;
+
+  buf = image_read_file(path, &len);
+  if (!buf) return NULL;
+
+  if (is_image(buf, len)) {
+    p = image_decode(buf, len, file, NULL, 0);
+  } else {
+    /* Stale or missing images fall back to the source */
+    p = load_sibling(path, buf, len, file);
+
+    if (!p) p = lcl_program_compile(buf, file);
+  }
+
+  lcl_free(buf);
+  return p;
+}
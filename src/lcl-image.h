@@ -0,0 +1,23 @@
+#ifndef LCL_IMAGE_H
+#define LCL_IMAGE_H
+
+#include "lcl-lex.h"
+
+/* Precompiled scripts (.lclc).  An image holds the scanner's output for
+ * one source file, tagged with a format version, along with the source
+ * it was built from.  Images are trusted input: load only ones you
+ * would run the source of. */
+#define LCL_IMAGE_MAGIC "\177LCL"
+#define LCL_IMAGE_VERSION 2
+
+/* Compile the script at src_path and write its image to out_path, or to
+ * <src_path>c when out_path is NULL.  Returns 1 on success. */
+int lcl_image_save(const char *src_path, const char *out_path);
+
+/* Load the program at path, tagging it with file.  path may be an image
+ * or source; for source, a sibling <path>c built from exactly that
+ * source is used instead of scanning.  Returns NULL if the file cannot
+ * be read, does not compile, or is an image of another version. */
+lcl_program *lcl_image_load(const char *path, const char *file);
+
+#endif
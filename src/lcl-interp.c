@@ -1,40 +1,176 @@
 #include <memory.h>
 
+#include "lcl-alloc.h"
 #include "lcl-compile.h"
+#include "lcl-thread.h"
 #include "lcl-values.h"
 
 #define MAX_DEPTH 1024
 
+static LCL_THREAD_LOCAL lcl_interp *running;
+
+struct lcl_stack_block {
+  struct lcl_stack_block *prev;
+  struct lcl_stack_block *next;  /* empty, kept for the next push */
+  size_t cap;
+  size_t top;
+  lcl_value *slots[1];
+};
+
+static lcl_stack_block *stack_block_new(lcl_stack_block *prev, size_t n) {
+  size_t cap = n > LCL_STACK_BLOCK ? n : LCL_STACK_BLOCK;
+  lcl_stack_block *b = (lcl_stack_block *)lcl_malloc(
+      sizeof(*b) + (cap - 1) * sizeof(b->slots[0]));
+
+  if (!b) return NULL;
+
+  b->prev = prev;
+  b->next = NULL;
+  b->cap = cap;
+  b->top = 0;
+
+  if (prev) prev->next = b;
+
+  return b;
+}
+
+/* Free b and the spare blocks after it */
+static void stack_free_from(lcl_stack_block *b) {
+  while (b) {
+    lcl_stack_block *next = b->next;
+
+    lcl_free(b);
+    b = next;
+  }
+}
+
+lcl_value **lcl_stack_push(lcl_interp *interp, size_t n) {
+  lcl_stack_block *b = interp->stack;
+  lcl_value **slice;
+
+  if (!b || b->top + n > b->cap) {
+    lcl_stack_block *next = b ? b->next : NULL;
+
+    /* A spare block too small for n makes way for one that fits, and
+     * the spares after it go too, since only the first is ever reused */
+    if (next && next->cap < n) {
+      stack_free_from(next);
+      b->next = next = NULL;
+    }
+
+    if (!next) {
+      next = stack_block_new(b, n);
+      if (!next) return NULL;
+    }
+
+    interp->stack = b = next;
+  }
+
+  slice = &b->slots[b->top];
+  b->top += n;
+  memset(slice, 0, n * sizeof(*slice));
+
+  return slice;
+}
+
+/* Slices are only pushed onto an empty block when the one before it is
+ * full, so a block that empties hands back to the one before */
+void lcl_stack_pop(lcl_interp *interp, size_t n) {
+  lcl_stack_block *b = interp->stack;
+
+  b->top -= n;
+
+  if (!b->top && b->prev) {
+    interp->stack = b->prev;
+  }
+}
+
+static void stack_free(lcl_stack_block *b) {
+  if (!b) return;
+
+  while (b->prev) b = b->prev;
+
+  stack_free_from(b);
+}
+
 lcl_interp *lcl_interp_new(void) {
-  lcl_interp *interp = (lcl_interp *)calloc(1, sizeof(*interp));
+  return lcl_interp_new_with_allocator(NULL);
+}
+
+lcl_interp *lcl_interp_new_with_allocator(const lcl_allocator *a) {
+  lcl_heap *heap = lcl_heap_new(a);
+  lcl_heap *prev;
+  lcl_slab *slab, *prev_slab;
+  lcl_interp *interp;
   lcl_env *env = NULL;
-  
-  if (!interp) return NULL;
 
-  env = lcl_env_new();
+  if (!heap) return NULL;
+
+  prev = lcl_heap_enter(heap);
+  slab = lcl_slab_new();
+  prev_slab = lcl_slab_enter(slab);
+  interp = slab ? (lcl_interp *)lcl_calloc(1, sizeof(*interp)) : NULL;
+
+  if (interp) env = lcl_env_new();
 
   if (!env) {
-    free(interp);
+    lcl_free(interp);
+    lcl_slab_leave(prev_slab);
+    lcl_slab_close(slab);
+    lcl_heap_leave(prev);
+    lcl_heap_close(heap);
     return NULL;
   }
 
   interp->env = *env;
-  free(env);  /* free the struct, contents now owned by interp->env */
+  lcl_free(env);  /* free the struct, contents now owned by interp->env */
   interp->last = NULL;
   interp->err_msg = NULL;
   interp->err_file = NULL;
   interp->err_line = 0;
   interp->depth = 0;
   interp->max_depth = MAX_DEPTH;
+  lcl_cache_init(&interp->cache, LCL_COMPILE_CACHE_DEFAULT);
+  interp->stack = NULL;
+  interp->heap = heap;
+  interp->slab = slab;
+
+  lcl_slab_leave(prev_slab);
+  lcl_heap_leave(prev);
 
   return interp;
 }
 
+lcl_interp *lcl_interp_enter(lcl_interp *interp) {
+  lcl_interp *prev = running;
+
+  running = interp;
+  lcl_heap_enter(interp->heap);
+  lcl_slab_enter(interp->slab);
+
+  return prev;
+}
+
+void lcl_interp_leave(lcl_interp *prev) {
+  running = prev;
+  lcl_heap_leave(prev ? prev->heap : lcl_heap_default());
+  lcl_slab_leave(prev ? prev->slab : NULL);
+}
+
 void lcl_interp_free(lcl_interp *interp) {
+  lcl_interp *prev;
+  lcl_heap *heap;
+  lcl_slab *slab;
+
   if (!interp) return;
 
+  heap = interp->heap;
+  slab = interp->slab;
+  prev = lcl_interp_enter(interp);
+
   lcl_ref_dec(interp->last);
   lcl_ref_dec(interp->err_msg);
+  lcl_cache_clear(&interp->cache);
 
   /* Clear frame contents first to break circular references
    * (procs in frame have closures that reference the frame) */
@@ -43,6 +179,14 @@ void lcl_interp_free(lcl_interp *interp) {
 
   lcl_ref_dec(interp->env.current_ns);
   lcl_ref_dec(interp->env.global_ns);
+  hash_table_free(interp->env.cmd_names);
+  stack_free(interp->stack);
+
+  lcl_free(interp);
 
-  free(interp);
+  /* The slab, and then the heap, go once the last value made from it
+   * and the last block charged to it are back */
+  lcl_interp_leave(prev);
+  lcl_slab_close(slab);
+  lcl_heap_close(heap);
 }
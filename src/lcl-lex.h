@@ -3,27 +3,54 @@
 
 #include <stdlib.h>
 
+#include "lcl-arena.h"
+
 typedef struct lcl_word lcl_word;
+typedef struct lcl_code lcl_code;
+typedef struct lcl_layout lcl_layout;
+typedef struct lcl_expr lcl_expr;
+
+/* What a command's literal name last resolved to (see lcl-env.c).  The
+ * callee is not owned: it stays valid while the interpreter's binding
+ * epoch and current namespace are the ones recorded here. */
+typedef struct {
+  struct lcl_value *callee;
+  struct lcl_value *ns;
+  const void *env;
+  unsigned long epoch;
+} lcl_call_cache;
 
 typedef struct {
   lcl_word *w;
   int argc;
   int cap;
   int line;
+  lcl_call_cache cache;
 } lcl_command;
 
+/* Drops what the words hold; the arrays belong to the program's arena */
 void lcl_command_free(lcl_command *cmd);
-int lcl_command_push_word(lcl_command *cmd, lcl_word *w);
+int lcl_command_push_word(lcl_arena *a, lcl_command *cmd, lcl_word *w);
 
 typedef struct {
   lcl_command *cmd;
   int ncmd;
   int cap;
+  int refc;
   const char *file;
+  lcl_code *code;  /* register code, built on first run (lcl-vm.c) */
+  lcl_layout *layout;  /* frame layout when used as a proc body */
+  lcl_arena arena;  /* holds this struct and the cmd, w and wp arrays */
 } lcl_program;
 
+lcl_program *lcl_program_new(const char *file);
 void lcl_program_free(lcl_program *p);
+lcl_program *lcl_program_ref_inc(lcl_program *p);
+void lcl_program_ref_dec(lcl_program *p);
 lcl_program *lcl_program_compile(const char *src, const char *file);
+lcl_program *lcl_program_compile_n(const char *src, size_t n,
+                                   const char *file);
+size_t lcl_program_size(const lcl_program *p);
 int lcl_program_push_command(lcl_program *p, lcl_command *src);
 
 typedef enum {
@@ -36,11 +63,12 @@ typedef struct {
   lcl_word_piece_kind kind;
   union {
     struct {
-      char *s;
+      const char *s;  /* value's string */
       size_t n;
+      struct lcl_value *value;  /* shared string, handed out by reference */
     } lit;
     struct {
-      char *name;
+      const char *name;  /* a symbol (lcl-sym.h) */
     } var;
     struct {
       lcl_program *program;
@@ -48,6 +76,7 @@ typedef struct {
   } as;
 } lcl_word_piece;
 
+/* Drops what the piece holds */
 void lcl_word_piece_free(lcl_word_piece *wp);
 
 struct lcl_word {
@@ -56,12 +85,19 @@ struct lcl_word {
   int cap;
   unsigned quoted : 1;
   unsigned braced : 1;
+  /* Braced words used as script bodies are compiled once and kept here */
+  lcl_program *program;
+  /* Likewise for braced arguments of expr (lcl-expr.h) */
+  lcl_expr *expr;
 };
 
+/* Drops what the word holds, leaving its array to the arena */
 void lcl_word_free(lcl_word *w);
-int lcl_word_add_lit(lcl_word *w, const char *s, size_t n);
-int lcl_word_add_var(lcl_word *w, const char *name);
-int lcl_word_add_sub(lcl_word *w, lcl_program *sub);
+int lcl_word_add_lit(lcl_arena *a, lcl_word *w, const char *s, size_t n);
+int lcl_word_add_var(lcl_arena *a, lcl_word *w, const char *name);
+int lcl_word_add_var_n(lcl_arena *a, lcl_word *w, const char *name,
+                       size_t n);
+int lcl_word_add_sub(lcl_arena *a, lcl_word *w, lcl_program *sub);
 
 typedef struct {
   const char *s;
@@ -69,9 +105,10 @@ typedef struct {
   long len;
   long line;
   int at_cmd_start;
+  lcl_arena *arena;  /* of the program being built */
 } lcl_scan;
 
-void lcl_scan_init(lcl_scan *sc, const char *src);
+void lcl_scan_init(lcl_scan *sc, const char *src, size_t n, lcl_arena *a);
 int lcl_scan_word(lcl_scan *sc, lcl_word *w);
 int lcl_scan_parse_command(lcl_scan *sc, lcl_command *cmd);
 
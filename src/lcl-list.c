@@ -1,7 +1,10 @@
+#include <string.h>
+
+#include "lcl-alloc.h"
 #include "lcl-values.h"
 
 lcl_value *lcl_list_new(void) {
-  lcl_value *v = (lcl_value *)calloc(1, sizeof(*v));
+  lcl_value *v = lcl_value_alloc();
 
   if (!v) return NULL;
 
@@ -11,6 +14,34 @@ lcl_value *lcl_list_new(void) {
   return v;
 }
 
+/* A packed list of the n numbers in data, which it takes over; data
+ * must come from malloc */
+lcl_value *lcl_list_adopt_ints(long *data, size_t n) {
+  lcl_value *v = lcl_list_new();
+
+  if (!v) return NULL;
+
+  v->as.list.kind = LCL_LIST_INTS;
+  v->as.list.ints = data;
+  v->as.list.len = (int)n;
+  v->as.list.cap = (int)n;
+
+  return v;
+}
+
+lcl_value *lcl_list_adopt_floats(double *data, size_t n) {
+  lcl_value *v = lcl_list_new();
+
+  if (!v) return NULL;
+
+  v->as.list.kind = LCL_LIST_FLOATS;
+  v->as.list.floats = data;
+  v->as.list.len = (int)n;
+  v->as.list.cap = (int)n;
+
+  return v;
+}
+
 size_t lcl_list_len(const lcl_value *list) {
   if (list && list->type == LCL_LIST) {
     return list->as.list.len;
@@ -23,14 +54,60 @@ lcl_result lcl_list_get(const lcl_value *list, size_t i, lcl_value **out) {
   if (!list || list->type != LCL_LIST || !out) return LCL_ERROR;
   if (i >= (size_t)list->as.list.len) return LCL_ERROR;
 
-  *out = lcl_ref_inc(list->as.list.items[i]);
+  switch (list->as.list.kind) {
+  case LCL_LIST_INTS:
+    *out = lcl_int_new(list->as.list.ints[i]);
+    break;
+  case LCL_LIST_FLOATS:
+    *out = lcl_float_new(list->as.list.floats[i]);
+    break;
+  default:
+    *out = lcl_ref_inc(list->as.list.items[i]);
+    break;
+  }
+
+  return *out ? LCL_OK : LCL_ERROR;
+}
+
+/* Element i without taking a reference, or NULL when i is out of range.
+ * A packed list has no element values to lend, so it gives NULL too and
+ * the caller falls back on lcl_list_get. */
+lcl_value *lcl_list_peek(const lcl_value *list, size_t i) {
+  if (!list || list->type != LCL_LIST) return NULL;
+  if (i >= (size_t)list->as.list.len) return NULL;
+  if (list->as.list.kind != LCL_LIST_VALUES) return NULL;
 
-  return LCL_OK;
+  return list->as.list.items[i];
+}
+
+static size_t elem_size(lcl_list_kind kind) {
+  switch (kind) {
+  case LCL_LIST_INTS:   return sizeof(long);
+  case LCL_LIST_FLOATS: return sizeof(double);
+  default:              return sizeof(lcl_value *);
+  }
+}
+
+/* The array the list's elements live in, whichever kind it is */
+static void *elems(const lcl_value *list) {
+  switch (list->as.list.kind) {
+  case LCL_LIST_INTS:   return list->as.list.ints;
+  case LCL_LIST_FLOATS: return list->as.list.floats;
+  default:              return list->as.list.items;
+  }
+}
+
+static void set_elems(lcl_value *list, void *data) {
+  switch (list->as.list.kind) {
+  case LCL_LIST_INTS:   list->as.list.ints = (long *)data; break;
+  case LCL_LIST_FLOATS: list->as.list.floats = (double *)data; break;
+  default:              list->as.list.items = (lcl_value **)data; break;
+  }
 }
 
 static lcl_result lcl_list_ensure_cap(lcl_value *list, size_t need) {
   size_t newcap;
-  lcl_value **newitems;
+  void *grown;
 
   if (list->type != LCL_LIST) return LCL_ERROR;
   if ((size_t)list->as.list.cap >= need) return LCL_OK;
@@ -41,13 +118,93 @@ static lcl_result lcl_list_ensure_cap(lcl_value *list, size_t need) {
     newcap *= 2;
   }
 
-  newitems = (lcl_value **)realloc(list->as.list.items, newcap * sizeof(*newitems));
+  grown = lcl_realloc(elems(list), newcap * elem_size(list->as.list.kind));
 
-  if (!newitems) return LCL_ERROR;
+  if (!grown) return LCL_ERROR;
 
-  list->as.list.items = newitems;
+  set_elems(list, grown);
   list->as.list.cap = newcap;
-  
+
+  return LCL_OK;
+}
+
+/* Turn a packed list into a list of values, boxing each number */
+static lcl_result lcl_list_unpack(lcl_value *list) {
+  lcl_value **items;
+  size_t n = (size_t)list->as.list.len;
+  size_t cap = list->as.list.cap ? (size_t)list->as.list.cap : 1;
+  size_t i;
+
+  if (list->as.list.kind == LCL_LIST_VALUES) return LCL_OK;
+
+  items = (lcl_value **)lcl_malloc(cap * sizeof(*items));
+  if (!items) return LCL_ERROR;
+
+  for (i = 0; i < n; i++) {
+    if (lcl_list_get(list, i, &items[i]) != LCL_OK) {
+      while (i > 0) lcl_ref_dec(items[--i]);
+      lcl_free(items);
+      return LCL_ERROR;
+    }
+  }
+
+  lcl_free(elems(list));
+  list->as.list.ints = NULL;
+  list->as.list.floats = NULL;
+  list->as.list.items = items;
+  list->as.list.kind = LCL_LIST_VALUES;
+
+  return LCL_OK;
+}
+
+/* The kind of storage value can go into without unpacking list */
+static lcl_list_kind kind_for(const lcl_value *list, const lcl_value *value) {
+  lcl_list_kind kind = list->as.list.kind;
+
+  /* An empty list takes whatever its first element suits */
+  if (list->as.list.len == 0) {
+    if (value->type == LCL_INT) return LCL_LIST_INTS;
+    if (value->type == LCL_FLOAT) return LCL_LIST_FLOATS;
+    return LCL_LIST_VALUES;
+  }
+
+  if ((kind == LCL_LIST_INTS && value->type == LCL_INT) ||
+      (kind == LCL_LIST_FLOATS && value->type == LCL_FLOAT)) {
+    return kind;
+  }
+
+  return LCL_LIST_VALUES;
+}
+
+/* Store value in slot i, which holds nothing yet */
+static void store(lcl_value *list, size_t i, lcl_value *value) {
+  switch (list->as.list.kind) {
+  case LCL_LIST_INTS:
+    list->as.list.ints[i] = value->as.i;
+    break;
+  case LCL_LIST_FLOATS:
+    list->as.list.floats[i] = value->as.f;
+    break;
+  default:
+    list->as.list.items[i] = lcl_ref_inc(value);
+    break;
+  }
+}
+
+/* Make list able to hold value, unpacking it if need be */
+static lcl_result lcl_list_admit(lcl_value *list, lcl_value *value) {
+  lcl_list_kind kind = kind_for(list, value);
+
+  if (kind == list->as.list.kind) return LCL_OK;
+
+  if (list->as.list.len > 0) return lcl_list_unpack(list);
+
+  /* Empty, so there is nothing to convert */
+  lcl_free(elems(list));
+  set_elems(list, NULL);
+  list->as.list.cap = 0;
+  list->as.list.kind = kind;
+
   return LCL_OK;
 }
 
@@ -61,19 +218,23 @@ static lcl_value *lcl_list_clone_shallow(lcl_value *src) {
   if (!dest) return NULL;
 
   n = src->as.list.len;
+  dest->as.list.kind = src->as.list.kind;
 
   if (n) {
     size_t i = 0;
 
-    dest->as.list.items = malloc(n * sizeof(*dest->as.list.items));
-    if (!dest->as.list.items) {
+    if (lcl_list_ensure_cap(dest, n) != LCL_OK) {
       lcl_ref_dec(dest);
       return NULL;
     }
 
-    dest->as.list.cap = n;
     dest->as.list.len = n;
 
+    if (src->as.list.kind != LCL_LIST_VALUES) {
+      memcpy(elems(dest), elems(src), n * elem_size(src->as.list.kind));
+      return dest;
+    }
+
     for (i = 0; i < n; i++) {
       dest->as.list.items[i] = lcl_ref_inc(src->as.list.items[i]);
     }
@@ -89,16 +250,19 @@ lcl_result lcl_list_push(lcl_value **list_io, lcl_value *value) {
 
   if (list->refc > 1) {
     lcl_value *dup = lcl_list_clone_shallow(list);
+
+    if (!dup) return LCL_ERROR;
     lcl_ref_dec(list);
     *list_io = list = dup;
   }
 
-  if (lcl_list_ensure_cap(list, list->as.list.len + 1) != LCL_OK) {
+  if (lcl_list_admit(list, value) != LCL_OK ||
+      lcl_list_ensure_cap(list, list->as.list.len + 1) != LCL_OK) {
     return LCL_ERROR;
   }
 
-  list->as.list.items[list->as.list.len++] = lcl_ref_inc(value);
-  free(list->str_repr);
+  store(list, (size_t)list->as.list.len++, value);
+  lcl_free(list->str_repr);
   list->str_repr = NULL;
 
   return LCL_OK;
@@ -113,13 +277,20 @@ lcl_result lcl_list_set(lcl_value **list_io, size_t i, lcl_value *value) {
   /* Copy-on-write */
   if (list->refc > 1) {
     lcl_value *dup = lcl_list_clone_shallow(list);
+
+    if (!dup) return LCL_ERROR;
     lcl_ref_dec(list);
     *list_io = list = dup;
   }
 
-  lcl_ref_dec(list->as.list.items[i]);
-  list->as.list.items[i] = lcl_ref_inc(value);
-  free(list->str_repr);
+  if (lcl_list_admit(list, value) != LCL_OK) return LCL_ERROR;
+
+  if (list->as.list.kind == LCL_LIST_VALUES) {
+    lcl_ref_dec(list->as.list.items[i]);
+  }
+
+  store(list, i, value);
+  lcl_free(list->str_repr);
   list->str_repr = NULL;
 
   return LCL_OK;
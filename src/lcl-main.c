@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "lcl-compile.h"
 #include "lcl-values.h"
@@ -7,6 +8,13 @@
 
 void lcl_register_core(lcl_interp *interp);
 int lcl_eval_file(lcl_interp *interp, const char *filepath, lcl_value **out);
+lcl_result lcl_compile_file(const char *path, const char *out_path);
+
+static int usage(const char *argv0) {
+  fprintf(stderr, "Usage: %s <script.lcl>\n", argv0);
+  fprintf(stderr, "       %s --compile <script.lcl> [out.lclc]\n", argv0);
+  return 1;
+}
 
 int main(int argc, char **argv) {
   lcl_interp *interp;
@@ -14,8 +22,20 @@ int main(int argc, char **argv) {
   int rc;
 
   if (argc < 2) {
-    fprintf(stderr, "Usage: %s <script.lcl>\n", argv[0]);
-    return 1;
+    return usage(argv[0]);
+  }
+
+  if (strcmp(argv[1], "--compile") == 0) {
+    if (argc < 3 || argc > 4) {
+      return usage(argv[0]);
+    }
+
+    if (lcl_compile_file(argv[2], argc == 4 ? argv[3] : NULL) != LCL_OK) {
+      fprintf(stderr, "Failed to compile %s\n", argv[2]);
+      return 1;
+    }
+
+    return 0;
   }
 
   interp = lcl_interp_new();
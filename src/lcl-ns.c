@@ -1,6 +1,7 @@
 #include <memory.h>
 #include <string.h>
 
+#include "lcl-alloc.h"
 #include "lcl-values.h"
 
 static lcl_result ns_def_take(lcl_value *ns, const char *name, lcl_value *value) {
@@ -15,7 +16,7 @@ static lcl_result ns_def_take(lcl_value *ns, const char *name, lcl_value *value)
 
 lcl_value *lcl_ns_new(const char *qname) {
   hash_table *h;
-  lcl_value *v = (lcl_value *)calloc(1, sizeof(*v));
+  lcl_value *v = lcl_value_alloc();
 
   if (!v) return NULL;
 
@@ -24,7 +25,7 @@ lcl_value *lcl_ns_new(const char *qname) {
   h = hash_table_new();
 
   if (!h) {
-    free(v);
+    lcl_value_free(v);
     return NULL;
   }
 
@@ -32,21 +33,21 @@ lcl_value *lcl_ns_new(const char *qname) {
 
   if (qname) {
     size_t n = strlen(qname);
-    v->str_repr = (char *)malloc(n + 1);
+    v->str_repr = (char *)lcl_malloc(n + 1);
 
     if (!v->str_repr) {
       hash_table_free(h);
-      free(v);
+      lcl_value_free(v);
       return NULL;
     }
 
     memcpy(v->str_repr, qname, n + 1);
-    v->as.namespace.qname = malloc(n + 1);
+    v->as.namespace.qname = lcl_malloc(n + 1);
 
     if (!v->as.namespace.qname) {
-      free(v->str_repr);
+      lcl_free(v->str_repr);
       hash_table_free(h);
-      free(v);
+      lcl_value_free(v);
       return NULL;
     }
 
@@ -56,6 +57,8 @@ lcl_value *lcl_ns_new(const char *qname) {
   return v;
 }
 
+/* Does not invalidate call-site caches (lcl-env.c); meant for filling a
+ * namespace before any script runs. */
 lcl_result lcl_ns_def(lcl_value *ns, const char *name, lcl_value *value) {
   lcl_result r = ns_def_take(ns, name, value);
   lcl_ref_dec(value);
@@ -72,6 +75,17 @@ lcl_result lcl_ns_get(lcl_value *ns, const char *name, lcl_value **out) {
   return LCL_OK;
 }
 
+/* lcl_ns_get with the name's hash already known */
+lcl_result lcl_ns_get_key(lcl_value *ns, const hash_key *k, lcl_value **out) {
+  if (!ns || ns->type != LCL_NAMESPACE) return LCL_ERROR;
+
+  if (!hash_table_get_key(ns->as.namespace.namespace, k, out)) {
+    return LCL_ERROR;
+  }
+
+  return LCL_OK;
+}
+
 const char *lcl_ns_split(const char *q, char *lhs, size_t nlhs, const char **rhs) {
   size_t n;
   const char *p = strstr(q, "::");
@@ -1,10 +1,42 @@
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "lcl-thread.h"
 #include "lcl-values.h"
 
+/* Constants for the small integers, shared by every interpreter.  They
+ * are built once, string and all, and never written again, so threads
+ * can read them without a lock. */
+static lcl_value small_ints[LCL_SMALL_INT_MAX - LCL_SMALL_INT_MIN + 1];
+static lcl_once_flag small_ints_once = LCL_ONCE_INIT;
+
+static void small_ints_init(void) {
+  long n;
+
+  for (n = LCL_SMALL_INT_MIN; n <= LCL_SMALL_INT_MAX; n++) {
+    lcl_value *v = &small_ints[n - LCL_SMALL_INT_MIN];
+
+    v->type = LCL_INT;
+    v->refc = LCL_REFC_IMMORTAL;
+    v->as.i = n;
+
+    /* Short enough to sit in the value, so this cannot fail */
+    lcl_value_to_string(v);
+  }
+}
+
 lcl_value *lcl_int_new(const long n) {
-  lcl_value *v = (lcl_value *)calloc(1, sizeof(*v));
+  lcl_value *v;
+
+  if (n >= LCL_SMALL_INT_MIN && n <= LCL_SMALL_INT_MAX) {
+    lcl_once(&small_ints_once, small_ints_init);
+
+    return &small_ints[n - LCL_SMALL_INT_MIN];
+  }
+
+  v = lcl_value_alloc();
 
   if (!v) return NULL;
 
@@ -12,13 +44,11 @@ lcl_value *lcl_int_new(const long n) {
   v->refc = 1;
   v->as.i = n;
 
-  lcl_value_to_string(v);
-
   return v;
 }
 
-lcl_value *lcl_float_new(const float f) {
-  lcl_value *v = (lcl_value *)calloc(1, sizeof(*v));
+lcl_value *lcl_float_new(const double f) {
+  lcl_value *v = lcl_value_alloc();
 
   if (!v) return NULL;
 
@@ -26,9 +56,7 @@ lcl_value *lcl_float_new(const float f) {
   v->refc = 1;
   v->as.f = f;
 
-  lcl_value_to_string(v);  
-
-  return v;  
+  return v;
 }
 
 lcl_result lcl_value_to_int(lcl_value *value, long *out) {
@@ -43,12 +71,30 @@ lcl_result lcl_value_to_int(lcl_value *value, long *out) {
 
   case LCL_STRING: {
     char *endptr;
-    const char *str = lcl_value_to_string(value);
-    long val = strtol(str, &endptr, 10);
-    if (endptr != str && *endptr == '\0') {
+    const char *str;
+    long val;
+
+    if (value->as.str.num & LCL_STR_INT) {
+      *out = value->as.str.n.i;
+      return LCL_OK;
+    }
+
+    if (value->as.str.num & LCL_STR_NOT_INT) break;
+
+    str = lcl_value_to_string(value);
+    errno = 0;
+    val = strtol(str, &endptr, 10);
+
+    /* Digits past the range of a long are left to the double */
+    if (endptr != str && *endptr == '\0' && errno != ERANGE) {
+      /* n now holds the integer, which gives the double as well */
+      value->as.str.n.i = val;
+      value->as.str.num = (value->as.str.num & ~LCL_STR_FLOAT) | LCL_STR_INT;
       *out = val;
       return LCL_OK;
     }
+
+    value->as.str.num |= LCL_STR_NOT_INT;
     break;
   }
 
@@ -59,10 +105,10 @@ lcl_result lcl_value_to_int(lcl_value *value, long *out) {
   return LCL_ERROR;
 }
 
-lcl_result lcl_value_to_float(lcl_value *value, float *out) {
+lcl_result lcl_value_to_double(lcl_value *value, double *out) {
   switch (value->type) {
   case LCL_INT:
-    *out = (float)value->as.i;
+    *out = (double)value->as.i;
     return LCL_OK;
 
   case LCL_FLOAT:
@@ -70,13 +116,35 @@ lcl_result lcl_value_to_float(lcl_value *value, float *out) {
     return LCL_OK;
 
   case LCL_STRING: {
-    const char *str = lcl_value_to_string(value);
-    float val;
+    const char *str;
+    double val;
+
+    /* An integer's double is its rounding */
+    if (value->as.str.num & LCL_STR_INT) {
+      *out = (double)value->as.str.n.i;
+      return LCL_OK;
+    }
+
+    if (value->as.str.num & LCL_STR_FLOAT) {
+      *out = value->as.str.n.f;
+      return LCL_OK;
+    }
+
+    if (value->as.str.num & LCL_STR_NOT_FLOAT) break;
+
+    str = lcl_value_to_string(value);
+
+    if (sscanf(str, "%lf", &val) == 1) {
+      if (!(value->as.str.num & LCL_STR_INT)) {
+        value->as.str.n.f = val;
+        value->as.str.num |= LCL_STR_FLOAT;
+      }
 
-    if (sscanf(str, "%f", &val) == 1) {
       *out = val;
       return LCL_OK;
     }
+
+    value->as.str.num |= LCL_STR_NOT_FLOAT;
     break;
   }
 
@@ -86,3 +154,162 @@ lcl_result lcl_value_to_float(lcl_value *value, float *out) {
 
   return LCL_ERROR;
 }
+
+lcl_result lcl_value_to_float(lcl_value *value, float *out) {
+  double d;
+
+  if (lcl_value_to_double(value, &d) != LCL_OK) {
+    return LCL_ERROR;
+  }
+
+  *out = (float)d;
+  return LCL_OK;
+}
+
+/* ============================================================================
+ * Arithmetic
+ *
+ * Integers stay integers while the result fits in a long; otherwise, and
+ * whenever a double is involved, the operation is done in double.
+ * ============================================================================ */
+
+/* The value's tag decides; strings are integers if they read as one */
+lcl_result lcl_value_to_number(lcl_value *value, lcl_number *out) {
+  switch (value->type) {
+  case LCL_INT:
+    out->is_int = 1;
+    out->i = value->as.i;
+    return LCL_OK;
+
+  case LCL_FLOAT:
+    out->is_int = 0;
+    out->f = value->as.f;
+    return LCL_OK;
+
+  default:
+    if (lcl_value_to_int(value, &out->i) == LCL_OK) {
+      out->is_int = 1;
+      return LCL_OK;
+    }
+
+    out->is_int = 0;
+    return lcl_value_to_double(value, &out->f);
+  }
+}
+
+lcl_value *lcl_number_new(const lcl_number *n) {
+  return n->is_int ? lcl_int_new(n->i) : lcl_float_new(n->f);
+}
+
+static double num_double(const lcl_number *n) {
+  return n->is_int ? (double)n->i : n->f;
+}
+
+static void num_set_double(lcl_number *n, double f) {
+  n->is_int = 0;
+  n->f = f;
+}
+
+void lcl_number_add(lcl_number *acc, const lcl_number *b) {
+  if (acc->is_int && b->is_int &&
+      !(b->i > 0 && acc->i > LONG_MAX - b->i) &&
+      !(b->i < 0 && acc->i < LONG_MIN - b->i)) {
+    acc->i += b->i;
+    return;
+  }
+
+  num_set_double(acc, num_double(acc) + num_double(b));
+}
+
+void lcl_number_sub(lcl_number *acc, const lcl_number *b) {
+  if (acc->is_int && b->is_int &&
+      !(b->i < 0 && acc->i > LONG_MAX + b->i) &&
+      !(b->i > 0 && acc->i < LONG_MIN + b->i)) {
+    acc->i -= b->i;
+    return;
+  }
+
+  num_set_double(acc, num_double(acc) - num_double(b));
+}
+
+static int mul_overflows(long a, long b) {
+  if (a > 0) {
+    return b > 0 ? a > LONG_MAX / b : b < LONG_MIN / a;
+  }
+
+  if (b > 0) {
+    return a < LONG_MIN / b;
+  }
+
+  return a != 0 && b < LONG_MAX / a;
+}
+
+void lcl_number_mul(lcl_number *acc, const lcl_number *b) {
+  if (acc->is_int && b->is_int && !mul_overflows(acc->i, b->i)) {
+    acc->i *= b->i;
+    return;
+  }
+
+  num_set_double(acc, num_double(acc) * num_double(b));
+}
+
+/* Division by zero fails.  Two integers divide as C does, truncating;
+ * LONG_MIN / -1, the one quotient that does not fit, goes to double. */
+lcl_result lcl_number_div(lcl_number *acc, const lcl_number *b) {
+  if (b->is_int ? b->i == 0 : b->f == 0.0) {
+    return LCL_ERROR;
+  }
+
+  if (acc->is_int && b->is_int && !(acc->i == LONG_MIN && b->i == -1)) {
+    acc->i /= b->i;
+    return LCL_OK;
+  }
+
+  num_set_double(acc, num_double(acc) / num_double(b));
+  return LCL_OK;
+}
+
+/* i against d exactly, without rounding i to a double on the way */
+static int cmp_int_double(long i, double d) {
+  double top = -(double)LONG_MIN;  /* 2^(bits-1), exact */
+  long t;
+  double frac;
+
+  if (d != d) return LCL_CMP_UNORDERED;
+  if (d >= top) return -1;
+  if (d < (double)LONG_MIN) return 1;
+
+  /* In range, so its integer part is a long */
+  t = (long)d;
+
+  if (i != t) return i < t ? -1 : 1;
+
+  frac = d - (double)t;
+
+  return frac > 0 ? -1 : frac < 0 ? 1 : 0;
+}
+
+/* -1, 0 or 1 as a is less than, equal to or greater than b, or
+ * LCL_CMP_UNORDERED if either is NaN */
+int lcl_number_cmp(const lcl_number *a, const lcl_number *b) {
+  double x, y;
+
+  if (a->is_int && b->is_int) {
+    return (a->i > b->i) - (a->i < b->i);
+  }
+
+  if (a->is_int) return cmp_int_double(a->i, b->f);
+
+  if (b->is_int) {
+    int c = cmp_int_double(b->i, a->f);
+
+    return c == LCL_CMP_UNORDERED ? c : -c;
+  }
+
+  x = a->f;
+  y = b->f;
+
+  if (x != x || y != y) return LCL_CMP_UNORDERED;
+
+  return (x > y) - (x < y);
+}
@@ -7,6 +7,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include "lcl-alloc.h"
 #include "lcl-values.h"
 
 /*
@@ -21,16 +22,16 @@
  */
 lcl_value *lcl_opaque_new(void *ptr, const char *type_tag,
                           lcl_finalizer finalizer) {
-  lcl_value *v = (lcl_value *)calloc(1, sizeof(*v));
+  lcl_value *v = lcl_value_alloc();
   char *tag_copy = NULL;
 
   if (!v) return NULL;
 
   if (type_tag) {
     size_t len = strlen(type_tag);
-    tag_copy = (char *)malloc(len + 1);
+    tag_copy = (char *)lcl_malloc(len + 1);
     if (!tag_copy) {
-      free(v);
+      lcl_value_free(v);
       return NULL;
     }
     memcpy(tag_copy, type_tag, len + 1);
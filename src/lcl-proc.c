@@ -1,18 +1,19 @@
 #include <memory.h>
 #include <string.h>
 
+#include "lcl-alloc.h"
 #include "lcl-compile.h"
 #include "lcl-values.h"
 #include "lcl-lex.h"
-#include "str-compat.h"
+#include "lcl-sym.h"
 
 /* ============================================================================
  * Free Variable Extraction
  * ============================================================================ */
 
-/* Simple string set for deduplication */
+/* Set of symbols, in insertion order */
 typedef struct {
-  char **names;
+  const char **names;
   int count;
   int cap;
 } name_set;
@@ -26,35 +27,41 @@ static void name_set_init(name_set *s) {
 static void name_set_free(name_set *s) {
   int i;
   for (i = 0; i < s->count; i++) {
-    free(s->names[i]);
+    lcl_sym_release(s->names[i]);
   }
-  free(s->names);
+  lcl_free(s->names);
 }
 
-static int name_set_contains(name_set *s, const char *name) {
+static int name_set_contains(name_set *s, const char *sym) {
   int i;
   for (i = 0; i < s->count; i++) {
-    if (strcmp(s->names[i], name) == 0) return 1;
+    if (s->names[i] == sym) return 1;
   }
   return 0;
 }
 
 static int name_set_add(name_set *s, const char *name) {
-  char *copy;
-  if (name_set_contains(s, name)) return 1; /* Already present */
+  const char *sym = lcl_sym_intern(name);
+
+  if (!sym) return 0;
+
+  if (name_set_contains(s, sym)) { /* Already present */
+    lcl_sym_release(sym);
+    return 1;
+  }
 
   if (s->count >= s->cap) {
     int newcap = s->cap ? s->cap * 2 : 8;
-    char **newnames = realloc(s->names, (size_t)newcap * sizeof(char *));
-    if (!newnames) return 0;
+    const char **newnames = lcl_realloc(s->names, (size_t)newcap * sizeof(char *));
+    if (!newnames) {
+      lcl_sym_release(sym);
+      return 0;
+    }
     s->names = newnames;
     s->cap = newcap;
   }
 
-  copy = strdup(name);
-  if (!copy) return 0;
-
-  s->names[s->count++] = copy;
+  s->names[s->count++] = sym;
   return 1;
 }
 
@@ -114,7 +121,7 @@ lcl_upvalue *lcl_build_upvalues(lcl_interp *interp, const lcl_program *body,
   }
 
   /* Allocate upvalues array (may be larger than needed) */
-  upvals = calloc((size_t)vars.count, sizeof(lcl_upvalue));
+  upvals = lcl_calloc((size_t)vars.count, sizeof(lcl_upvalue));
   if (!upvals) {
     name_set_free(&vars);
     return NULL;
@@ -143,12 +150,8 @@ lcl_upvalue *lcl_build_upvalues(lcl_interp *interp, const lcl_program *body,
     if (is_param) continue;
 
     /* Try to look up the variable in current environment */
-    if (lcl_env_get_value(&interp->env, name, &val) == LCL_OK) {
-      upvals[nupvals].name = strdup(name);
-      if (!upvals[nupvals].name) {
-        lcl_ref_dec(val);
-        goto error;
-      }
+    if (lcl_env_get_sym(&interp->env, name, &val) == LCL_OK) {
+      upvals[nupvals].name = lcl_sym_ref(name);
 
       if (val->type == LCL_CELL) {
         /* Capture the cell itself (for mutable variables) */
@@ -168,35 +171,180 @@ lcl_upvalue *lcl_build_upvalues(lcl_interp *interp, const lcl_program *body,
 
   /* Shrink array if we captured fewer than collected */
   if (nupvals == 0) {
-    free(upvals);
+    lcl_free(upvals);
     *nout = 0;
     return NULL;
   }
 
   *nout = nupvals;
   return upvals;
+}
+
+/* ============================================================================
+ * Frame Layouts
+ * ============================================================================ */
+
+static int word_is(const lcl_word *w, const char *s) {
+  return w->np == 1 && w->wp[0].kind == LCL_WP_LIT &&
+         strcmp(w->wp[0].as.lit.s, s) == 0;
+}
+
+/* Collect the names a body can bind or read in its own frame: let/var
+ * targets and $references, including those inside braced script bodies
+ * (if/while/for/...), which run in the same frame.  Braced words are
+ * compiled here and kept on the word, where lcl_word_program finds them
+ * later.  Bodies of nested proc/lambda run in their own frames and are
+ * skipped. */
+static void collect_slot_names(const lcl_program *prog, name_set *names) {
+  int i, j, k;
+
+  for (i = 0; i < prog->ncmd; i++) {
+    const lcl_command *cmd = &prog->cmd[i];
+    int nested = 0;
+
+    if (cmd->argc == 0) continue;
+
+    if (word_is(&cmd->w[0], "proc") || word_is(&cmd->w[0], "lambda")) {
+      nested = 1;
+    }
+
+    if ((word_is(&cmd->w[0], "let") || word_is(&cmd->w[0], "var")) &&
+        cmd->argc >= 2 && cmd->w[1].np == 1 &&
+        cmd->w[1].wp[0].kind == LCL_WP_LIT) {
+      name_set_add(names, cmd->w[1].wp[0].as.lit.s);
+    }
+
+    for (j = 0; j < cmd->argc; j++) {
+      lcl_word *w = &cmd->w[j];
+
+      if (w->braced && w->np == 1 && w->wp[0].kind == LCL_WP_LIT) {
+        if (nested) continue;
+
+        if (!w->program) {
+          w->program = lcl_program_compile(w->wp[0].as.lit.s, prog->file);
+        }
+
+        if (w->program) {
+          collect_slot_names(w->program, names);
+        }
 
-error:
-  /* Clean up on error */
-  for (j = 0; j < nupvals; j++) {
-    free(upvals[j].name);
-    lcl_ref_dec(upvals[j].value);
+        continue;
+      }
+
+      for (k = 0; k < w->np; k++) {
+        lcl_word_piece *wp = &w->wp[k];
+
+        if (wp->kind == LCL_WP_VAR) {
+          name_set_add(names, wp->as.var.name);
+        } else if (wp->kind == LCL_WP_SUBCMD) {
+          collect_slot_names(wp->as.sub.program, names);
+        }
+      }
+    }
   }
-  free(upvals);
-  name_set_free(&vars);
-  return NULL;
+}
+
+static int layout_params_match(const lcl_layout *l, lcl_value *params_list) {
+  int n = (int)lcl_list_len(params_list);
+  int i;
+
+  if (l->nparams != n) return 0;
+
+  for (i = 0; i < n; i++) {
+    lcl_value *pname = NULL;
+    int same;
+
+    if (lcl_list_get(params_list, (size_t)i, &pname) != LCL_OK) return 0;
+
+    same = strcmp(lcl_value_to_string(pname), l->names[i]) == 0;
+    lcl_ref_dec(pname);
+
+    if (!same) return 0;
+  }
+
+  return 1;
+}
+
+static lcl_layout *layout_build(lcl_value *params_list, lcl_program *body) {
+  name_set names;
+  lcl_layout *l;
+  int nparams = (int)lcl_list_len(params_list);
+  int i;
+
+  name_set_init(&names);
+
+  for (i = 0; i < nparams; i++) {
+    lcl_value *pname = NULL;
+
+    if (lcl_list_get(params_list, (size_t)i, &pname) == LCL_OK) {
+      name_set_add(&names, lcl_value_to_string(pname));
+      lcl_ref_dec(pname);
+    }
+  }
+
+  /* Repeated param names bind by name, last one wins */
+  if (names.count != nparams) {
+    nparams = 0;
+  }
+
+  collect_slot_names(body, &names);
+
+  l = (lcl_layout *)lcl_calloc(1, sizeof(*l));
+
+  if (!l) {
+    name_set_free(&names);
+    return NULL;
+  }
+
+  l->refc = 1;
+  l->nslots = names.count;
+  l->nparams = nparams;
+  l->names = names.names;
+
+  return l;
+}
+
+lcl_layout *lcl_layout_for(lcl_value *params_list, lcl_program *body) {
+  lcl_layout *l;
+
+  if (body->layout && layout_params_match(body->layout, params_list)) {
+    return lcl_layout_ref_inc(body->layout);
+  }
+
+  l = layout_build(params_list, body);
+
+  if (l && !body->layout) {
+    body->layout = lcl_layout_ref_inc(l);
+  }
+
+  return l;
 }
 
 /* ============================================================================
  * Proc Creation
  * ============================================================================ */
 
+static void upvals_free(lcl_upvalue *upvals, int nupvals) {
+  int i;
+
+  for (i = 0; i < nupvals; i++) {
+    lcl_sym_release(upvals[i].name);
+    lcl_ref_dec(upvals[i].value);
+  }
+
+  lcl_free(upvals);
+}
+
 lcl_value *lcl_proc_new(lcl_upvalue *upvals, int nupvals,
                         lcl_value *params, lcl_program *body) {
-  lcl_proc *p = (lcl_proc *)calloc(1, sizeof(*p));
+  lcl_proc *p = (lcl_proc *)lcl_calloc(1, sizeof(*p));
   lcl_value *v;
 
-  if (!p) return NULL;
+  if (!p) {
+    upvals_free(upvals, nupvals);
+    lcl_program_ref_dec(body);
+    return NULL;
+  }
 
   /* Store upvalues (already have incremented refcounts from caller) */
   p->upvals = upvals;
@@ -205,19 +353,16 @@ lcl_value *lcl_proc_new(lcl_upvalue *upvals, int nupvals,
   p->body = body;
   p->capture_ns = 0;
   p->captured_ns = NULL;
+  p->layout = lcl_layout_for(params, body);
 
-  v = (lcl_value *)calloc(1, sizeof(*v));
+  v = lcl_value_alloc();
   if (!v) {
     /* Clean up upvalues on failure */
-    int i;
-    for (i = 0; i < nupvals; i++) {
-      free(upvals[i].name);
-      lcl_ref_dec(upvals[i].value);
-    }
-    free(upvals);
+    upvals_free(upvals, nupvals);
     lcl_ref_dec(p->params);
-    lcl_program_free(p->body);
-    free(p);
+    lcl_program_ref_dec(p->body);
+    lcl_layout_ref_dec(p->layout);
+    lcl_free(p);
     return NULL;
   }
 
@@ -228,8 +373,18 @@ lcl_value *lcl_proc_new(lcl_upvalue *upvals, int nupvals,
   return v;
 }
 
+/* The name a C proc prints as, in memory lcl_ref_dec can free */
+static char *copy_name(const char *name) {
+  size_t n = strlen(name);
+  char *copy = (char *)lcl_malloc(n + 1);
+
+  if (copy) memcpy(copy, name, n + 1);
+
+  return copy;
+}
+
 lcl_value *lcl_c_proc_new(const char *name, lcl_c_proc_fn fn) {
-  lcl_value *proc = (lcl_value *)calloc(1, sizeof(*proc));
+  lcl_value *proc = lcl_value_alloc();
   lcl_c_func *func;
   char *name_copy;
 
@@ -237,16 +392,16 @@ lcl_value *lcl_c_proc_new(const char *name, lcl_c_proc_fn fn) {
     return NULL;
   }
 
-  func = (lcl_c_func *)calloc(1, sizeof(*func));
+  func = (lcl_c_func *)lcl_calloc(1, sizeof(*func));
   if (!func) {
-    free(proc);
+    lcl_value_free(proc);
     return NULL;
   }
 
-  name_copy = strndup(name, strlen(name));
+  name_copy = copy_name(name);
   if (!name_copy) {
-    free(func);
-    free(proc);
+    lcl_free(func);
+    lcl_value_free(proc);
     return NULL;
   }
 
@@ -263,7 +418,7 @@ lcl_value *lcl_c_proc_new(const char *name, lcl_c_proc_fn fn) {
 }
 
 lcl_value *lcl_c_spec_new(const char *name, lcl_c_spec_fn fn) {
-  lcl_value *proc = (lcl_value *)calloc(1, sizeof(*proc));
+  lcl_value *proc = lcl_value_alloc();
   lcl_c_func *func;
   char *name_copy;
 
@@ -271,16 +426,16 @@ lcl_value *lcl_c_spec_new(const char *name, lcl_c_spec_fn fn) {
     return NULL;
   }
 
-  func = (lcl_c_func *)calloc(1, sizeof(*func));
+  func = (lcl_c_func *)lcl_calloc(1, sizeof(*func));
   if (!func) {
-    free(proc);
+    lcl_value_free(proc);
     return NULL;
   }
 
-  name_copy = strndup(name, strlen(name));
+  name_copy = copy_name(name);
   if (!name_copy) {
-    free(func);
-    free(proc);
+    lcl_free(func);
+    lcl_value_free(proc);
     return NULL;
   }
 
@@ -1,8 +1,31 @@
 #include <memory.h>
+#include <string.h>
 
 #include "lcl-lex.h"
+#include "lcl-values.h"
+#include "lcl-vm.h"
+
+/* An empty program.  The struct is the first thing in its own arena, so
+ * a small program is a single block. */
+lcl_program *lcl_program_new(const char *file) {
+  lcl_arena a;
+  lcl_program *p;
+
+  lcl_arena_init(&a);
+  p = (lcl_program *)lcl_arena_alloc(&a, sizeof(*p));
+
+  if (!p) return NULL;
+
+  memset(p, 0, sizeof(*p));
+  p->refc = 1;
+  p->file = file;
+  p->arena = a;
+
+  return p;
+}
 
 void lcl_program_free(lcl_program *p) {
+  lcl_arena a;
   int i;
 
   if (!p) return;
@@ -11,20 +34,76 @@ void lcl_program_free(lcl_program *p) {
     lcl_command_free(&p->cmd[i]);
   }
 
-  free(p->cmd);
-  free(p);
+  lcl_code_free(p->code);
+  lcl_layout_ref_dec(p->layout);
+
+  a = p->arena;
+  lcl_arena_free(&a);
+}
+
+lcl_program *lcl_program_ref_inc(lcl_program *p) {
+  if (p) p->refc++;
+
+  return p;
+}
+
+void lcl_program_ref_dec(lcl_program *p) {
+  if (!p) return;
+  if (--p->refc > 0) return;
+
+  lcl_program_free(p);
+}
+
+/* Approximate heap footprint of p, used to keep compile caches bounded */
+size_t lcl_program_size(const lcl_program *p) {
+  size_t n;
+  int i, j, k;
+
+  if (!p) return 0;
+
+  n = p->arena.bytes;
+
+  for (i = 0; i < p->ncmd; i++) {
+    const lcl_command *cmd = &p->cmd[i];
+
+    for (j = 0; j < cmd->argc; j++) {
+      const lcl_word *w = &cmd->w[j];
+
+      for (k = 0; k < w->np; k++) {
+        const lcl_word_piece *pc = &w->wp[k];
+
+        switch (pc->kind) {
+        case LCL_WP_LIT:
+          n += sizeof(lcl_value);
+          if (pc->as.lit.n > LCL_SSO_MAX) n += pc->as.lit.n + 1;
+          break;
+        case LCL_WP_VAR:
+          n += strlen(pc->as.var.name) + 1;
+          break;
+        case LCL_WP_SUBCMD:
+          n += lcl_program_size(pc->as.sub.program);
+          break;
+        }
+      }
+    }
+  }
+
+  return n;
 }
 
 lcl_program *lcl_program_compile(const char *src, const char *file) {
-  lcl_scan sc;
-  lcl_program *p;
+  return lcl_program_compile_n(src, strlen(src), file);
+}
 
-  lcl_scan_init(&sc, src);
-  p = (lcl_program *)calloc(1, sizeof(*p));
+/* Compile the first n bytes of src, which need not be NUL-terminated */
+lcl_program *lcl_program_compile_n(const char *src, size_t n,
+                                   const char *file) {
+  lcl_scan sc;
+  lcl_program *p = lcl_program_new(file);
 
   if (!p) return NULL;
 
-  p->file = file;
+  lcl_scan_init(&sc, src, n, &p->arena);
 
   for (;;) {
     lcl_command cmd;
@@ -39,6 +118,7 @@ lcl_program *lcl_program_compile(const char *src, const char *file) {
       return p;
     case 1:
       if (!lcl_program_push_command(p, &cmd)) {
+        lcl_command_free(&cmd);
         lcl_program_free(p);
         return NULL;
       }  
@@ -55,8 +135,9 @@ int lcl_program_push_command(lcl_program *p,
 
   if (p->ncmd >= p->cap) {
     int newcap = p->cap ? p->cap * 2 : 4;
-    size_t bytes = (size_t)newcap * sizeof(*p->cmd);
-    void *nv = realloc(p->cmd, bytes);
+    void *nv = lcl_arena_grow(&p->arena, p->cmd,
+                              (size_t)p->cap * sizeof(*p->cmd),
+                              (size_t)newcap * sizeof(*p->cmd));
 
     if (!nv) return 0;
 
@@ -1,3 +1,5 @@
+#include "lcl-alloc.h"
+#include "lcl-sym.h"
 #include "lcl-values.h"
 
 #ifdef DEBUG_REFC
@@ -5,7 +7,7 @@
 #endif
 
 lcl_value *lcl_ref_inc(lcl_value *value) {
-  if (value) {
+  if (value && value->refc != LCL_REFC_IMMORTAL) {
     value->refc++;
 #ifdef DEBUG_REFC
     fprintf(stderr, "INC %s rc = %d\n", value->str_repr, value->refc);
@@ -16,24 +18,28 @@ lcl_value *lcl_ref_inc(lcl_value *value) {
 }
 
 void lcl_ref_dec(lcl_value *value) {
-  if (!value) return;
+  if (!value || value->refc == LCL_REFC_IMMORTAL) return;
   if (--value->refc) return;
 
 #ifdef DEBUG_REFC
   fprintf(stderr, "DEC %s rc = %d\n", value->str_repr, value->refc);
 #endif
 
-  free(value->str_repr);
+  lcl_value_clear_string(value);
 
   switch(value->type) {
   case LCL_LIST: {
     int i;
 
-    for (i = 0; i < value->as.list.len; i++) {
-      lcl_ref_dec(value->as.list.items[i]);
+    if (value->as.list.kind == LCL_LIST_VALUES) {
+      for (i = 0; i < value->as.list.len; i++) {
+        lcl_ref_dec(value->as.list.items[i]);
+      }
     }
 
-    free(value->as.list.items);
+    lcl_free(value->as.list.items);
+    lcl_free(value->as.list.ints);
+    lcl_free(value->as.list.floats);
   } break;
 
   case LCL_DICT: {
@@ -45,23 +51,24 @@ void lcl_ref_dec(lcl_value *value) {
     int i;
     /* Free upvalues */
     for (i = 0; i < p->nupvals; i++) {
-      free(p->upvals[i].name);
+      lcl_sym_release(p->upvals[i].name);
       lcl_ref_dec(p->upvals[i].value);
     }
-    free(p->upvals);
+    lcl_free(p->upvals);
     lcl_ref_dec(p->params);
     lcl_ref_dec(p->captured_ns);
-    lcl_program_free(p->body);
-    free(p);
+    lcl_program_ref_dec(p->body);
+    lcl_layout_ref_dec(p->layout);
+    lcl_free(p);
   } break;
 
   case LCL_NAMESPACE: {
     hash_table_free(value->as.namespace.namespace);
-    free(value->as.namespace.qname);
+    lcl_free(value->as.namespace.qname);
   } break;
 
   case LCL_CPROC: {
-    free(value->as.c_proc.fn);
+    lcl_free(value->as.c_proc.fn);
   } break;
 
   case LCL_CELL: {
@@ -72,12 +79,12 @@ void lcl_ref_dec(lcl_value *value) {
     if (value->as.opaque.finalizer && value->as.opaque.ptr) {
       value->as.opaque.finalizer(value->as.opaque.ptr);
     }
-    free((void *)value->as.opaque.type_tag);
+    lcl_free((void *)value->as.opaque.type_tag);
   } break;
 
   default:
     break;
   }
 
-  free(value);
+  lcl_value_free(value);
 }
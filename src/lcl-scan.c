@@ -3,7 +3,6 @@
 #include <string.h>
 
 #include "lcl-lex.h"
-#include "str-compat.h"
 
 static int is_name(int c) {
   return (c == '_' ||
@@ -63,12 +62,22 @@ static void skip_intra_ws(lcl_scan *sc) {
   }
 }
 
-void lcl_scan_init(lcl_scan *sc, const char *src) {
+/* Word pieces for the source text from..to */
+static int scan_lit(lcl_scan *sc, lcl_word *w, long from, long to) {
+  return lcl_word_add_lit(sc->arena, w, sc->s + from, (size_t)(to - from));
+}
+
+static int scan_var(lcl_scan *sc, lcl_word *w, long from, long to) {
+  return lcl_word_add_var_n(sc->arena, w, sc->s + from, (size_t)(to - from));
+}
+
+void lcl_scan_init(lcl_scan *sc, const char *src, size_t n, lcl_arena *a) {
   sc->s = src;
   sc->i = 0;
-  sc->len = (long)strlen(src);
+  sc->len = (long)n;
   sc->line = 1;
   sc->at_cmd_start = 1;
+  sc->arena = a;
 }
 
 int lcl_scan_word(lcl_scan *sc, lcl_word *w) {
@@ -100,7 +109,7 @@ int lcl_scan_word(lcl_scan *sc, lcl_word *w) {
       return -1;
     }
 
-    if (!lcl_word_add_lit(w, sc->s + start, (size_t)(sc->i - start - 1))) {
+    if (!scan_lit(sc, w, start, sc->i - 1)) {
       return -1;
     }
 
@@ -134,7 +143,7 @@ int lcl_scan_word(lcl_scan *sc, lcl_word *w) {
 
     if (c == '$') {
       if (sc->i > start) {
-        if (!lcl_word_add_lit(w, sc->s + start, (size_t)(sc->i - start))) {
+        if (!scan_lit(sc, w, start, sc->i)) {
           return -1;
         }
       }
@@ -154,21 +163,8 @@ int lcl_scan_word(lcl_scan *sc, lcl_word *w) {
         if (j >= sc->len) return -1;
         if (j == sc->i) return -1;
 
-        {
-          size_t n = (size_t)(j - sc->i);
-          char *nm = (char *)malloc(n + 1);
-
-          if (!nm) return -1;
-
-          memcpy(nm, sc->s + sc->i, n);
-          nm[n] = '\0';
-
-          if (!lcl_word_add_var(w, nm)) {
-            free(nm);
-            return -1;
-          }
-
-          free(nm);
+        if (!scan_var(sc, w, sc->i, j)) {
+          return -1;
         }
 
         sc->i = j + 1;
@@ -177,27 +173,20 @@ int lcl_scan_word(lcl_scan *sc, lcl_word *w) {
         long j = sc->i;
 
         if (j < sc->len && (isalpha((unsigned char)sc->s[j]) || sc->s[j] == '_')) {
-          char *varname;
-          int ok;
-
           j++;
 
           while (j < sc->len && is_name((unsigned char)sc->s[j])) {
             j++;
           }
 
-          varname = strndup(sc->s + sc->i, (size_t)(j - sc->i));
-          ok = lcl_word_add_var(w, varname);
-          free(varname);
-
-          if (!ok) {
+          if (!scan_var(sc, w, sc->i, j)) {
             return -1;
           }
 
           sc->i = j;
           start = sc->i;
         } else {
-          if (!lcl_word_add_lit(w, "$", 1)) {
+          if (!lcl_word_add_lit(sc->arena, w, "$", 1)) {
             return 1;
           }
 
@@ -210,7 +199,7 @@ int lcl_scan_word(lcl_scan *sc, lcl_word *w) {
 
     if (c == '[') {
       if (sc->i > start) {
-        if (!lcl_word_add_lit(w, sc->s + start, (size_t)(sc->i - start))) {
+        if (!scan_lit(sc, w, start, sc->i)) {
           return -1;
         }
       }
@@ -269,15 +258,12 @@ int lcl_scan_word(lcl_scan *sc, lcl_word *w) {
 
         if (depth) return -1;
 
-        {
-          char *subsrc = strndup(sc->s + begin, (size_t)(sc->i - begin - 1));
-          sub = lcl_program_compile(subsrc, NULL);
-          free(subsrc);
-        }
+        sub = lcl_program_compile_n(sc->s + begin,
+                                    (size_t)(sc->i - begin - 1), NULL);
 
         if (!sub) return -1;
 
-        if (!lcl_word_add_sub(w, sub)) {
+        if (!lcl_word_add_sub(sc->arena, w, sub)) {
           lcl_program_free(sub);
           return -1;
         }
@@ -291,7 +277,7 @@ int lcl_scan_word(lcl_scan *sc, lcl_word *w) {
     if (c == '"') {
       if (in_quotes) {
         if (sc->i > start) {
-          if (!lcl_word_add_lit(w, sc->s + start, (size_t)(sc->i - start))) {
+          if (!scan_lit(sc, w, start, sc->i)) {
             return -1;
           }
         }
@@ -311,7 +297,7 @@ int lcl_scan_word(lcl_scan *sc, lcl_word *w) {
     if (c == '\\') {
       if (sc->i + 1 < sc->len && sc->s[sc->i + 1] == '\n') {
         if (sc->i > start) {
-          if (!lcl_word_add_lit(w, sc->s + start, (size_t)(sc->i - start))) {
+          if (!scan_lit(sc, w, start, sc->i)) {
             return -1;
           }
         }
@@ -332,7 +318,7 @@ int lcl_scan_word(lcl_scan *sc, lcl_word *w) {
   }
 
   if (sc->i > start) {
-    if (!lcl_word_add_lit(w, sc->s + start, (size_t)(sc->i - start))) {
+    if (!scan_lit(sc, w, start, sc->i)) {
       return -1;
     }
   }
@@ -406,6 +392,7 @@ int lcl_scan_parse_command(lcl_scan *sc, lcl_command *cmd) {
     }
 
     if (lcl_scan_word(sc, &w) < 0) {
+      lcl_word_free(&w);
       return -1;
     }
 
@@ -413,7 +400,8 @@ int lcl_scan_parse_command(lcl_scan *sc, lcl_command *cmd) {
       break;
     }
 
-    if (!lcl_command_push_word(cmd, &w))  {
+    if (!lcl_command_push_word(sc->arena, cmd, &w))  {
+      lcl_word_free(&w);
       return -1;
     }
 
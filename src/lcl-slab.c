@@ -0,0 +1,195 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lcl-alloc.h"
+#include "lcl-thread.h"
+#include "lcl-values.h"
+
+/* Value headers are all the same size, so they are carved out of chunks
+ * and recycled through a free list instead of going to malloc one at a
+ * time.  A freed header is reused before anything else, which keeps
+ * recently used values close together.
+ *
+ * Each interpreter has a slab of its own, current on a thread while it
+ * runs there, so slabs need no lock.  A header remembers its slab and
+ * goes back to it wherever it is freed.  Chunks are kept while any value
+ * is live and all handed back when the last one goes; a slab whose
+ * interpreter is gone goes once its last value and frame have.  Values
+ * made while no interpreter runs, by the host, are allocated one by
+ * one.  The slab also holds the interpreter's spare frames, which
+ * lcl-frame.c looks after. */
+
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/asan_interface.h>
+#define POISON(p, n) ASAN_POISON_MEMORY_REGION((p), (n))
+#define UNPOISON(p, n) ASAN_UNPOISON_MEMORY_REGION((p), (n))
+#else
+#define POISON(p, n) ((void)0)
+#define UNPOISON(p, n) ((void)0)
+#endif
+
+typedef union lcl_slot {
+  union lcl_slot *next;  /* while on the free list */
+  lcl_value value;
+} lcl_slot;
+
+typedef struct lcl_chunk {
+  struct lcl_chunk *next;
+  size_t n;
+  lcl_slot slots[1];
+} lcl_chunk;
+
+struct lcl_slab {
+  lcl_chunk *chunks;
+  lcl_slot *free_slots;
+  size_t fresh;         /* slots at the end of the newest chunk never used */
+  size_t chunk_values;
+  lcl_slab_stats stats;
+  lcl_frame_cache frames;
+  int open;             /* until lcl_slab_close */
+};
+
+static LCL_THREAD_LOCAL lcl_slab *current;
+
+static size_t chunk_bytes(size_t n) {
+  return sizeof(lcl_chunk) + (n - 1) * sizeof(lcl_slot);
+}
+
+static int slab_grow(lcl_slab *sl) {
+  size_t n = sl->chunk_values;
+  lcl_chunk *c = (lcl_chunk *)lcl_malloc(chunk_bytes(n));
+
+  if (!c) return 0;
+
+  c->next = sl->chunks;
+  c->n = n;
+  sl->chunks = c;
+  sl->fresh = n;
+  POISON(c->slots, n * sizeof(lcl_slot));
+
+  sl->stats.chunks++;
+  sl->stats.bytes += chunk_bytes(n);
+
+  return 1;
+}
+
+/* With no value live the chunks go back, and with no frame live either
+ * a closed slab goes too */
+void lcl_slab_release(lcl_slab *sl) {
+  if (sl->stats.live) return;
+
+  while (sl->chunks) {
+    lcl_chunk *next = sl->chunks->next;
+    UNPOISON(sl->chunks->slots, sl->chunks->n * sizeof(lcl_slot));
+    lcl_free(sl->chunks);
+    sl->chunks = next;
+  }
+
+  sl->free_slots = NULL;
+  sl->fresh = 0;
+  sl->stats.chunks = 0;
+  sl->stats.bytes = 0;
+
+  if (!sl->open && !sl->frames.live) lcl_free(sl);
+}
+
+lcl_value *lcl_value_alloc(void) {
+  lcl_slab *sl = current;
+  lcl_slot *s;
+
+  if (!sl) return (lcl_value *)lcl_calloc(1, sizeof(lcl_value));
+
+  s = sl->free_slots;
+
+  if (s) {
+    UNPOISON(s, sizeof(*s));
+    sl->free_slots = s->next;
+  } else {
+    if (!sl->fresh && !slab_grow(sl)) return NULL;
+    s = &sl->chunks->slots[sl->chunks->n - sl->fresh--];
+    UNPOISON(s, sizeof(*s));
+  }
+
+  sl->stats.allocs++;
+  sl->stats.live++;
+  memset(&s->value, 0, sizeof(s->value));
+  s->value.slab = sl;
+
+  return &s->value;
+}
+
+void lcl_value_free(lcl_value *v) {
+  lcl_slot *s = (lcl_slot *)v;
+  lcl_slab *sl;
+
+  if (!v) return;
+
+  sl = v->slab;
+
+  if (!sl) {
+    lcl_free(v);
+    return;
+  }
+
+  sl->stats.frees++;
+
+  if (!--sl->stats.live) {
+    lcl_slab_release(sl);
+    return;
+  }
+
+  s->next = sl->free_slots;
+  sl->free_slots = s;
+  POISON(s, sizeof(*s));
+}
+
+lcl_slab *lcl_slab_new(void) {
+  lcl_slab *sl = (lcl_slab *)lcl_calloc(1, sizeof(*sl));
+
+  if (!sl) return NULL;
+
+  sl->chunk_values = LCL_SLAB_CHUNK;
+  sl->open = 1;
+
+  return sl;
+}
+
+void lcl_slab_close(lcl_slab *sl) {
+  if (!sl) return;
+
+  sl->open = 0;
+  lcl_slab_release(sl);
+}
+
+lcl_slab *lcl_slab_enter(lcl_slab *sl) {
+  lcl_slab *prev = current;
+
+  current = sl;
+
+  return prev;
+}
+
+void lcl_slab_leave(lcl_slab *prev) {
+  current = prev;
+}
+
+lcl_slab *lcl_slab_current(void) {
+  return current;
+}
+
+lcl_frame_cache *lcl_slab_frames(lcl_slab *sl) {
+  return &sl->frames;
+}
+
+void lcl_slab_set_chunk(lcl_interp *interp, size_t values) {
+  if (!interp) return;
+
+  interp->slab->chunk_values = values ? values : LCL_SLAB_CHUNK;
+}
+
+void lcl_slab_get_stats(lcl_interp *interp, lcl_slab_stats *out) {
+  if (!interp || !out) return;
+
+  *out = interp->slab->stats;
+  out->chunk = interp->slab->chunk_values;
+}
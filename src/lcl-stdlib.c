@@ -1,9 +1,14 @@
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "lcl-alloc.h"
 #include "lcl-compile.h"
 #include "lcl-eval.h"
+#include "lcl-expr.h"
+#include "lcl-image.h"
 #include "lcl-values.h"
+#include "lcl-vec.h"
 
 #include "lcl-stdlib.h"
 
@@ -33,7 +38,7 @@ int c_puts(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
   fputc('\n', stdout);
   fflush(stdout);
 
-  *out = lcl_string_new("");
+  *out = lcl_string_empty();
 
   return LCL_RC_OK;
 }
@@ -94,95 +99,98 @@ int c_not(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
 }
 
 int c_add(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
-  float sum = 0.0f;
+  lcl_number sum;
+  lcl_number v;
   int i;
-  float v;
   (void)interp;
 
+  sum.is_int = 1;
+  sum.i = 0;
+
   for (i = 0; i < argc; i++) {
-    if (lcl_value_to_float(argv[i], &v) != LCL_OK) {
+    if (lcl_value_to_number(argv[i], &v) != LCL_OK) {
       return LCL_RC_ERR;
     }
 
-    sum += v;
+    lcl_number_add(&sum, &v);
   }
 
-  *out = lcl_float_new(sum);
+  *out = lcl_number_new(&sum);
 
   return LCL_RC_OK;
 }
 
 int c_sub(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
-  float result;
+  lcl_number result;
+  lcl_number v;
   int i;
-  float v;
   (void)interp;
 
   if (argc < 2) {
     return LCL_RC_ERR;
   }
 
-  if (lcl_value_to_float(argv[0], &result) != LCL_OK) {
+  if (lcl_value_to_number(argv[0], &result) != LCL_OK) {
     return LCL_RC_ERR;
   }
 
   for (i = 1; i < argc; i++) {
-    if (lcl_value_to_float(argv[i], &v) != LCL_OK) {
+    if (lcl_value_to_number(argv[i], &v) != LCL_OK) {
       return LCL_RC_ERR;
     }
 
-    result -= v;
+    lcl_number_sub(&result, &v);
   }
 
-  *out = lcl_float_new(result);
+  *out = lcl_number_new(&result);
 
   return LCL_RC_OK;
 }
 
 int c_mult(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
-  float product = 1.0f;
+  lcl_number product;
+  lcl_number v;
   int i;
-  float v;
   (void)interp;
 
+  product.is_int = 1;
+  product.i = 1;
+
   for (i = 0; i < argc; i++) {
-    if (lcl_value_to_float(argv[i], &v) != LCL_OK) {
+    if (lcl_value_to_number(argv[i], &v) != LCL_OK) {
       return LCL_RC_ERR;
     }
 
-    product *= v;
+    lcl_number_mul(&product, &v);
   }
 
-  *out = lcl_float_new(product);
+  *out = lcl_number_new(&product);
 
   return LCL_RC_OK;
 }
 
 int c_div(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
+  lcl_number result;
+  lcl_number divisor;
   (void)interp;
-  float result;
-  float numerator;
-  float divisor;
 
   if (argc != 2) {
     return LCL_RC_ERR;
   }
 
-  if (lcl_value_to_float(argv[0], &numerator) != LCL_OK) {
+  if (lcl_value_to_number(argv[0], &result) != LCL_OK) {
     return LCL_RC_ERR;
   }
 
-  if (lcl_value_to_float(argv[1], &divisor) != LCL_OK) {
+  if (lcl_value_to_number(argv[1], &divisor) != LCL_OK) {
     return LCL_RC_ERR;
   }
 
-  if (divisor == 0.0f) {
+  if (lcl_number_div(&result, &divisor) != LCL_OK) {
     return LCL_RC_ERR;
   }
 
-  result = numerator / divisor;
-
-  *out = lcl_float_new(result);
+  *out = lcl_number_new(&result);
 
   return LCL_RC_OK;
 }
@@ -201,115 +209,98 @@ int c_mod(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
     return LCL_RC_ERR;
   }
 
-  if (lcl_value_to_int(argv[1], &divisor) != LCL_OK) {
+  if (lcl_value_to_int(argv[1], &divisor) != LCL_OK || divisor == 0) {
     return LCL_RC_ERR;
   }
 
-  result = dividend % divisor;
+  result = divisor == -1 ? 0 : dividend % divisor;
 
   *out = lcl_int_new(result);
 
   return LCL_RC_OK;
 }
 
-int c_lt(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
-  long result;
-  float left;
-  float right;
-  (void)interp;
+/* The ordering comparisons, differing only in which outcome is true */
+enum { CMP_LT, CMP_LE, CMP_GT, CMP_GE, CMP_EQ, CMP_NE, CMP_NOT };
 
-  if (argc != 2) {
-    return LCL_RC_ERR;
-  }
+/* a op b as a C truth value; LCL_ERROR if either is not a number */
+static lcl_result compare_values(lcl_value *a, lcl_value *b, int op,
+                                 int *result) {
+  lcl_number left;
+  lcl_number right;
+  int c;
 
-  if (lcl_value_to_float(argv[0], &left) != LCL_OK) {
-    return LCL_RC_ERR;
+  if (lcl_value_to_number(a, &left) != LCL_OK) {
+    return LCL_ERROR;
   }
 
-  if (lcl_value_to_float(argv[1], &right) != LCL_OK) {
-    return LCL_RC_ERR;
+  if (lcl_value_to_number(b, &right) != LCL_OK) {
+    return LCL_ERROR;
   }
 
-  result = left < right;
+  c = lcl_number_cmp(&left, &right);
 
-  *out = lcl_int_new(result);
+  switch (op) {
+  case CMP_LT: c = c == -1; break;
+  case CMP_LE: c = c == -1 || c == 0; break;
+  case CMP_GT: c = c == 1; break;
+  default:     c = c == 1 || c == 0; break;
+  }
 
-  return LCL_RC_OK;
+  *result = c;
+  return LCL_OK;
 }
 
-int c_lte(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
-  long result;
-  float left;
-  float right;
-  (void)interp;
-
-  if (argc != 2) {
-    return LCL_RC_ERR;
-  }
+static int compare(lcl_value **argv, lcl_value **out, int op) {
+  int c;
 
-  if (lcl_value_to_float(argv[0], &left) != LCL_OK) {
+  if (compare_values(argv[0], argv[1], op, &c) != LCL_OK) {
     return LCL_RC_ERR;
   }
 
-  if (lcl_value_to_float(argv[1], &right) != LCL_OK) {
-    return LCL_RC_ERR;
-  }
-
-  result = left <= right;
-
-  *out = lcl_int_new(result);
+  *out = lcl_int_new(c);
 
   return LCL_RC_OK;
 }
 
-int c_gt(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
-  long result;
-  float left;
-  float right;
+int c_lt(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
   (void)interp;
 
   if (argc != 2) {
     return LCL_RC_ERR;
   }
 
-  if (lcl_value_to_float(argv[0], &left) != LCL_OK) {
-    return LCL_RC_ERR;
-  }
+  return compare(argv, out, CMP_LT);
+}
+
+int c_lte(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
+  (void)interp;
 
-  if (lcl_value_to_float(argv[1], &right) != LCL_OK) {
+  if (argc != 2) {
     return LCL_RC_ERR;
   }
 
-  result = left > right;
-
-  *out = lcl_int_new(result);
-
-  return LCL_RC_OK;
+  return compare(argv, out, CMP_LE);
 }
 
-int c_gte(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
-  long result;
-  float left;
-  float right;
+int c_gt(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
   (void)interp;
 
   if (argc != 2) {
     return LCL_RC_ERR;
   }
 
-  if (lcl_value_to_float(argv[0], &left) != LCL_OK) {
-    return LCL_RC_ERR;
-  }
+  return compare(argv, out, CMP_GT);
+}
+
+int c_gte(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
+  (void)interp;
 
-  if (lcl_value_to_float(argv[1], &right) != LCL_OK) {
+  if (argc != 2) {
     return LCL_RC_ERR;
   }
 
-  result = left >= right;
-
-  *out = lcl_int_new(result);
-
-  return LCL_RC_OK;
+  return compare(argv, out, CMP_GE);
 }
 
 /* ============================================================================
@@ -360,12 +351,27 @@ static lcl_value *deref_once(lcl_value *v) {
   return v;
 }
 
+/* Element i of list, borrowed when the list holds values.  A packed list
+ * has to make one, which *held then owns until the caller drops it. */
+static lcl_value *list_elem(const lcl_value *list, size_t i,
+                            lcl_value **held) {
+  lcl_value *v = lcl_list_peek(list, i);
+
+  *held = NULL;
+
+  if (!v && lcl_list_get(list, i, held) == LCL_OK) {
+    v = *held;
+  }
+
+  return v;
+}
+
 static int list_equal_deep(lcl_value *a, lcl_value *b, eq_cycle_guard *guard) {
   size_t len_a;
   size_t len_b;
   size_t i;
-  lcl_value *elem_a;
-  lcl_value *elem_b;
+  lcl_value *elem_a, *held_a;
+  lcl_value *elem_b, *held_b;
   int result;
 
   len_a = lcl_list_len(a);
@@ -374,17 +380,14 @@ static int list_equal_deep(lcl_value *a, lcl_value *b, eq_cycle_guard *guard) {
   if (len_a != len_b) return 0;
 
   for (i = 0; i < len_a; i++) {
-    if (lcl_list_get(a, i, &elem_a) != LCL_OK) return 0;
-    
-    if (lcl_list_get(b, i, &elem_b) != LCL_OK) {
-      lcl_ref_dec(elem_a);
-      return 0;
-    }
-    
-    result = lcl_value_equal_deep(elem_a, elem_b, guard);
+    elem_a = list_elem(a, i, &held_a);
+    elem_b = list_elem(b, i, &held_b);
+
+    result = elem_a && elem_b &&
+             lcl_value_equal_deep(elem_a, elem_b, guard);
 
-    lcl_ref_dec(elem_a);
-    lcl_ref_dec(elem_b);
+    lcl_ref_dec(held_a);
+    lcl_ref_dec(held_b);
 
     if (!result) return 0;
   }
@@ -396,23 +399,16 @@ static int dict_equal_deep(lcl_value *a, lcl_value *b, eq_cycle_guard *guard) {
   hash_iter it = {0};
   const char *key;
   lcl_value *val_a, *val_b;
-  int result;
 
   if (lcl_dict_len(a) != lcl_dict_len(b)) return 0;
 
   /* Check all keys in a exist in b with equal values */
-  while (hash_table_iterate(a->as.dict.dictionary, &it, &key, &val_a)) {
-    if (lcl_dict_get(b, key, &val_b) != LCL_OK) {
-      lcl_ref_dec(val_a);
-      return 0;
-    }
-    
-    result = lcl_value_equal_deep(val_a, val_b, guard);
+  while (hash_table_next(a->as.dict.dictionary, &it, &key, &val_a)) {
+    hash_key k = hash_key_sym(key);
 
-    lcl_ref_dec(val_a);
-    lcl_ref_dec(val_b);
+    val_b = lcl_dict_peek_key(b, &k);
 
-    if (!result) return 0;
+    if (!val_b || !lcl_value_equal_deep(val_a, val_b, guard)) return 0;
   }
 
   return 1;
@@ -518,22 +514,24 @@ static int lcl_value_equal_deep(lcl_value *a, lcl_value *b, eq_cycle_guard *guar
 
 /* == : value equality */
 int c_eq(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
-  eq_cycle_guard guard = {{0}, {0}, 0};
+  eq_cycle_guard guard;
   (void)interp;
 
   if (argc != 2) return LCL_RC_ERR;
 
+  guard.depth = 0;  /* only entries below depth are read */
   *out = lcl_int_new(lcl_value_equal_deep(argv[0], argv[1], &guard) ? 1 : 0);
   return LCL_RC_OK;
 }
 
 /* != : value inequality */
 int c_ne(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
-  eq_cycle_guard guard = {{0}, {0}, 0};
+  eq_cycle_guard guard;
   (void)interp;
 
   if (argc != 2) return LCL_RC_ERR;
 
+  guard.depth = 0;  /* only entries below depth are read */
   *out = lcl_int_new(lcl_value_equal_deep(argv[0], argv[1], &guard) ? 0 : 1);
   return LCL_RC_OK;
 }
@@ -768,14 +766,14 @@ int s_var(lcl_interp *interp, int argc, const lcl_word **argv, lcl_value **out)
 
   lcl_ref_dec(name_v);
   lcl_ref_dec(init_v);
-  *out = lcl_string_new("");
+  *out = lcl_string_empty();
 
   return LCL_RC_OK;
 }
 
 int s_return(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
   if (argc == 0) {
-    *out = lcl_string_new("");
+    *out = lcl_string_empty();
 
     return LCL_RC_RETURN;
   }
@@ -796,7 +794,7 @@ int s_break(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out
     return LCL_RC_ERR;
   }
 
-  *out = lcl_string_new("");
+  *out = lcl_string_empty();
   return LCL_RC_BREAK;
 }
 
@@ -809,7 +807,7 @@ int s_continue(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **
     return LCL_RC_ERR;
   }
 
-  *out = lcl_string_new("");
+  *out = lcl_string_empty();
   return LCL_RC_CONTINUE;
 }
 
@@ -845,6 +843,140 @@ static int lcl_value_is_true(lcl_value *v) {
   return 1;
 }
 
+/* ============================================================================
+ * Fused conditions
+ *
+ * A condition that is a single comparison, such as [< $i $n] or the
+ * braced test {< $i $n}, is decided here straight to a C truth value:
+ * its arguments are evaluated as usual, but no result is boxed and
+ * nothing is dispatched.  The comparison's name is resolved through the
+ * command's call-site cache first, so a rebound < or == still runs
+ * whatever it is bound to now.
+ * ============================================================================ */
+
+/* The program of a word that is exactly [script], else NULL */
+static const lcl_program *word_script(const lcl_word *w) {
+  if (w->np == 1 && w->wp[0].kind == LCL_WP_SUBCMD) {
+    return w->wp[0].as.sub.program;
+  }
+
+  return NULL;
+}
+
+/* The comparison a condition's core builtin computes, or -1 */
+static int fused_op(lcl_interp *interp, const lcl_command *cmd) {
+  lcl_value *callee = NULL;
+  lcl_c_proc_fn fn = NULL;
+  int nargs = cmd->argc - 1;
+
+  if ((nargs != 1 && nargs != 2) || !lcl_word_is_name(&cmd->w[0])) {
+    return -1;
+  }
+
+  if (lcl_env_get_command_cached(&interp->env, cmd->w[0].wp[0].as.lit.s,
+                                 (lcl_call_cache *)&cmd->cache,
+                                 &callee) != LCL_OK) {
+    return -1;
+  }
+
+  if (callee->type == LCL_CPROC &&
+      callee->as.c_proc.fn->kind == LCL_CK_PROC) {
+    fn = callee->as.c_proc.fn->fn.proc;
+  }
+
+  lcl_ref_dec(callee);
+
+  if (nargs == 1) return fn == c_not ? CMP_NOT : -1;
+  if (fn == c_lt) return CMP_LT;
+  if (fn == c_lte) return CMP_LE;
+  if (fn == c_gt) return CMP_GT;
+  if (fn == c_gte) return CMP_GE;
+  if (fn == c_eq) return CMP_EQ;
+  if (fn == c_ne) return CMP_NE;
+
+  return -1;
+}
+
+/* An argument of a fused comparison.  A variable bound in a slot of a
+ * proc frame is read from it directly, as the VM would; layout names
+ * and variable names are both symbols, so they match by pointer. */
+static int cond_arg(lcl_interp *interp, const lcl_word *w, lcl_value **out) {
+  lcl_frame *f = interp->env.frame;
+
+  if (f->layout && w->np == 1 && w->wp[0].kind == LCL_WP_VAR) {
+    const char *name = w->wp[0].as.var.name;
+    int i;
+
+    for (i = 0; i < f->layout->nslots; i++) {
+      if (f->layout->names[i] == name) break;
+    }
+
+    if (i < f->layout->nslots && f->slots[i]) {
+      lcl_value *v = f->slots[i];
+
+      if (v->type == LCL_CELL) {
+        return lcl_cell_get(v, out) == LCL_OK ? LCL_RC_OK : LCL_RC_ERR;
+      }
+
+      *out = lcl_ref_inc(v);
+      return LCL_RC_OK;
+    }
+  }
+
+  return lcl_eval_word(interp, w, out);
+}
+
+/* Decide the condition program p if it is a lone comparison, possibly
+ * in brackets.  Returns 1 with *is_true set, 0 if p is something else,
+ * or -1 on error. */
+static int cond_fused(lcl_interp *interp, const lcl_program *p, int *is_true) {
+  const lcl_command *cmd;
+  const lcl_program *inner;
+  lcl_value *argv[2] = {NULL, NULL};
+  int op, i, ok = 1;
+
+  if (!p || p->ncmd != 1) return 0;
+
+  cmd = &p->cmd[0];
+
+  /* {[< $i $n]}: the bracket's value is a number, which a one-word
+   * command returns as it is */
+  if (cmd->argc == 1 && (inner = word_script(&cmd->w[0])) != NULL) {
+    return cond_fused(interp, inner, is_true);
+  }
+
+  op = fused_op(interp, cmd);
+  if (op < 0) return 0;
+
+  for (i = 1; i < cmd->argc && ok; i++) {
+    ok = cond_arg(interp, &cmd->w[i], &argv[i - 1]) == LCL_RC_OK;
+  }
+
+  if (ok) {
+    eq_cycle_guard guard;
+
+    switch (op) {
+    case CMP_NOT:
+      *is_true = !lcl_value_is_true(argv[0]);
+      break;
+    case CMP_EQ:
+    case CMP_NE:
+      guard.depth = 0;
+      *is_true = lcl_value_equal_deep(argv[0], argv[1], &guard) ==
+                 (op == CMP_EQ);
+      break;
+    default:
+      ok = compare_values(argv[0], argv[1], op, is_true) == LCL_OK;
+      break;
+    }
+  }
+
+  lcl_ref_dec(argv[0]);
+  lcl_ref_dec(argv[1]);
+
+  return ok ? 1 : -1;
+}
+
 /* if condition body ?elseif condition body ...? ?else body? */
 int s_if(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
   int i = 0;
@@ -855,9 +987,9 @@ int s_if(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
 
   while (i < argc) {
     lcl_value *cond_v = NULL;
-    lcl_value *body_v = NULL;
     lcl_program *body_p = NULL;
     int is_true;
+    int fused;
     int rc;
 
     /* Check for 'else' keyword (must be followed by body) */
@@ -879,19 +1011,14 @@ int s_if(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
         }
 
         /* Evaluate else body */
-        if (lcl_eval_word_to_str(interp, args[i + 1], &body_v) != LCL_RC_OK) {
-          return LCL_RC_ERR;
-        }
-
-        body_p = lcl_program_compile(lcl_value_to_string(body_v), "<if-else>");
-        lcl_ref_dec(body_v);
+        body_p = lcl_word_program(interp, args[i + 1], "<if-else>");
 
         if (!body_p) {
           return LCL_RC_ERR;
         }
 
         rc = lcl_eval_program(interp, body_p, out);
-        lcl_program_free(body_p);
+        lcl_program_ref_dec(body_p);
 
         return rc;
       }
@@ -910,28 +1037,31 @@ int s_if(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
     }
 
     /* Evaluate condition */
-    if (lcl_eval_word(interp, args[i], &cond_v) != LCL_RC_OK) {
+    fused = cond_fused(interp, word_script(args[i]), &is_true);
+
+    if (fused < 0) {
       return LCL_RC_ERR;
     }
 
-    is_true = lcl_value_is_true(cond_v);
-    lcl_ref_dec(cond_v);
-
-    if (is_true) {
-      /* Evaluate body */
-      if (lcl_eval_word_to_str(interp, args[i + 1], &body_v) != LCL_RC_OK) {
+    if (!fused) {
+      if (lcl_eval_word(interp, args[i], &cond_v) != LCL_RC_OK) {
         return LCL_RC_ERR;
       }
 
-      body_p = lcl_program_compile(lcl_value_to_string(body_v), "<if>");
-      lcl_ref_dec(body_v);
+      is_true = lcl_value_is_true(cond_v);
+      lcl_ref_dec(cond_v);
+    }
+
+    if (is_true) {
+      /* Evaluate body */
+      body_p = lcl_word_program(interp, args[i + 1], "<if>");
 
       if (!body_p) {
         return LCL_RC_ERR;
       }
 
       rc = lcl_eval_program(interp, body_p, out);
-      lcl_program_free(body_p);
+      lcl_program_ref_dec(body_p);
 
       return rc;
     }
@@ -941,13 +1071,12 @@ int s_if(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
   }
 
   /* No condition was true and no else clause */
-  *out = lcl_string_new("");
+  *out = lcl_string_empty();
   return LCL_RC_OK;
 }
 
 /* while test body - loop while test is true, re-evaluating test each iteration */
 int s_while(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
-  lcl_value *body_v = NULL;
   lcl_program *test_p = NULL;
   lcl_program *body_p = NULL;
   lcl_value *last = NULL;
@@ -962,14 +1091,7 @@ int s_while(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out
 
   /* If test is braced, compile it as a script to evaluate each iteration */
   if (test_is_braced) {
-    lcl_value *test_v = NULL;
-
-    if (lcl_eval_word_to_str(interp, args[0], &test_v) != LCL_RC_OK) {
-      return LCL_RC_ERR;
-    }
-
-    test_p = lcl_program_compile(lcl_value_to_string(test_v), "<while-test>");
-    lcl_ref_dec(test_v);
+    test_p = lcl_word_program(interp, args[0], "<while-test>");
 
     if (!test_p) {
       return LCL_RC_ERR;
@@ -977,17 +1099,10 @@ int s_while(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out
   }
 
   /* Compile body script */
-  if (lcl_eval_word_to_str(interp, args[1], &body_v) != LCL_RC_OK) {
-    if (test_p) lcl_program_free(test_p);
-
-    return LCL_RC_ERR;
-  }
-
-  body_p = lcl_program_compile(lcl_value_to_string(body_v), "<while-body>");
-  lcl_ref_dec(body_v);
+  body_p = lcl_word_program(interp, args[1], "<while-body>");
 
   if (!body_p) {
-    if (test_p) lcl_program_free(test_p);
+    lcl_program_ref_dec(test_p);
 
     return LCL_RC_ERR;
   }
@@ -996,32 +1111,47 @@ int s_while(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out
   for (;;) {
     lcl_value *cond_v = NULL;
     int is_true;
+    int fused;
 
-    /* Evaluate test each iteration */
-    if (test_is_braced) {
-      rc = lcl_eval_program(interp, test_p, &cond_v);
+    /* Evaluate test each iteration; a lone comparison needs no value */
+    fused = cond_fused(interp, test_is_braced ? test_p : word_script(args[0]),
+                       &is_true);
 
-      if (rc != LCL_RC_OK) {
-        lcl_program_free(test_p);
-        lcl_program_free(body_p);
+    if (fused < 0) {
+      lcl_program_ref_dec(test_p);
+      lcl_program_ref_dec(body_p);
 
-        if (last) lcl_ref_dec(last);
+      if (last) lcl_ref_dec(last);
 
-        return rc;
-      }
-    } else {
-      /* Non-braced: evaluate word directly (handles $var) */
-      if (lcl_eval_word(interp, args[0], &cond_v) != LCL_RC_OK) {
-        lcl_program_free(body_p);
+      return LCL_RC_ERR;
+    }
 
-        if (last) lcl_ref_dec(last);
+    if (!fused) {
+      if (test_is_braced) {
+        rc = lcl_eval_program(interp, test_p, &cond_v);
 
-        return LCL_RC_ERR;
+        if (rc != LCL_RC_OK) {
+          lcl_program_ref_dec(test_p);
+          lcl_program_ref_dec(body_p);
+
+          if (last) lcl_ref_dec(last);
+
+          return rc;
+        }
+      } else {
+        /* Non-braced: evaluate word directly (handles $var) */
+        if (lcl_eval_word(interp, args[0], &cond_v) != LCL_RC_OK) {
+          lcl_program_ref_dec(body_p);
+
+          if (last) lcl_ref_dec(last);
+
+          return LCL_RC_ERR;
+        }
       }
-    }
 
-    is_true = lcl_value_is_true(cond_v);
-    lcl_ref_dec(cond_v);
+      is_true = lcl_value_is_true(cond_v);
+      lcl_ref_dec(cond_v);
+    }
 
     if (!is_true) {
       break;
@@ -1044,9 +1174,9 @@ int s_while(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out
     }
 
     if (rc != LCL_RC_OK && rc != LCL_RC_RETURN) {
-      if (test_p) lcl_program_free(test_p);
+      lcl_program_ref_dec(test_p);
 
-      lcl_program_free(body_p);
+      lcl_program_ref_dec(body_p);
 
       if (last) lcl_ref_dec(last);
 
@@ -1054,29 +1184,26 @@ int s_while(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out
     }
 
     if (rc == LCL_RC_RETURN) {
-      if (test_p) lcl_program_free(test_p);
+      lcl_program_ref_dec(test_p);
 
-      lcl_program_free(body_p);
+      lcl_program_ref_dec(body_p);
       *out = last;
 
       return LCL_RC_RETURN;
     }
   }
 
-  if (test_p) lcl_program_free(test_p);
+  lcl_program_ref_dec(test_p);
 
-  lcl_program_free(body_p);
+  lcl_program_ref_dec(body_p);
 
-  *out = last ? last : lcl_string_new("");
+  *out = last ? last : lcl_string_empty();
 
   return LCL_RC_OK;
 }
 
 /* for start test next body - Tcl-style for loop */
 int s_for(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
-  lcl_value *start_v = NULL;
-  lcl_value *body_v = NULL;
-  lcl_value *next_v = NULL;
   lcl_program *start_p = NULL;
   lcl_program *test_p = NULL;
   lcl_program *body_p = NULL;
@@ -1093,12 +1220,7 @@ int s_for(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out)
   test_is_braced = args[1]->braced;
 
   /* Compile start script */
-  if (lcl_eval_word_to_str(interp, args[0], &start_v) != LCL_RC_OK) {
-    return LCL_RC_ERR;
-  }
-
-  start_p = lcl_program_compile(lcl_value_to_string(start_v), "<for-start>");
-  lcl_ref_dec(start_v);
+  start_p = lcl_word_program(interp, args[0], "<for-start>");
 
   if (!start_p) {
     return LCL_RC_ERR;
@@ -1106,77 +1228,49 @@ int s_for(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out)
 
   /* If test is braced, compile it as a script to evaluate each iteration */
   if (test_is_braced) {
-    lcl_value *test_v = NULL;
-
-    if (lcl_eval_word_to_str(interp, args[1], &test_v) != LCL_RC_OK) {
-      lcl_program_free(start_p);
-      return LCL_RC_ERR;
-    }
-
-    test_p = lcl_program_compile(lcl_value_to_string(test_v), "<for-test>");
-    lcl_ref_dec(test_v);
+    test_p = lcl_word_program(interp, args[1], "<for-test>");
 
     if (!test_p) {
-      lcl_program_free(start_p);
+      lcl_program_ref_dec(start_p);
       return LCL_RC_ERR;
     }
   }
 
   /* Compile next script (args[2]) */
-  if (lcl_eval_word_to_str(interp, args[2], &next_v) != LCL_RC_OK) {
-    lcl_program_free(start_p);
-
-    if (test_p) lcl_program_free(test_p);
-
-    return LCL_RC_ERR;
-  }
-
-  next_p = lcl_program_compile(lcl_value_to_string(next_v), "<for-next>");
-  lcl_ref_dec(next_v);
+  next_p = lcl_word_program(interp, args[2], "<for-next>");
 
   if (!next_p) {
-    lcl_program_free(start_p);
+    lcl_program_ref_dec(start_p);
 
-    if (test_p) lcl_program_free(test_p);
+    lcl_program_ref_dec(test_p);
 
     return LCL_RC_ERR;
   }
 
   /* Compile body script (args[3]) */
-  if (lcl_eval_word_to_str(interp, args[3], &body_v) != LCL_RC_OK) {
-    lcl_program_free(start_p);
-
-    if (test_p) lcl_program_free(test_p);
-
-    lcl_program_free(next_p);
-
-    return LCL_RC_ERR;
-  }
-
-  body_p = lcl_program_compile(lcl_value_to_string(body_v), "<for-body>");
-  lcl_ref_dec(body_v);
+  body_p = lcl_word_program(interp, args[3], "<for-body>");
 
   if (!body_p) {
-    lcl_program_free(start_p);
+    lcl_program_ref_dec(start_p);
 
-    if (test_p) lcl_program_free(test_p);
+    lcl_program_ref_dec(test_p);
 
-    lcl_program_free(next_p);
+    lcl_program_ref_dec(next_p);
 
     return LCL_RC_ERR;
   }
 
   /* Execute start script once */
   rc = lcl_eval_program(interp, start_p, &tmp);
-  lcl_program_free(start_p);
+  lcl_program_ref_dec(start_p);
 
   if (tmp) lcl_ref_dec(tmp);
 
   if (rc != LCL_RC_OK) {
-    if (test_p) lcl_program_free(test_p);
+    lcl_program_ref_dec(test_p);
 
-    lcl_program_free(body_p);
-    lcl_program_free(next_p);
+    lcl_program_ref_dec(body_p);
+    lcl_program_ref_dec(next_p);
 
     return rc;
   }
@@ -1185,34 +1279,50 @@ int s_for(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out)
   for (;;) {
     lcl_value *cond_v = NULL;
     int is_true;
+    int fused;
 
-    /* Evaluate test each iteration */
-    if (test_is_braced) {
-      rc = lcl_eval_program(interp, test_p, &cond_v);
+    /* Evaluate test each iteration; a lone comparison needs no value */
+    fused = cond_fused(interp, test_is_braced ? test_p : word_script(args[1]),
+                       &is_true);
 
-      if (rc != LCL_RC_OK) {
-        lcl_program_free(test_p);
-        lcl_program_free(body_p);
-        lcl_program_free(next_p);
+    if (fused < 0) {
+      lcl_program_ref_dec(test_p);
+      lcl_program_ref_dec(body_p);
+      lcl_program_ref_dec(next_p);
 
-        if (last) lcl_ref_dec(last);
+      if (last) lcl_ref_dec(last);
 
-        return rc;
-      }
-    } else {
-      /* Non-braced: evaluate word directly */
-      if (lcl_eval_word(interp, args[1], &cond_v) != LCL_RC_OK) {
-        lcl_program_free(body_p);
-        lcl_program_free(next_p);
+      return LCL_RC_ERR;
+    }
 
-        if (last) lcl_ref_dec(last);
+    if (!fused) {
+      if (test_is_braced) {
+        rc = lcl_eval_program(interp, test_p, &cond_v);
 
-        return LCL_RC_ERR;
+        if (rc != LCL_RC_OK) {
+          lcl_program_ref_dec(test_p);
+          lcl_program_ref_dec(body_p);
+          lcl_program_ref_dec(next_p);
+
+          if (last) lcl_ref_dec(last);
+
+          return rc;
+        }
+      } else {
+        /* Non-braced: evaluate word directly */
+        if (lcl_eval_word(interp, args[1], &cond_v) != LCL_RC_OK) {
+          lcl_program_ref_dec(body_p);
+          lcl_program_ref_dec(next_p);
+
+          if (last) lcl_ref_dec(last);
+
+          return LCL_RC_ERR;
+        }
       }
-    }
 
-    is_true = lcl_value_is_true(cond_v);
-    lcl_ref_dec(cond_v);
+      is_true = lcl_value_is_true(cond_v);
+      lcl_ref_dec(cond_v);
+    }
 
     if (!is_true) {
       break;
@@ -1238,10 +1348,10 @@ int s_for(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out)
       if (tmp) lcl_ref_dec(tmp);
 
       if (rc != LCL_RC_OK && rc != LCL_RC_CONTINUE) {
-        if (test_p) lcl_program_free(test_p);
+        lcl_program_ref_dec(test_p);
 
-        lcl_program_free(body_p);
-        lcl_program_free(next_p);
+        lcl_program_ref_dec(body_p);
+        lcl_program_ref_dec(next_p);
 
         if (last) lcl_ref_dec(last);
 
@@ -1252,10 +1362,10 @@ int s_for(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out)
     }
 
     if (rc != LCL_RC_OK && rc != LCL_RC_RETURN) {
-      if (test_p) lcl_program_free(test_p);
+      lcl_program_ref_dec(test_p);
 
-      lcl_program_free(body_p);
-      lcl_program_free(next_p);
+      lcl_program_ref_dec(body_p);
+      lcl_program_ref_dec(next_p);
 
       if (last) lcl_ref_dec(last);
 
@@ -1264,10 +1374,10 @@ int s_for(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out)
 
     if (rc == LCL_RC_RETURN) {
 
-      if (test_p) lcl_program_free(test_p);
+      lcl_program_ref_dec(test_p);
 
-      lcl_program_free(body_p);
-      lcl_program_free(next_p);
+      lcl_program_ref_dec(body_p);
+      lcl_program_ref_dec(next_p);
 
       *out = last;
 
@@ -1281,10 +1391,10 @@ int s_for(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out)
     if (tmp) lcl_ref_dec(tmp);
 
     if (rc != LCL_RC_OK) {
-      if (test_p) lcl_program_free(test_p);
+      lcl_program_ref_dec(test_p);
 
-      lcl_program_free(body_p);
-      lcl_program_free(next_p);
+      lcl_program_ref_dec(body_p);
+      lcl_program_ref_dec(next_p);
 
       if (last) lcl_ref_dec(last);
 
@@ -1292,21 +1402,148 @@ int s_for(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out)
     }
   }
 
-  if (test_p) lcl_program_free(test_p);
+  lcl_program_ref_dec(test_p);
 
-  lcl_program_free(body_p);
-  lcl_program_free(next_p);
+  lcl_program_ref_dec(body_p);
+  lcl_program_ref_dec(next_p);
 
-  *out = last ? last : lcl_string_new("");
+  *out = last ? last : lcl_string_empty();
 
   return LCL_RC_OK;
 }
 
+/* An integer argument of for-range; floats and non-numbers are errors */
+static int word_to_long(lcl_interp *interp, const lcl_word *w, long *out) {
+  lcl_value *v = NULL;
+  lcl_number n;
+  int ok;
+
+  if (lcl_eval_word(interp, w, &v) != LCL_RC_OK) {
+    return 0;
+  }
+
+  ok = lcl_value_to_number(v, &n) == LCL_OK && n.is_int;
+  lcl_ref_dec(v);
+
+  if (ok) *out = n.i;
+  return ok;
+}
+
+/* Bind the loop counter k to n in the current frame.  When the integer
+ * k is bound to there has no other holder, nothing else can see it
+ * change, so n is written into it in place rather than into a new box.
+ * The binding is read back each time, since the body may have rebound
+ * k or passed its value on. */
+static int range_counter(lcl_interp *interp, const hash_key *k, long n) {
+  lcl_value *v = NULL;
+  int alone;
+
+  if (n < LCL_SMALL_INT_MIN || n > LCL_SMALL_INT_MAX) {
+    if (lcl_frame_lookup_key(interp->env.frame, k, &v)) {
+      /* the lookup's reference, and the binding's as the only other */
+      alone = v->type == LCL_INT && v->refc == 2;
+      lcl_ref_dec(v);
+
+      if (alone) {
+        lcl_value_clear_string(v);
+        v->as.i = n;
+        return 1;
+      }
+    }
+  }
+
+  v = lcl_int_new(n);
+
+  return v && lcl_env_let_take(&interp->env, k->s, v) == LCL_OK;
+}
+
+/* for-range var start end ?step? body - run body with var bound to each
+ * integer from start up to (or, for a negative step, down to) end,
+ * excluding end.  The counter is a C long; var is a let binding, so the
+ * body sees a plain value and needs no cell. */
+int s_for_range(lcl_interp *interp, int argc, const lcl_word **args,
+                lcl_value **out) {
+  lcl_value *varname_v = NULL;
+  lcl_value *last = NULL;
+  lcl_program *body_p = NULL;
+  hash_key k;
+  long start, end, step = 1;
+  long i;
+  int rc = LCL_RC_OK;
+
+  if (argc != 4 && argc != 5) {
+    return LCL_RC_ERR;
+  }
+
+  if (!word_to_long(interp, args[1], &start) ||
+      !word_to_long(interp, args[2], &end) ||
+      (argc == 5 && !word_to_long(interp, args[3], &step)) || step == 0) {
+    return LCL_RC_ERR;
+  }
+
+  if (lcl_eval_word_to_str(interp, args[0], &varname_v) != LCL_RC_OK) {
+    return LCL_RC_ERR;
+  }
+
+  k = hash_key_make(lcl_value_to_string(varname_v));
+
+  body_p = lcl_word_program(interp, args[argc - 1], "<for-range>");
+
+  if (!body_p) {
+    lcl_ref_dec(varname_v);
+
+    return LCL_RC_ERR;
+  }
+
+  for (i = start; step > 0 ? i < end : i > end; i += step) {
+    if (!range_counter(interp, &k, i)) {
+      rc = LCL_RC_ERR;
+      break;
+    }
+
+    if (last) {
+      lcl_ref_dec(last);
+      last = NULL;
+    }
+
+    rc = lcl_eval_program(interp, body_p, &last);
+
+    if (rc == LCL_RC_CONTINUE) {
+      rc = LCL_RC_OK;
+    }
+
+    if (rc != LCL_RC_OK) {
+      break;
+    }
+
+    /* Stop at the last step that fits in a long */
+    if (step > 0 ? i > LONG_MAX - step : i < LONG_MIN - step) {
+      break;
+    }
+  }
+
+  lcl_ref_dec(varname_v);
+  lcl_program_ref_dec(body_p);
+
+  if (rc == LCL_RC_BREAK) {
+    rc = LCL_RC_OK;
+  }
+
+  if (rc == LCL_RC_OK) {
+    *out = last ? last : lcl_string_empty();
+  } else if (rc == LCL_RC_RETURN) {
+    *out = last;
+  } else if (last) {
+    lcl_ref_dec(last);
+  }
+
+  return rc;
+}
+
 /* foreach varname list body - iterate over list elements */
 int s_foreach(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
   lcl_value *varname_v = NULL;
   lcl_value *list_v = NULL;
-  lcl_value *body_v = NULL;
   lcl_program *body_p = NULL;
   lcl_value *last = NULL;
   const char *varname;
@@ -1346,15 +1583,7 @@ int s_foreach(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **o
   }
 
   /* Compile body script */
-  if (lcl_eval_word_to_str(interp, args[2], &body_v) != LCL_RC_OK) {
-    lcl_ref_dec(varname_v);
-    lcl_ref_dec(list_v);
-
-    return LCL_RC_ERR;
-  }
-
-  body_p = lcl_program_compile(lcl_value_to_string(body_v), "<foreach>");
-  lcl_ref_dec(body_v);
+  body_p = lcl_word_program(interp, args[2], "<foreach>");
 
   if (!body_p) {
     lcl_ref_dec(varname_v);
@@ -1367,12 +1596,13 @@ int s_foreach(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **o
 
   /* Iterate over list elements */
   for (i = 0; i < list_len; i++) {
-    lcl_value *elem = NULL;
+    lcl_value *held;
+    lcl_value *elem = list_elem(list_v, (size_t)i, &held);
 
-    if (lcl_list_get(list_v, (size_t)i, &elem) != LCL_OK) {
+    if (!elem) {
       lcl_ref_dec(varname_v);
       lcl_ref_dec(list_v);
-      lcl_program_free(body_p);
+      lcl_program_ref_dec(body_p);
 
       if (last) lcl_ref_dec(last);
 
@@ -1381,17 +1611,17 @@ int s_foreach(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **o
 
     /* Bind element to variable (using let - rebinds each iteration) */
     if (lcl_env_let(&interp->env, varname, elem) != LCL_OK) {
-      lcl_ref_dec(elem);
+      lcl_ref_dec(held);
       lcl_ref_dec(varname_v);
       lcl_ref_dec(list_v);
-      lcl_program_free(body_p);
+      lcl_program_ref_dec(body_p);
 
       if (last) lcl_ref_dec(last);
 
       return LCL_RC_ERR;
     }
 
-    lcl_ref_dec(elem);  /* env_let increments refcount */
+    lcl_ref_dec(held);  /* env_let increments refcount */
 
     /* Execute body */
     if (last) {
@@ -1412,7 +1642,7 @@ int s_foreach(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **o
     if (rc != LCL_RC_OK && rc != LCL_RC_RETURN) {
       lcl_ref_dec(varname_v);
       lcl_ref_dec(list_v);
-      lcl_program_free(body_p);
+      lcl_program_ref_dec(body_p);
 
       if (last) lcl_ref_dec(last);
 
@@ -1422,7 +1652,7 @@ int s_foreach(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **o
     if (rc == LCL_RC_RETURN) {
       lcl_ref_dec(varname_v);
       lcl_ref_dec(list_v);
-      lcl_program_free(body_p);
+      lcl_program_ref_dec(body_p);
 
       *out = last;
 
@@ -1432,9 +1662,9 @@ int s_foreach(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **o
 
   lcl_ref_dec(varname_v);
   lcl_ref_dec(list_v);
-  lcl_program_free(body_p);
+  lcl_program_ref_dec(body_p);
 
-  *out = last ? last : lcl_string_new("");
+  *out = last ? last : lcl_string_empty();
 
   return LCL_RC_OK;
 }
@@ -1464,7 +1694,7 @@ lcl_value *lcl_list_new_from_cwords(const char *words) {
 
     if (p > start) {
       size_t len = (size_t)(p - start);
-      char *word = (char *)malloc(len + 1);
+      char *word = (char *)lcl_malloc(len + 1);
       lcl_value *val;
 
       if (!word) {
@@ -1476,7 +1706,7 @@ lcl_value *lcl_list_new_from_cwords(const char *words) {
       memcpy(word, start, len);
       word[len] = '\0';
       val = lcl_value_new_string(word);
-      free(word);
+      lcl_free(word);
 
       if (!val) {
         lcl_ref_dec(list);
@@ -1500,7 +1730,6 @@ lcl_value *lcl_list_new_from_cwords(const char *words) {
 
 int s_lambda(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
   lcl_value *params_s = NULL;
-  lcl_value *body_s = NULL;
   lcl_program *body_p = NULL;
   lcl_value *params_list = NULL;
   lcl_upvalue *upvals = NULL;
@@ -1514,17 +1743,11 @@ int s_lambda(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **ou
     return LCL_RC_ERR;
   }
 
-  if (lcl_eval_word_to_str(interp, args[1], &body_s) != LCL_RC_OK) {
-    lcl_ref_dec(params_s);
-    return LCL_RC_ERR;
-  }
-
   /* TODO: proper Tcl list parser; MVP split on spaces */
   params_list = lcl_list_new_from_cwords(lcl_value_to_string(params_s));
   lcl_ref_dec(params_s);
 
-  body_p = lcl_program_compile(lcl_value_to_string(body_s), "<lambda>");
-  lcl_ref_dec(body_s);
+  body_p = lcl_word_program(interp, args[1], "<lambda>");
 
   if (!body_p) {
     lcl_ref_dec(params_list);
@@ -1536,7 +1759,7 @@ int s_lambda(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **ou
   upvals = lcl_build_upvalues(interp, body_p, params_list, &nupvals);
   /* upvals can be NULL if no captures needed - that's okay */
 
-  /* lcl_proc_new takes ownership of body_p and upvals */
+  /* lcl_proc_new takes ownership of the body_p reference and upvals */
   *out = lcl_proc_new(upvals, nupvals, params_list, body_p);
   lcl_ref_dec(params_list);
 
@@ -1572,7 +1795,7 @@ static int buf_append(char **buf, size_t *len, size_t *cap,
       newcap *= 2;
     }
 
-    newbuf = realloc(*buf, newcap);
+    newbuf = lcl_realloc(*buf, newcap);
     if (!newbuf) return 0;
 
     *buf = newbuf;
@@ -1679,6 +1902,8 @@ static lcl_value *resolve_or_create_ns_path(lcl_interp *interp, const char *path
         lcl_ref_dec(current);
         return NULL;
       }
+
+      interp->env.epoch++;
     }
 
     lcl_ref_dec(current);
@@ -1692,13 +1917,11 @@ static lcl_value *resolve_or_create_ns_path(lcl_interp *interp, const char *path
 int s_namespace_eval(lcl_interp *interp, int argc, const lcl_word **args,
                      lcl_value **out) {
   lcl_value *path_v = NULL;
-  lcl_value *body_v = NULL;
   lcl_value *ns = NULL;
   lcl_program *prog = NULL;
   lcl_frame *ns_frame = NULL;
   lcl_frame *old_frame = NULL;
   lcl_return_code rc;
-  int i;
   lcl_value *last = NULL;
 
   if (argc != 2) {
@@ -1718,15 +1941,8 @@ int s_namespace_eval(lcl_interp *interp, int argc, const lcl_word **args,
     return LCL_RC_ERR;
   }
 
-  /* Evaluate body string */
-  if (lcl_eval_word_to_str(interp, args[1], &body_v) != LCL_RC_OK) {
-    lcl_ref_dec(ns);
-    return LCL_RC_ERR;
-  }
-
   /* Compile body */
-  prog = lcl_program_compile(lcl_value_to_string(body_v), "<namespace eval>");
-  lcl_ref_dec(body_v);
+  prog = lcl_word_program(interp, args[1], "<namespace eval>");
 
   if (!prog) {
     lcl_ref_dec(ns);
@@ -1737,57 +1953,28 @@ int s_namespace_eval(lcl_interp *interp, int argc, const lcl_word **args,
   ns_frame = lcl_frame_new_ns(interp->env.frame, ns->as.namespace.namespace);
 
   if (!ns_frame) {
-    lcl_program_free(prog);
+    lcl_program_ref_dec(prog);
     lcl_ref_dec(ns);
     return LCL_RC_ERR;
   }
 
-  /* Push namespace frame */
+  /* Push namespace frame; its bindings may shadow cached commands */
   old_frame = interp->env.frame;
   interp->env.frame = ns_frame;
+  interp->env.epoch++;
 
   /* Evaluate body */
-  if (interp->max_depth && interp->depth >= interp->max_depth) {
-    interp->env.frame = old_frame;
-    lcl_frame_ref_dec(ns_frame);
-    lcl_program_free(prog);
-    lcl_ref_dec(ns);
-    return LCL_RC_ERR;
-  }
-
-  interp->depth++;
-  rc = LCL_RC_OK;
-
-  for (i = 0; i < prog->ncmd; i++) {
-    lcl_command *cmd = &prog->cmd[i];
-
-    if (last) {
-      lcl_ref_dec(last);
-      last = NULL;
-    }
-
-    rc = lcl_call_from_words(interp, cmd, &last);
-
-    if (rc != LCL_RC_OK) {
-      if (rc != LCL_RC_RETURN) {
-        interp->err_line = cmd->line;
-        interp->err_file = prog->file;
-      }
-
-      break;
-    }
-  }
-
-  interp->depth--;
+  rc = lcl_eval_program(interp, prog, &last);
 
   /* Pop namespace frame */
   interp->env.frame = old_frame;
+  interp->env.epoch++;
   lcl_frame_ref_dec(ns_frame);
-  lcl_program_free(prog);
+  lcl_program_ref_dec(prog);
   lcl_ref_dec(ns);
 
   if (rc == LCL_RC_OK || rc == LCL_RC_RETURN) {
-    *out = last ? last : lcl_string_new("");
+    *out = last ? last : lcl_string_empty();
   } else {
     if (last) lcl_ref_dec(last);
   }
@@ -1824,25 +2011,48 @@ int s_namespace(lcl_interp *interp, int argc, const lcl_word **args,
   return LCL_RC_ERR;
 }
 
-int s_subst(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
-  lcl_value *input_v = NULL;
-  const char *src;
-  size_t src_len;
-  size_t i;
-  char *result = NULL;
-  size_t result_len = 0;
-  size_t result_cap = 0;
+/* Append the pending literal text (if any) to w as one piece */
+static int subst_flush(lcl_arena *a, lcl_word *w, char **buf, size_t *len) {
+  int ok = 1;
 
-  if (argc != 1) {
-    return LCL_RC_ERR;
+  if (*len) {
+    ok = lcl_word_add_lit(a, w, *buf, *len);
+    *len = 0;
   }
 
-  if (lcl_eval_word_to_str(interp, args[0], &input_v) != LCL_RC_OK) {
-    return LCL_RC_ERR;
+  return ok;
+}
+
+/* Compile a subst template into a one-word program.  Backslash escapes
+ * are resolved here; $name, ${name} and [script] become var and
+ * subcommand pieces, so evaluating the word performs the substitution. */
+static lcl_program *subst_compile(const char *src) {
+  lcl_program *prog;
+  lcl_arena *a;
+  lcl_command cmd;
+  lcl_word empty;
+  lcl_word *w;
+  size_t src_len = strlen(src);
+  size_t i;
+  char *buf = NULL;
+  size_t len = 0;
+  size_t cap = 0;
+
+  memset(&cmd, 0, sizeof(cmd));
+  memset(&empty, 0, sizeof(empty));
+
+  prog = lcl_program_new("<subst>");
+  if (!prog) return NULL;
+
+  a = &prog->arena;
+
+  /* The command owns the word from the start so one free covers errors */
+  if (!lcl_command_push_word(a, &cmd, &empty)) {
+    lcl_program_free(prog);
+    return NULL;
   }
 
-  src = lcl_value_to_string(input_v);
-  src_len = strlen(src);
+  w = &cmd.w[0];
 
   for (i = 0; i < src_len; ) {
     char c = src[i];
@@ -1865,14 +2075,14 @@ int s_subst(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out
         case '"':  esc = '"';  break;
         default:
           /* Unknown escape - keep both chars */
-          if (!buf_append_char(&result, &result_len, &result_cap, '\\')) {
+          if (!buf_append_char(&buf, &len, &cap, '\\')) {
             goto err;
           }
           esc = next;
           break;
       }
 
-      if (!buf_append_char(&result, &result_len, &result_cap, esc)) {
+      if (!buf_append_char(&buf, &len, &cap, esc)) {
         goto err;
       }
 
@@ -1882,11 +2092,14 @@ int s_subst(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out
 
     /* Variable substitution */
     if (c == '$') {
+      size_t start;
+      size_t end;
+
       i++;
 
-      /* ${name} form */
       if (i < src_len && src[i] == '{') {
-        size_t start = ++i;
+        /* ${name} form */
+        start = ++i;
 
         while (i < src_len && src[i] != '}') {
           i++;
@@ -1897,110 +2110,38 @@ int s_subst(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out
           goto err;
         }
 
-        {
-          size_t name_len = i - start;
-          char *name = malloc(name_len + 1);
-          lcl_value *val = NULL;
-          const char *val_str;
-
-          if (!name) goto err;
-
-          memcpy(name, src + start, name_len);
-          name[name_len] = '\0';
-
-          if (lcl_env_get_value(&interp->env, name, &val) != LCL_OK) {
-            free(name);
-            goto err;
-          }
-
-          free(name);
-
-          /* Dereference cell if needed */
-          if (val->type == LCL_CELL) {
-            lcl_value *content = NULL;
-
-            if (lcl_cell_get(val, &content) != LCL_OK) {
-              lcl_ref_dec(val);
-              goto err;
-            }
-
-            lcl_ref_dec(val);
-            val = content;
-          }
-
-          val_str = lcl_value_to_string(val);
-
-          if (!buf_append(&result, &result_len, &result_cap,
-                          val_str, strlen(val_str))) {
-            lcl_ref_dec(val);
-            goto err;
-          }
-
-          lcl_ref_dec(val);
-        }
-
-        i++; /* skip closing } */
-        continue;
-      }
-
-      /* $name form */
-      if (i < src_len && is_name_start((unsigned char)src[i])) {
-        size_t start = i;
-
-        i++;
+        end = i++;
+      } else if (i < src_len && is_name_start((unsigned char)src[i])) {
+        /* $name form */
+        start = i++;
 
         while (i < src_len && is_name_char((unsigned char)src[i])) {
           i++;
         }
 
-        {
-          size_t name_len = i - start;
-          char *name = malloc(name_len + 1);
-          lcl_value *val = NULL;
-          const char *val_str;
-
-          if (!name) goto err;
-
-          memcpy(name, src + start, name_len);
-          name[name_len] = '\0';
-
-          if (lcl_env_get_value(&interp->env, name, &val) != LCL_OK) {
-            free(name);
-            goto err;
-          }
-
-          free(name);
-
-          /* Dereference cell if needed */
-          if (val->type == LCL_CELL) {
-            lcl_value *content = NULL;
+        end = i;
+      } else {
+        /* Bare $ - copy literally */
+        if (!buf_append_char(&buf, &len, &cap, '$')) {
+          goto err;
+        }
 
-            if (lcl_cell_get(val, &content) != LCL_OK) {
-              lcl_ref_dec(val);
-              goto err;
-            }
+        continue;
+      }
 
-            lcl_ref_dec(val);
-            val = content;
-          }
+      {
+        char *name = lcl_malloc(end - start + 1);
+        int ok;
 
-          val_str = lcl_value_to_string(val);
+        if (!name) goto err;
 
-          if (!buf_append(&result, &result_len, &result_cap,
-                          val_str, strlen(val_str))) {
-            lcl_ref_dec(val);
-            goto err;
-          }
+        memcpy(name, src + start, end - start);
+        name[end - start] = '\0';
 
-          lcl_ref_dec(val);
-        }
+        ok = subst_flush(a, w, &buf, &len) && lcl_word_add_var(a, w, name);
+        lcl_free(name);
 
-        continue;
-      }
-
-      /* Bare $ - copy literally */
-      if (!buf_append_char(&result, &result_len, &result_cap, '$')) {
-        goto err;
+        if (!ok) goto err;
       }
 
       continue;
@@ -2033,102 +2174,145 @@ int s_subst(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out
 
       {
         size_t subcmd_len = i - start;
-        char *subcmd_src = malloc(subcmd_len + 1);
-        lcl_program *prog;
-        lcl_value *subcmd_result = NULL;
-        int rc;
-        const char *result_str;
+        char *subcmd_src = lcl_malloc(subcmd_len + 1);
+        lcl_program *sub;
 
         if (!subcmd_src) goto err;
 
         memcpy(subcmd_src, src + start, subcmd_len);
         subcmd_src[subcmd_len] = '\0';
 
-        prog = lcl_program_compile(subcmd_src, "<subst>");
-        free(subcmd_src);
+        sub = lcl_program_compile(subcmd_src, "<subst>");
+        lcl_free(subcmd_src);
 
-        if (!prog) goto err;
+        if (!sub) goto err;
 
-        /* Evaluate in current frame (like eval) */
-        if (interp->max_depth && interp->depth >= interp->max_depth) {
-          lcl_program_free(prog);
+        if (!subst_flush(a, w, &buf, &len) || !lcl_word_add_sub(a, w, sub)) {
+          lcl_program_ref_dec(sub);
           goto err;
         }
+      }
 
-        interp->depth++;
+      i++; /* skip closing ] */
+      continue;
+    }
 
-        rc = LCL_RC_OK;
+    /* Regular character - copy as-is */
+    if (!buf_append_char(&buf, &len, &cap, c)) {
+      goto err;
+    }
 
-        {
-          int j;
+    i++;
+  }
 
-          for (j = 0; j < prog->ncmd; j++) {
-            lcl_command *cmd = &prog->cmd[j];
+  if (!subst_flush(a, w, &buf, &len)) goto err;
 
-            if (subcmd_result) {
-              lcl_ref_dec(subcmd_result);
-              subcmd_result = NULL;
-            }
+  lcl_free(buf);
+  buf = NULL;
 
-            rc = lcl_call_from_words(interp, cmd, &subcmd_result);
+  if (!lcl_program_push_command(prog, &cmd)) goto err;
 
-            if (rc != LCL_RC_OK) {
-              if (rc != LCL_RC_RETURN) {
-                interp->err_line = cmd->line;
-                interp->err_file = prog->file;
-              }
+  return prog;
 
-              break;
-            }
-          }
-        }
+err:
+  lcl_free(buf);
+  lcl_command_free(&cmd);
+  lcl_program_free(prog);
 
-        interp->depth--;
-        lcl_program_free(prog);
+  return NULL;
+}
 
-        if (rc != LCL_RC_OK) {
-          if (subcmd_result) lcl_ref_dec(subcmd_result);
-          goto err;
-        }
+int s_subst(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
+  lcl_value *input_v = NULL;
+  const char *src;
+  lcl_program *prog;
+  int rc;
 
-        result_str = subcmd_result ? lcl_value_to_string(subcmd_result) : "";
+  if (argc != 1) {
+    return LCL_RC_ERR;
+  }
 
-        if (!buf_append(&result, &result_len, &result_cap,
-                        result_str, strlen(result_str))) {
-          if (subcmd_result) lcl_ref_dec(subcmd_result);
-          goto err;
-        }
+  if (lcl_eval_word_to_str(interp, args[0], &input_v) != LCL_RC_OK) {
+    return LCL_RC_ERR;
+  }
 
-        if (subcmd_result) lcl_ref_dec(subcmd_result);
-      }
+  src = lcl_value_to_string(input_v);
+  prog = lcl_cache_get(&interp->cache, src, "<subst>");
 
-      i++; /* skip closing ] */
-      continue;
-    }
+  if (!prog) {
+    prog = subst_compile(src);
 
-    /* Regular character - copy as-is */
-    if (!buf_append_char(&result, &result_len, &result_cap, c)) {
-      goto err;
+    if (prog) {
+      lcl_cache_put(&interp->cache, src, "<subst>", prog);
     }
-
-    i++;
   }
 
   lcl_ref_dec(input_v);
-  *out = lcl_value_new_string(result ? result : "");
-  free(result);
 
-  return *out ? LCL_RC_OK : LCL_RC_ERR;
+  if (!prog) {
+    return LCL_RC_ERR;
+  }
+
+  /* Evaluate in current frame (like eval) */
+  rc = lcl_eval_word_to_str(interp, &prog->cmd[0].w[0], out);
+  lcl_program_ref_dec(prog);
+
+  return rc == LCL_RC_OK ? LCL_RC_OK : LCL_RC_ERR;
+}
+
+/* The words' strings joined with spaces, in a malloc'd buffer */
+static char *join_words(lcl_interp *interp, int argc, const lcl_word **args) {
+  size_t total_len = 0;
+  size_t l;
+  lcl_value **parts = NULL;
+  char *joined = NULL;
+  char *p;
+  int i;
+
+  if (argc < 1) return NULL;
+
+  parts = lcl_malloc(sizeof(lcl_value *) * (size_t)argc);
+  if (!parts) return NULL;
+
+  for (i = 0; i < argc; i++) {
+    if (lcl_eval_word_to_str(interp, args[i], &parts[i]) != LCL_RC_OK) {
+      int j;
+      for (j = 0; j < i; j++) lcl_ref_dec(parts[j]);
+      lcl_free(parts);
+      return NULL;
+    }
+    lcl_value_to_string_n(parts[i], &l);
+    total_len += l;
+  }
+
+  /* Add space separators */
+  total_len += (size_t)(argc - 1);
+
+  joined = lcl_malloc(total_len + 1);
+  if (!joined) {
+    for (i = 0; i < argc; i++) lcl_ref_dec(parts[i]);
+    lcl_free(parts);
+    return NULL;
+  }
+
+  p = joined;
+  for (i = 0; i < argc; i++) {
+    const char *s = lcl_value_to_string_n(parts[i], &l);
+    memcpy(p, s, l);
+    p += l;
+    if (i + 1 < argc) {
+      *p++ = ' ';
+    }
+  }
+  *p = '\0';
 
-err:
-  lcl_ref_dec(input_v);
-  free(result);
+  for (i = 0; i < argc; i++) lcl_ref_dec(parts[i]);
+  lcl_free(parts);
 
-  return LCL_RC_ERR;
+  return joined;
 }
 
 int s_eval(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
-  int i;
   lcl_program *prog = NULL;
   lcl_return_code rc = LCL_RC_OK;
   lcl_value *last = NULL;
@@ -2141,59 +2325,24 @@ int s_eval(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out)
   if (argc == 1) {
     lcl_value *script_v = NULL;
 
-    if (lcl_eval_word_to_str(interp, args[0], &script_v) != LCL_RC_OK) {
-      return LCL_RC_ERR;
-    }
-
-    prog = lcl_program_compile(lcl_value_to_string(script_v), "<eval>");
-    lcl_ref_dec(script_v);
-  } else {
-    /* Join multiple args with spaces */
-    size_t total_len = 0;
-    lcl_value **parts = NULL;
-    char *script_str = NULL;
-    char *p;
-
-    parts = malloc(sizeof(lcl_value *) * (size_t)argc);
-    if (!parts) return LCL_RC_ERR;
-
-    for (i = 0; i < argc; i++) {
-      if (lcl_eval_word_to_str(interp, args[i], &parts[i]) != LCL_RC_OK) {
-        int j;
-        for (j = 0; j < i; j++) lcl_ref_dec(parts[j]);
-        free(parts);
+    if (args[0]->braced) {
+      prog = lcl_word_program(interp, args[0], "<eval>");
+    } else {
+      if (lcl_eval_word_to_str(interp, args[0], &script_v) != LCL_RC_OK) {
         return LCL_RC_ERR;
       }
-      total_len += strlen(lcl_value_to_string(parts[i]));
-    }
-
-    /* Add space separators */
-    total_len += (size_t)(argc - 1);
-
-    script_str = malloc(total_len + 1);
-    if (!script_str) {
-      for (i = 0; i < argc; i++) lcl_ref_dec(parts[i]);
-      free(parts);
-      return LCL_RC_ERR;
-    }
 
-    p = script_str;
-    for (i = 0; i < argc; i++) {
-      const char *s = lcl_value_to_string(parts[i]);
-      size_t l = strlen(s);
-      memcpy(p, s, l);
-      p += l;
-      if (i + 1 < argc) {
-        *p++ = ' ';
-      }
+      prog = lcl_cache_compile(&interp->cache, lcl_value_to_string(script_v),
+                               "<eval>");
+      lcl_ref_dec(script_v);
     }
-    *p = '\0';
+  } else {
+    char *script_str = join_words(interp, argc, args);
 
-    for (i = 0; i < argc; i++) lcl_ref_dec(parts[i]);
-    free(parts);
+    if (!script_str) return LCL_RC_ERR;
 
-    prog = lcl_program_compile(script_str, "<eval>");
-    free(script_str);
+    prog = lcl_cache_compile(&interp->cache, script_str, "<eval>");
+    lcl_free(script_str);
   }
 
   if (!prog) {
@@ -2201,37 +2350,11 @@ int s_eval(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out)
   }
 
   /* Evaluate program in current frame, propagating RETURN (not absorbing it) */
-  if (interp->max_depth && interp->depth >= interp->max_depth) {
-    lcl_program_free(prog);
-    return LCL_RC_ERR;
-  }
-
-  interp->depth++;
-
-  for (i = 0; i < prog->ncmd; i++) {
-    lcl_command *cmd = &prog->cmd[i];
-
-    if (last) {
-      lcl_ref_dec(last);
-      last = NULL;
-    }
-
-    rc = lcl_call_from_words(interp, cmd, &last);
-
-    if (rc != LCL_RC_OK) {
-      if (rc != LCL_RC_RETURN) {
-        interp->err_line = cmd->line;
-        interp->err_file = prog->file;
-      }
-      break;
-    }
-  }
-
-  interp->depth--;
-  lcl_program_free(prog);
+  rc = lcl_eval_program(interp, prog, &last);
+  lcl_program_ref_dec(prog);
 
   if (rc == LCL_RC_OK || rc == LCL_RC_RETURN) {
-    *out = last ? last : lcl_string_new("");
+    *out = last ? last : lcl_string_empty();
   } else {
     if (last) lcl_ref_dec(last);
   }
@@ -2239,63 +2362,46 @@ int s_eval(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out)
   return rc;
 }
 
-/* Read entire file into a malloc'd string */
-static char *read_file(const char *path, size_t *out_len) {
-  FILE *f;
-  long len;
-  char *buf;
-  size_t nread;
-
-  f = fopen(path, "rb");
-  if (!f) return NULL;
-
-  if (fseek(f, 0, SEEK_END) != 0) {
-    fclose(f);
-    return NULL;
-  }
+/* expr {infix} - a braced expression is compiled once and kept on the
+ * word; other arguments are joined with spaces and compiled each time */
+int s_expr(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
+  const lcl_expr *cached;
+  lcl_expr *e;
+  char *src;
+  int rc;
 
-  len = ftell(f);
-  if (len < 0) {
-    fclose(f);
-    return NULL;
+  if (argc < 1) {
+    return LCL_RC_ERR;
   }
 
-  if (fseek(f, 0, SEEK_SET) != 0) {
-    fclose(f);
-    return NULL;
+  if (argc == 1 && (cached = lcl_word_expr(args[0])) != NULL) {
+    return lcl_expr_eval(interp, cached, out);
   }
 
-  buf = malloc((size_t)len + 1);
-  if (!buf) {
-    fclose(f);
-    return NULL;
+  src = join_words(interp, argc, args);
+  if (!src) {
+    return LCL_RC_ERR;
   }
 
-  nread = fread(buf, 1, (size_t)len, f);
-  fclose(f);
+  e = lcl_expr_compile(src);
+  lcl_free(src);
 
-  if ((long)nread != len) {
-    free(buf);
-    return NULL;
+  if (!e) {
+    return LCL_RC_ERR;
   }
 
-  buf[len] = '\0';
-
-  if (out_len) {
-    *out_len = (size_t)len;
-  }
+  rc = lcl_expr_eval(interp, e, out);
+  lcl_expr_free(e);
 
-  return buf;
+  return rc;
 }
 
 int s_load(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out) {
   lcl_value *path_v = NULL;
   const char *path;
-  char *src = NULL;
   lcl_program *prog = NULL;
   lcl_return_code rc = LCL_RC_OK;
   lcl_value *last = NULL;
-  int i;
 
   if (argc != 1) {
     return LCL_RC_ERR;
@@ -2308,16 +2414,8 @@ int s_load(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out)
 
   path = lcl_value_to_string(path_v);
 
-  /* Read file contents */
-  src = read_file(path, NULL);
-  if (!src) {
-    lcl_ref_dec(path_v);
-    return LCL_RC_ERR;
-  }
-
-  /* Compile the file */
-  prog = lcl_program_compile(src, path);
-  free(src);
+  /* Compile the file, or load its precompiled image */
+  prog = lcl_image_load(path, path);
 
   if (!prog) {
     lcl_ref_dec(path_v);
@@ -2327,38 +2425,11 @@ int s_load(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out)
   lcl_ref_dec(path_v);
 
   /* Evaluate in current frame (like eval) */
-  if (interp->max_depth && interp->depth >= interp->max_depth) {
-    lcl_program_free(prog);
-    return LCL_RC_ERR;
-  }
-
-  interp->depth++;
-
-  for (i = 0; i < prog->ncmd; i++) {
-    lcl_command *cmd = &prog->cmd[i];
-
-    if (last) {
-      lcl_ref_dec(last);
-      last = NULL;
-    }
-
-    rc = lcl_call_from_words(interp, cmd, &last);
-
-    if (rc != LCL_RC_OK) {
-      if (rc != LCL_RC_RETURN) {
-        interp->err_line = cmd->line;
-        interp->err_file = prog->file;
-      }
-
-      break;
-    }
-  }
-
-  interp->depth--;
-  lcl_program_free(prog);
+  rc = lcl_eval_program(interp, prog, &last);
+  lcl_program_ref_dec(prog);
 
   if (rc == LCL_RC_OK || rc == LCL_RC_RETURN) {
-    *out = last ? last : lcl_string_new("");
+    *out = last ? last : lcl_string_empty();
   } else {
     if (last) lcl_ref_dec(last);
   }
@@ -2397,7 +2468,7 @@ int s_thread_first(lcl_interp *interp, int argc, const lcl_word **args,
   int rc;
 
   if (argc < 1) {
-    *out = lcl_string_new("");
+    *out = lcl_string_empty();
     return LCL_RC_OK;
   }
 
@@ -2438,7 +2509,7 @@ int s_thread_first(lcl_interp *interp, int argc, const lcl_word **args,
 
       /* Build: [callable $_thread_ rest] */
       total = 1 + cmd_len + 11 + strlen(rest) + 2;
-      threaded = (char *)malloc(total);
+      threaded = (char *)lcl_malloc(total);
       if (!threaded) {
         lcl_ref_dec(form_v);
         lcl_ref_dec(current);
@@ -2465,7 +2536,7 @@ int s_thread_first(lcl_interp *interp, int argc, const lcl_word **args,
 
       /* Build: [$var $_thread_ rest] */
       total = 1 + cmd_len + 11 + strlen(rest) + 2;
-      threaded = (char *)malloc(total);
+      threaded = (char *)lcl_malloc(total);
 
       if (!threaded) {
         lcl_ref_dec(form_v);
@@ -2494,7 +2565,7 @@ int s_thread_first(lcl_interp *interp, int argc, const lcl_word **args,
 
       /* Build: cmd $_thread_ rest */
       total = cmd_len + 12 + strlen(rest) + 1;
-      threaded = (char *)malloc(total);
+      threaded = (char *)lcl_malloc(total);
 
       if (!threaded) {
         lcl_ref_dec(form_v);
@@ -2515,7 +2586,7 @@ int s_thread_first(lcl_interp *interp, int argc, const lcl_word **args,
 
     /* Evaluate the threaded command */
     rc = lcl_eval_string(interp, threaded, &result);
-    free(threaded);
+    lcl_free(threaded);
 
     if (rc != LCL_RC_OK) {
       lcl_ref_dec(current);
@@ -2546,7 +2617,7 @@ int s_thread_last(lcl_interp *interp, int argc, const lcl_word **args,
   int rc;
 
   if (argc < 1) {
-    *out = lcl_string_new("");
+    *out = lcl_string_empty();
     return LCL_RC_OK;
   }
 
@@ -2580,7 +2651,7 @@ int s_thread_last(lcl_interp *interp, int argc, const lcl_word **args,
     if (form[0] == '[' || form[0] == '$') {
       /* Build: [form $_thread_] */
       total = 1 + strlen(form) + 11 + 1;
-      threaded = (char *)malloc(total);
+      threaded = (char *)lcl_malloc(total);
 
       if (!threaded) {
         lcl_ref_dec(form_v);
@@ -2592,7 +2663,7 @@ int s_thread_last(lcl_interp *interp, int argc, const lcl_word **args,
     } else {
       /* Normal command: "form $_thread_" (append at end) */
       total = strlen(form) + 11 + 1;  /* 11 = " $_thread_" */
-      threaded = (char *)malloc(total);
+      threaded = (char *)lcl_malloc(total);
 
       if (!threaded) {
         lcl_ref_dec(form_v);
@@ -2608,7 +2679,7 @@ int s_thread_last(lcl_interp *interp, int argc, const lcl_word **args,
 
     /* Evaluate the threaded command */
     rc = lcl_eval_string(interp, threaded, &result);
-    free(threaded);
+    lcl_free(threaded);
 
     if (rc != LCL_RC_OK) {
       lcl_ref_dec(current);
@@ -2660,7 +2731,7 @@ int s_proc(lcl_interp *interp, int argc, const lcl_word **args, lcl_value **out)
   /* lam now has refcount 2 (original + hash table), decref to balance */
   lcl_ref_dec(name_v);
   lcl_ref_dec(lam);
-  *out = lcl_string_new("");
+  *out = lcl_string_empty();
 
   return LCL_RC_OK;
 }
@@ -2719,7 +2790,7 @@ int c_lindex(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
         return LCL_RC_OK;
       }
       /* Out of bounds - return empty string (Tcl behavior) */
-      *out = lcl_string_new("");
+      *out = lcl_string_empty();
 
       return LCL_RC_OK;
     }
@@ -2730,14 +2801,14 @@ int c_lindex(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
 
     /* Handle negative index or end-based index */
     if (idx < 0) {
-      *out = lcl_string_new("");
+      *out = lcl_string_empty();
 
       return LCL_RC_OK;
     }
 
     if (lcl_list_get(list, (size_t)idx, out) != LCL_OK) {
       /* Out of bounds - return empty string (Tcl behavior) */
-      *out = lcl_string_new("");
+      *out = lcl_string_empty();
     }
 
     return LCL_RC_OK;
@@ -2764,7 +2835,7 @@ int c_lindex(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
         }
 
         lcl_ref_dec(current);
-        *out = lcl_string_new("");
+        *out = lcl_string_empty();
 
         return LCL_RC_OK;
       }
@@ -2777,7 +2848,7 @@ int c_lindex(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
 
       if (idx < 0 || lcl_list_get(current, (size_t)idx, &next) != LCL_OK) {
         lcl_ref_dec(current);
-        *out = lcl_string_new("");
+        *out = lcl_string_empty();
 
         return LCL_RC_OK;
       }
@@ -2943,37 +3014,37 @@ int c_join(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
   len = lcl_list_len(list);
 
   for (i = 0; i < len; i++) {
-    lcl_value *elem = NULL;
+    lcl_value *held;
+    lcl_value *elem = list_elem(list, i, &held);
     const char *elem_str;
     size_t elem_len;
 
-    if (lcl_list_get(list, i, &elem) != LCL_OK) continue;
+    if (!elem) continue;
 
-    elem_str = lcl_value_to_string(elem);
-    elem_len = strlen(elem_str);
+    elem_str = lcl_value_to_string_n(elem, &elem_len);
 
     /* Add separator if not first element */
     if (i > 0 && sep_len > 0) {
       if (!buf_append(&buf, &buf_len, &buf_cap, sep, sep_len)) {
-        lcl_ref_dec(elem);
-        free(buf);
+        lcl_ref_dec(held);
+        lcl_free(buf);
 
         return LCL_RC_ERR;
       }
     }
 
     if (!buf_append(&buf, &buf_len, &buf_cap, elem_str, elem_len)) {
-      lcl_ref_dec(elem);
-      free(buf);
+      lcl_ref_dec(held);
+      lcl_free(buf);
 
       return LCL_RC_ERR;
     }
 
-    lcl_ref_dec(elem);
+    lcl_ref_dec(held);
   }
 
   *out = lcl_string_new(buf ? buf : "");
-  free(buf);
+  lcl_free(buf);
 
   return *out ? LCL_RC_OK : LCL_RC_ERR;
 }
@@ -3002,8 +3073,7 @@ int c_split(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
     const char *p = str;
 
     while (*p) {
-      char c[2] = { *p, '\0' };
-      lcl_value *elem = lcl_string_new(c);
+      lcl_value *elem = lcl_string_new_n(p, 1);
 
       if (!elem || lcl_list_push(&result, elem) != LCL_OK) {
         if (elem) lcl_ref_dec(elem);
@@ -3023,19 +3093,7 @@ int c_split(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
     while (*p) {
       if (strchr(split_chars, *p)) {
         /* Found a split character */
-        size_t len = (size_t)(p - start);
-        char *word = (char *)malloc(len + 1);
-        lcl_value *elem;
-
-        if (!word) {
-          lcl_ref_dec(result);
-          return LCL_RC_ERR;
-        }
-
-        memcpy(word, start, len);
-        word[len] = '\0';
-        elem = lcl_string_new(word);
-        free(word);
+        lcl_value *elem = lcl_string_new_n(start, (size_t)(p - start));
 
         if (!elem || lcl_list_push(&result, elem) != LCL_OK) {
           if (elem) lcl_ref_dec(elem);
@@ -3090,7 +3148,7 @@ int c_len(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
       return LCL_RC_OK;
 
     case LCL_STRING:
-      *out = lcl_int_new((long)strlen(lcl_value_to_string(argv[0])));
+      *out = lcl_int_new((long)argv[0]->as.str.len);
       return LCL_RC_OK;
 
     default:
@@ -3116,7 +3174,7 @@ int c_empty(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
       return LCL_RC_OK;
 
     case LCL_STRING:
-      *out = lcl_int_new(strlen(lcl_value_to_string(argv[0])) == 0 ? 1 : 0);
+      *out = lcl_int_new(argv[0]->as.str.len == 0 ? 1 : 0);
       return LCL_RC_OK;
 
     default:
@@ -3153,8 +3211,8 @@ int c_generic_get(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **ou
     }
 
     case LCL_DICT: {
-      const char *key = lcl_value_to_string(argv[1]);
-      if (lcl_dict_get(argv[0], key, out) != LCL_OK) {
+      hash_key key = lcl_value_key(argv[1]);
+      if (lcl_dict_get_key(argv[0], &key, out) != LCL_OK) {
         if (argc == 3) {
           *out = lcl_ref_inc(argv[2]);
           
@@ -3170,14 +3228,15 @@ int c_generic_get(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **ou
     case LCL_STRING: {
       long idx;
       const char *str;
-      char buf[2];
+      size_t len;
+
       if (lcl_value_to_int(argv[1], &idx) != LCL_OK) {
         return LCL_RC_ERR;
       }
 
-      str = lcl_value_to_string(argv[0]);
+      str = lcl_value_to_string_n(argv[0], &len);
 
-      if (idx < 0 || (size_t)idx >= strlen(str)) {
+      if (idx < 0 || (size_t)idx >= len) {
         if (argc == 3) {
           *out = lcl_ref_inc(argv[2]);
 
@@ -3187,10 +3246,7 @@ int c_generic_get(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **ou
         return LCL_RC_ERR;
       }
       
-      buf[0] = str[idx];
-      buf[1] = '\0';
-
-      *out = lcl_string_new(buf);
+      *out = lcl_string_new_n(str + idx, 1);
 
       return LCL_RC_OK;
     }
@@ -3295,15 +3351,9 @@ int c_has(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
     }
       
     case LCL_DICT: {
-      const char *key = lcl_value_to_string(argv[1]);
-      lcl_value *val;
+      hash_key key = lcl_value_key(argv[1]);
 
-      if (lcl_dict_get(argv[0], key, &val) == LCL_OK) {
-        lcl_ref_dec(val);
-        *out = lcl_int_new(1);
-      } else {
-        *out = lcl_int_new(0);
-      }
+      *out = lcl_int_new(lcl_dict_peek_key(argv[0], &key) != NULL);
 
       return LCL_RC_OK;
     }
@@ -3649,18 +3699,20 @@ int c_list_map(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out)
   result = lcl_list_new();
 
   for (i = 0; i < len; i++) {
-    lcl_value *elem = NULL;
+    lcl_value *held;
+    lcl_value *elem = list_elem(list, i, &held);
     lcl_value *mapped = NULL;
     lcl_value *call_args[1];
 
-    if (lcl_list_get(list, i, &elem) != LCL_OK) {
+    if (!elem) {
       lcl_ref_dec(result);
       return LCL_RC_ERR;
     }
 
+    /* elem is borrowed; argv keeps the list alive across the call */
     call_args[0] = elem;
     rc = lcl_call_proc(interp, func, 1, call_args, &mapped);
-    lcl_ref_dec(elem);
+    lcl_ref_dec(held);
 
     if (rc != LCL_RC_OK) {
       lcl_ref_dec(result);
@@ -3699,11 +3751,12 @@ int c_list_filter(lcl_interp *interp, int argc, lcl_value **argv,
   result = lcl_list_new();
 
   for (i = 0; i < len; i++) {
-    lcl_value *elem = NULL;
+    lcl_value *held;
+    lcl_value *elem = list_elem(list, i, &held);
     lcl_value *pred_result = NULL;
     lcl_value *call_args[1];
 
-    if (lcl_list_get(list, i, &elem) != LCL_OK) {
+    if (!elem) {
       lcl_ref_dec(result);
       return LCL_RC_ERR;
     }
@@ -3712,7 +3765,7 @@ int c_list_filter(lcl_interp *interp, int argc, lcl_value **argv,
     rc = lcl_call_proc(interp, func, 1, call_args, &pred_result);
 
     if (rc != LCL_RC_OK) {
-      lcl_ref_dec(elem);
+      lcl_ref_dec(held);
       lcl_ref_dec(result);
       return rc;
     }
@@ -3720,14 +3773,14 @@ int c_list_filter(lcl_interp *interp, int argc, lcl_value **argv,
     if (lcl_value_is_true(pred_result)) {
       if (lcl_list_push(&result, elem) != LCL_OK) {
         lcl_ref_dec(pred_result);
-        lcl_ref_dec(elem);
+        lcl_ref_dec(held);
         lcl_ref_dec(result);
         return LCL_RC_ERR;
       }
     }
 
     lcl_ref_dec(pred_result);
-    lcl_ref_dec(elem);
+    lcl_ref_dec(held);
   }
 
   *out = result;
@@ -3754,11 +3807,12 @@ int c_list_reduce(lcl_interp *interp, int argc, lcl_value **argv,
   acc = lcl_ref_inc(init);
 
   for (i = 0; i < len; i++) {
-    lcl_value *elem = NULL;
+    lcl_value *held;
+    lcl_value *elem = list_elem(list, i, &held);
     lcl_value *new_acc = NULL;
     lcl_value *call_args[2];
 
-    if (lcl_list_get(list, i, &elem) != LCL_OK) {
+    if (!elem) {
       lcl_ref_dec(acc);
       return LCL_RC_ERR;
     }
@@ -3766,7 +3820,7 @@ int c_list_reduce(lcl_interp *interp, int argc, lcl_value **argv,
     call_args[0] = acc;
     call_args[1] = elem;
     rc = lcl_call_proc(interp, func, 2, call_args, &new_acc);
-    lcl_ref_dec(elem);
+    lcl_ref_dec(held);
 
     if (rc != LCL_RC_OK) {
       lcl_ref_dec(acc);
@@ -3781,6 +3835,339 @@ int c_list_reduce(lcl_interp *interp, int argc, lcl_value **argv,
   return LCL_RC_OK;
 }
 
+/* ============================================================================
+ * Numeric list kernels (List::sum, ::dot, ...)
+ *
+ * These read a list as one array of numbers: a packed list's own array,
+ * or a copy for a list of values that all read as numbers.  Integers stay
+ * integers, falling back to double on overflow as + and * do; doubles go
+ * through the vector kernels in lcl-vec.c.
+ * ============================================================================ */
+
+typedef struct {
+  size_t n;
+  const long *ints;      /* set if every element is an integer */
+  const double *floats;  /* set otherwise */
+  void *owned;           /* array made for this view, if any */
+} num_view;
+
+static void num_view_free(num_view *v) {
+  lcl_free(v->owned);
+  v->owned = NULL;
+}
+
+/* Returns 0 if list is not a list of numbers */
+static int num_view_init(lcl_value *list, num_view *v) {
+  long *ints = NULL;
+  double *floats = NULL;
+  size_t i;
+
+  memset(v, 0, sizeof(*v));
+
+  if (list->type != LCL_LIST) return 0;
+
+  v->n = lcl_list_len(list);
+
+  switch (list->as.list.kind) {
+  case LCL_LIST_INTS:
+    v->ints = list->as.list.ints;
+    return 1;
+  case LCL_LIST_FLOATS:
+    v->floats = list->as.list.floats;
+    return 1;
+  default:
+    break;
+  }
+
+  ints = (long *)lcl_malloc((v->n ? v->n : 1) * sizeof(*ints));
+  if (!ints) return 0;
+
+  for (i = 0; i < v->n; i++) {
+    lcl_value *elem = list->as.list.items[i];
+    lcl_number num;
+
+    if (lcl_value_to_number(elem, &num) != LCL_OK) {
+      lcl_free(ints);
+      lcl_free(floats);
+      return 0;
+    }
+
+    if (!floats && num.is_int) {
+      ints[i] = num.i;
+      continue;
+    }
+
+    /* First non-integer: switch to doubles, converting what came before */
+    if (!floats) {
+      size_t j;
+
+      floats = (double *)lcl_malloc(v->n * sizeof(*floats));
+      if (!floats) {
+        lcl_free(ints);
+        return 0;
+      }
+
+      for (j = 0; j < i; j++) floats[j] = (double)ints[j];
+    }
+
+    floats[i] = num.is_int ? (double)num.i : num.f;
+  }
+
+  if (floats) {
+    lcl_free(ints);
+    v->floats = floats;
+    v->owned = floats;
+  } else {
+    v->ints = ints;
+    v->owned = ints;
+  }
+
+  return 1;
+}
+
+/* The view as doubles, converting integers if need be */
+static const double *num_view_doubles(num_view *v) {
+  double *floats;
+  size_t i;
+
+  if (v->floats) return v->floats;
+
+  floats = (double *)lcl_malloc((v->n ? v->n : 1) * sizeof(*floats));
+  if (!floats) return NULL;
+
+  for (i = 0; i < v->n; i++) floats[i] = (double)v->ints[i];
+
+  lcl_free(v->owned);
+  v->owned = floats;
+  v->floats = floats;
+  v->ints = NULL;
+
+  return floats;
+}
+
+enum { NUM_SUM, NUM_MIN, NUM_MAX, NUM_MEAN };
+
+static int list_fold(int argc, lcl_value **argv, lcl_value **out, int op) {
+  num_view v;
+  const double *x;
+  double r = 0.0;
+
+  if (argc != 1 || !num_view_init(argv[0], &v)) return LCL_RC_ERR;
+
+  if (v.n == 0 && op != NUM_SUM) {
+    num_view_free(&v);
+    return LCL_RC_ERR;
+  }
+
+  if (v.ints && op != NUM_MEAN) {
+    long acc = v.ints[0];
+    size_t i;
+
+    if (op == NUM_SUM) {
+      for (acc = 0, i = 0; i < v.n; i++) {
+        long b = v.ints[i];
+
+        if ((b > 0 && acc > LONG_MAX - b) || (b < 0 && acc < LONG_MIN - b)) {
+          break;
+        }
+
+        acc += b;
+      }
+    } else {
+      for (i = 1; i < v.n; i++) {
+        if (op == NUM_MIN ? v.ints[i] < acc : v.ints[i] > acc) acc = v.ints[i];
+      }
+    }
+
+    if (i == v.n) {
+      num_view_free(&v);
+      *out = lcl_int_new(acc);
+      return *out ? LCL_RC_OK : LCL_RC_ERR;
+    }
+  }
+
+  x = num_view_doubles(&v);
+  if (!x) {
+    num_view_free(&v);
+    return LCL_RC_ERR;
+  }
+
+  switch (op) {
+  case NUM_SUM:  r = lcl_vec_sum(x, v.n); break;
+  case NUM_MIN:  r = lcl_vec_min(x, v.n); break;
+  case NUM_MAX:  r = lcl_vec_max(x, v.n); break;
+  case NUM_MEAN: r = lcl_vec_sum(x, v.n) / (double)v.n; break;
+  }
+
+  num_view_free(&v);
+  *out = lcl_float_new(r);
+  return *out ? LCL_RC_OK : LCL_RC_ERR;
+}
+
+/* List::sum list */
+int c_list_sum(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
+  (void)interp;
+  return list_fold(argc, argv, out, NUM_SUM);
+}
+
+/* List::min list */
+int c_list_min(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
+  (void)interp;
+  return list_fold(argc, argv, out, NUM_MIN);
+}
+
+/* List::max list */
+int c_list_max(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
+  (void)interp;
+  return list_fold(argc, argv, out, NUM_MAX);
+}
+
+/* List::mean list - always a float */
+int c_list_mean(lcl_interp *interp, int argc, lcl_value **argv,
+                lcl_value **out) {
+  (void)interp;
+  return list_fold(argc, argv, out, NUM_MEAN);
+}
+
+/* Views of two lists of numbers of the same length */
+static int num_view_pair(int argc, lcl_value **argv, num_view *a,
+                         num_view *b) {
+  if (argc != 2 || !num_view_init(argv[0], a)) return 0;
+
+  if (!num_view_init(argv[1], b)) {
+    num_view_free(a);
+    return 0;
+  }
+
+  if (a->n != b->n) {
+    num_view_free(a);
+    num_view_free(b);
+    return 0;
+  }
+
+  return 1;
+}
+
+/* List::dot a b */
+int c_list_dot(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
+  num_view a, b;
+  const double *x, *y;
+  size_t i;
+  (void)interp;
+
+  if (!num_view_pair(argc, argv, &a, &b)) return LCL_RC_ERR;
+
+  if (a.ints && b.ints) {
+    lcl_number acc, t, u;
+
+    acc.is_int = 1;
+    acc.i = 0;
+    t.is_int = u.is_int = 1;
+
+    for (i = 0; i < a.n && acc.is_int; i++) {
+      t.i = a.ints[i];
+      u.i = b.ints[i];
+      lcl_number_mul(&t, &u);
+      lcl_number_add(&acc, &t);
+
+      if (!t.is_int) acc.is_int = 0;
+      t.is_int = 1;
+    }
+
+    if (acc.is_int) {
+      num_view_free(&a);
+      num_view_free(&b);
+      *out = lcl_int_new(acc.i);
+      return *out ? LCL_RC_OK : LCL_RC_ERR;
+    }
+  }
+
+  x = num_view_doubles(&a);
+  y = num_view_doubles(&b);
+
+  if (x && y) *out = lcl_float_new(lcl_vec_dot(x, y, a.n));
+
+  num_view_free(&a);
+  num_view_free(&b);
+
+  return x && y && *out ? LCL_RC_OK : LCL_RC_ERR;
+}
+
+/* Elementwise a op b, as a packed list */
+static int list_zip(int argc, lcl_value **argv, lcl_value **out, int mul) {
+  num_view a, b;
+  const double *x, *y;
+  double *r;
+  size_t i;
+
+  if (!num_view_pair(argc, argv, &a, &b)) return LCL_RC_ERR;
+
+  if (a.ints && b.ints) {
+    long *ri = (long *)lcl_malloc((a.n ? a.n : 1) * sizeof(*ri));
+    lcl_number t, u;
+
+    if (!ri) goto fail;
+
+    for (i = 0; i < a.n; i++) {
+      t.is_int = u.is_int = 1;
+      t.i = a.ints[i];
+      u.i = b.ints[i];
+
+      if (mul) lcl_number_mul(&t, &u);
+      else lcl_number_add(&t, &u);
+
+      if (!t.is_int) break;
+      ri[i] = t.i;
+    }
+
+    if (i == a.n) {
+      num_view_free(&a);
+      num_view_free(&b);
+      *out = lcl_list_adopt_ints(ri, a.n);
+      if (!*out) lcl_free(ri);
+      return *out ? LCL_RC_OK : LCL_RC_ERR;
+    }
+
+    lcl_free(ri);
+  }
+
+  x = num_view_doubles(&a);
+  y = num_view_doubles(&b);
+  r = (double *)lcl_malloc((a.n ? a.n : 1) * sizeof(*r));
+
+  if (!x || !y || !r) {
+    lcl_free(r);
+    goto fail;
+  }
+
+  if (mul) lcl_vec_mul(r, x, y, a.n);
+  else lcl_vec_add(r, x, y, a.n);
+
+  num_view_free(&a);
+  num_view_free(&b);
+
+  *out = lcl_list_adopt_floats(r, a.n);
+  if (!*out) lcl_free(r);
+  return *out ? LCL_RC_OK : LCL_RC_ERR;
+
+fail:
+  num_view_free(&a);
+  num_view_free(&b);
+  return LCL_RC_ERR;
+}
+
+/* List::add a b - elementwise sum */
+int c_list_add(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
+  (void)interp;
+  return list_zip(argc, argv, out, 0);
+}
+
+/* List::mul a b - elementwise product */
+int c_list_mul(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out) {
+  (void)interp;
+  return list_zip(argc, argv, out, 1);
+}
+
 /* ============================================================================
  * Namespaced Dict Operations
  * ============================================================================ */
@@ -3802,11 +4189,10 @@ int c_dict_keys(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out)
   }
 
   result = lcl_list_new();
-  while (hash_table_iterate(argv[0]->as.dict.dictionary, &it, &key, &val)) {
+  while (hash_table_next(argv[0]->as.dict.dictionary, &it, &key, &val)) {
     lcl_value *key_v = lcl_string_new(key);
     lcl_list_push(&result, key_v);
     lcl_ref_dec(key_v);
-    lcl_ref_dec(val);
   }
 
   *out = result;
@@ -3832,9 +4218,8 @@ int c_dict_values(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **ou
 
   result = lcl_list_new();
 
-  while (hash_table_iterate(argv[0]->as.dict.dictionary, &it, &key, &val)) {
+  while (hash_table_next(argv[0]->as.dict.dictionary, &it, &key, &val)) {
     lcl_list_push(&result, val);
-    lcl_ref_dec(val);
   }
 
   *out = result;
@@ -3860,14 +4245,13 @@ int c_dict_items(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out
 
   result = lcl_list_new();
 
-  while (hash_table_iterate(argv[0]->as.dict.dictionary, &it, &key, &val)) {
+  while (hash_table_next(argv[0]->as.dict.dictionary, &it, &key, &val)) {
     lcl_value *pair = lcl_list_new();
     lcl_value *key_v = lcl_string_new(key);
     lcl_list_push(&pair, key_v);
     lcl_list_push(&pair, val);
     lcl_list_push(&result, pair);
     lcl_ref_dec(key_v);
-    lcl_ref_dec(val);
     lcl_ref_dec(pair);
   }
 
@@ -3921,9 +4305,8 @@ int c_dict_merge(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out
 
   result = lcl_ref_inc(argv[0]);
 
-  while (hash_table_iterate(argv[1]->as.dict.dictionary, &it, &key, &val)) {
+  while (hash_table_next(argv[1]->as.dict.dictionary, &it, &key, &val)) {
     lcl_dict_put(&result, key, val);
-    lcl_ref_dec(val);
   }
 
   *out = result;
@@ -3950,16 +4333,16 @@ int c_dict_map(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **out)
 
   result = lcl_dict_new();
 
-  while (hash_table_iterate(dict->as.dict.dictionary, &it, &key, &val)) {
+  while (hash_table_next(dict->as.dict.dictionary, &it, &key, &val)) {
     lcl_value *mapped = NULL;
     lcl_value *key_v = lcl_string_new(key);
     lcl_value *call_args[2];
 
     call_args[0] = key_v;
     call_args[1] = val;
+    /* val is borrowed; argv keeps the dict alive across the call */
     rc = lcl_call_proc(interp, func, 2, call_args, &mapped);
     lcl_ref_dec(key_v);
-    lcl_ref_dec(val);
 
     if (rc != LCL_RC_OK) {
       lcl_ref_dec(result);
@@ -3993,7 +4376,7 @@ int c_dict_filter(lcl_interp *interp, int argc, lcl_value **argv,
 
   result = lcl_dict_new();
 
-  while (hash_table_iterate(dict->as.dict.dictionary, &it, &key, &val)) {
+  while (hash_table_next(dict->as.dict.dictionary, &it, &key, &val)) {
     lcl_value *pred_result = NULL;
     lcl_value *key_v = lcl_string_new(key);
     lcl_value *call_args[2];
@@ -4004,7 +4387,6 @@ int c_dict_filter(lcl_interp *interp, int argc, lcl_value **argv,
 
     if (rc != LCL_RC_OK) {
       lcl_ref_dec(key_v);
-      lcl_ref_dec(val);
       lcl_ref_dec(result);
       return rc;
     }
@@ -4015,7 +4397,6 @@ int c_dict_filter(lcl_interp *interp, int argc, lcl_value **argv,
 
     lcl_ref_dec(pred_result);
     lcl_ref_dec(key_v);
-    lcl_ref_dec(val);
   }
 
   *out = result;
@@ -4042,7 +4423,7 @@ int c_dict_reduce(lcl_interp *interp, int argc, lcl_value **argv,
 
   acc = lcl_ref_inc(init);
 
-  while (hash_table_iterate(dict->as.dict.dictionary, &it, &key, &val)) {
+  while (hash_table_next(dict->as.dict.dictionary, &it, &key, &val)) {
     lcl_value *new_acc = NULL;
     lcl_value *key_v = lcl_string_new(key);
     lcl_value *call_args[3];
@@ -4052,7 +4433,6 @@ int c_dict_reduce(lcl_interp *interp, int argc, lcl_value **argv,
     call_args[2] = val;
     rc = lcl_call_proc(interp, func, 3, call_args, &new_acc);
     lcl_ref_dec(key_v);
-    lcl_ref_dec(val);
 
     if (rc != LCL_RC_OK) {
       lcl_ref_dec(acc);
@@ -4084,7 +4464,7 @@ int c_string_upper(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **o
 
   src = lcl_value_to_string(argv[0]);
   len = strlen(src);
-  result = malloc(len + 1);
+  result = lcl_malloc(len + 1);
 
   if (!result) return LCL_RC_ERR;
 
@@ -4101,7 +4481,7 @@ int c_string_upper(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **o
   result[len] = '\0';
 
   *out = lcl_string_new(result);
-  free(result);
+  lcl_free(result);
 
   return LCL_RC_OK;
 }
@@ -4119,7 +4499,7 @@ int c_string_lower(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **o
 
   src = lcl_value_to_string(argv[0]);
   len = strlen(src);
-  result = malloc(len + 1);
+  result = lcl_malloc(len + 1);
 
   if (!result) return LCL_RC_ERR;
 
@@ -4136,7 +4516,7 @@ int c_string_lower(lcl_interp *interp, int argc, lcl_value **argv, lcl_value **o
   result[len] = '\0';
 
   *out = lcl_string_new(result);
-  free(result);
+  lcl_free(result);
 
   return LCL_RC_OK;
 }
@@ -4212,7 +4592,7 @@ int c_string_replace(lcl_interp *interp, int argc, lcl_value **argv, lcl_value *
   }
 
   result_len = strlen(src) + (size_t)count * (new_len - old_len);
-  result = malloc(result_len + 1);
+  result = lcl_malloc(result_len + 1);
 
   if (!result) return LCL_RC_ERR;
 
@@ -4231,12 +4611,12 @@ int c_string_replace(lcl_interp *interp, int argc, lcl_value **argv, lcl_value *
   strcpy(dst, p);
 
   *out = lcl_string_new(result);
-  free(result);
+  lcl_free(result);
 
   return LCL_RC_OK;
 }
 
-void lcl_register_core(lcl_interp *interp) {
+static void register_core(lcl_interp *interp) {
   lcl_value *list_ns;
   lcl_value *dict_ns;
   lcl_value *string_ns;
@@ -4297,6 +4677,7 @@ void lcl_register_core(lcl_interp *interp) {
   lcl_register_spec(interp, "lambda",    s_lambda);
   lcl_register_spec(interp, "proc",      s_proc);
   lcl_register_spec(interp, "eval",      s_eval);
+  lcl_register_spec(interp, "expr",      s_expr);
   lcl_register_spec(interp, "load",      s_load);
   lcl_register_spec(interp, "subst",     s_subst);
   lcl_register_spec(interp, "namespace", s_namespace);
@@ -4307,6 +4688,7 @@ void lcl_register_core(lcl_interp *interp) {
   lcl_register_spec(interp, "if",       s_if);
   lcl_register_spec(interp, "while",    s_while);
   lcl_register_spec(interp, "for",      s_for);
+  lcl_register_spec(interp, "for-range", s_for_range);
   lcl_register_spec(interp, "foreach",  s_foreach);
   lcl_register_spec(interp, "break",    s_break);
   lcl_register_spec(interp, "continue", s_continue);
@@ -4332,6 +4714,13 @@ void lcl_register_core(lcl_interp *interp) {
   lcl_ns_def(list_ns, "map",     lcl_c_proc_new("List::map", c_list_map));
   lcl_ns_def(list_ns, "filter",  lcl_c_proc_new("List::filter", c_list_filter));
   lcl_ns_def(list_ns, "reduce",  lcl_c_proc_new("List::reduce", c_list_reduce));
+  lcl_ns_def(list_ns, "sum",     lcl_c_proc_new("List::sum", c_list_sum));
+  lcl_ns_def(list_ns, "min",     lcl_c_proc_new("List::min", c_list_min));
+  lcl_ns_def(list_ns, "max",     lcl_c_proc_new("List::max", c_list_max));
+  lcl_ns_def(list_ns, "mean",    lcl_c_proc_new("List::mean", c_list_mean));
+  lcl_ns_def(list_ns, "dot",     lcl_c_proc_new("List::dot", c_list_dot));
+  lcl_ns_def(list_ns, "add",     lcl_c_proc_new("List::add", c_list_add));
+  lcl_ns_def(list_ns, "mul",     lcl_c_proc_new("List::mul", c_list_mul));
 
   /* ========================================================================
    * Dict:: namespace
@@ -4361,3 +4750,12 @@ void lcl_register_core(lcl_interp *interp) {
   lcl_ns_def(string_ns, "split",   lcl_c_proc_new("String::split", c_split));
   lcl_ns_def(string_ns, "join",    lcl_c_proc_new("String::join", c_join));
 }
+
+/* The namespaces are built here rather than through lcl_define, so they
+ * need the interpreter entered too */
+void lcl_register_core(lcl_interp *interp) {
+  lcl_interp *prev = lcl_interp_enter(interp);
+
+  register_core(interp);
+  lcl_interp_leave(prev);
+}
@@ -1,6 +1,7 @@
 #include <memory.h>
 #include <string.h>
 
+#include "lcl-alloc.h"
 #include "lcl-str.h"
 
 void lcl_str_init(lcl_str *str) {
@@ -11,10 +12,10 @@ void lcl_str_init(lcl_str *str) {
 
 void lcl_str_free(lcl_str *str) {
   if (str->buf) {
-    free(str->buf);
+    lcl_free(str->buf);
   }
 
-  free(str);
+  lcl_free(str);
 }
 
 int lcl_str_reserve(lcl_str *st, size_t need) {
@@ -34,7 +35,7 @@ int lcl_str_reserve(lcl_str *st, size_t need) {
     cap = next;
   }
 
-  p = (char *)realloc(st->buf, cap);
+  p = (char *)lcl_realloc(st->buf, cap);
 
   if (!p) return 0;
 
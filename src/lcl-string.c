@@ -1,55 +1,131 @@
+#include <float.h>
 #include <memory.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "lcl-alloc.h"
+#include "lcl-sym.h"
+#include "lcl-thread.h"
 #include "lcl-values.h"
 
+/* The one empty string, shared like the small integers (lcl-num.c).
+ * Its hash and number flags are set up front, so nothing that reads it
+ * ever caches into it. */
+static char empty_repr[1];
+static lcl_value empty_string;
+static lcl_once_flag empty_once = LCL_ONCE_INIT;
+
+static void empty_init(void) {
+  empty_string.type = LCL_STRING;
+  empty_string.refc = LCL_REFC_IMMORTAL;
+  empty_string.str_repr = empty_repr;
+  empty_string.as.str.len = 0;
+  empty_string.as.str.hash = hash_table_hash_n(empty_repr, 0);
+  empty_string.as.str.num = LCL_STR_NOT_INT | LCL_STR_NOT_FLOAT;
+}
+
+lcl_value *lcl_string_empty(void) {
+  lcl_once(&empty_once, empty_init);
+
+  return &empty_string;
+}
+
 lcl_value *lcl_string_new(const char *str) {
-  lcl_value *v = (lcl_value *)calloc(1, sizeof(*v));
+  return lcl_string_new_n(str, str ? strlen(str) : 0);
+}
+
+/* Short strings are copied into the value; longer ones get a buffer */
+lcl_value *lcl_string_new_n(const char *str, size_t n) {
+  lcl_value *v;
+
+  if (n == 0) return lcl_string_empty();
+
+  v = lcl_value_alloc();
 
   if (!v) return NULL;
 
-  if (str) {
-    size_t n = strlen(str);
-    v->str_repr = (char *)malloc(n + 1);
+  if (n <= LCL_SSO_MAX) {
+    v->str_repr = v->as.str.sso;
+  } else {
+    v->str_repr = (char *)lcl_malloc(n + 1);
 
     if (!v->str_repr) {
-      free(v);
+      lcl_value_free(v);
       return NULL;
     }
-
-    memcpy(v->str_repr, str, n + 1);
   }
 
+  memcpy(v->str_repr, str, n);
+  v->str_repr[n] = '\0';
+
   v->refc = 1;
   v->type = LCL_STRING;
+  v->as.str.len = n;
 
   return v;
 }
 
-static void lcl_reify_str_int(lcl_value *value) {
-  char buf[32];
-  /** TODO replace sprintf? **/
-  int m = sprintf(buf, "%ld", value->as.i);
-  value->str_repr = (char *)malloc((size_t)m + 1);
+/* Decimal digits of n, written backwards from end; returns the start */
+static char *format_long(char *end, long n) {
+  unsigned long u = n < 0 ? 0UL - (unsigned long)n : (unsigned long)n;
 
-  if (!value->str_repr) {
-    return;
+  *--end = '\0';
+
+  do {
+    *--end = (char)('0' + u % 10);
+    u /= 10;
+  } while (u);
+
+  if (n < 0) *--end = '-';
+
+  return end;
+}
+
+/* The shortest %g form that reads back as f.  A normal double's 15-digit
+ * form is the rounding of its shortest form, so most values take one
+ * try; the rest need 16 or 17 digits.  Subnormals carry fewer digits,
+ * so their search starts at 1. */
+static int format_double(char *buf, double f) {
+  int prec = f != 0.0 && f < DBL_MIN && f > -DBL_MIN ? 1 : 15;
+  int m = 0;
+
+  for (; prec <= 17; prec++) {
+    m = sprintf(buf, "%.*g", prec, f);
+
+    if (strtod(buf, NULL) == f) break;
   }
 
-  memcpy(value->str_repr, buf, (size_t)m + 1);
+  return m;
 }
 
-static void lcl_reify_str_float(lcl_value *value) {
-  char buf[32];
-  int m = sprintf(buf, "%.17g", value->as.f);
-  value->str_repr = (char *)malloc((size_t)m + 1);
+/* The n bytes at s, plus a NUL, as value's string.  An int or float
+ * only uses the front of the union, so its text fits behind that. */
+static void reify_number(lcl_value *value, const char *s, size_t n) {
+  if (n <= LCL_SSO_MAX) {
+    value->str_repr = value->as.str.sso;
+  } else {
+    value->str_repr = (char *)lcl_malloc(n + 1);
 
-  if (!value->str_repr) {
-    return;
+    if (!value->str_repr) {
+      return;
+    }
   }
 
-  memcpy(value->str_repr, buf, (size_t)m + 1);
+  memcpy(value->str_repr, s, n + 1);
+}
+
+static void lcl_reify_str_int(lcl_value *value) {
+  char buf[32];
+  char *s = format_long(buf + sizeof(buf), value->as.i);
+
+  reify_number(value, s, (size_t)(buf + sizeof(buf) - s) - 1);
+}
+
+static void lcl_reify_str_float(lcl_value *value) {
+  char buf[32];
+  int m = format_double(buf, value->as.f);
+
+  reify_number(value, buf, (size_t)m);
 }
 
 /* Check if string needs bracing for Tcl-like list output */
@@ -65,47 +141,92 @@ static int needs_braces(const char *s) {
   return 0;
 }
 
+/* String of element i of a packed list, in buf; returns its length */
+static size_t format_packed(const lcl_value *list, size_t i, char *buf,
+                            const char **out) {
+  if (list->as.list.kind == LCL_LIST_INTS) {
+    *out = format_long(buf + 32, list->as.list.ints[i]);
+    return (size_t)(buf + 32 - *out) - 1;
+  }
+
+  *out = buf;
+  return (size_t)format_double(buf, list->as.list.floats[i]);
+}
+
+/* Numbers never need braces, and are formatted straight from the array
+ * instead of being boxed first */
+static void lcl_reify_str_packed(lcl_value *value) {
+  size_t len = lcl_list_len(value);
+  size_t total = len;
+  size_t i;
+  char num[32];
+  const char *s;
+  char *buf, *p;
+
+  for (i = 0; i < len; i++) {
+    total += format_packed(value, i, num, &s);
+  }
+
+  buf = (char *)lcl_malloc(total + 1);
+  if (!buf) return;
+
+  p = buf;
+  for (i = 0; i < len; i++) {
+    size_t n = format_packed(value, i, num, &s);
+
+    if (i > 0) *p++ = ' ';
+    memcpy(p, s, n);
+    p += n;
+  }
+  *p = '\0';
+
+  value->str_repr = buf;
+}
+
 static void lcl_reify_str_list(lcl_value *value) {
   size_t len = lcl_list_len(value);
   size_t total = 0;
   size_t i;
   char *buf, *p;
 
+  if (value->as.list.kind != LCL_LIST_VALUES) {
+    lcl_reify_str_packed(value);
+    return;
+  }
+
   /* Calculate total size needed */
   for (i = 0; i < len; i++) {
-    lcl_value *elem = NULL;
+    lcl_value *elem = lcl_list_peek(value, i);
     const char *s;
-    if (lcl_list_get(value, i, &elem) != LCL_OK) continue;
-    s = lcl_value_to_string(elem);
-    total += strlen(s);
+    size_t slen;
+
+    if (!elem) continue;
+    s = lcl_value_to_string_n(elem, &slen);
+    total += slen;
     if (needs_braces(s)) total += 2;  /* for {} */
-    lcl_ref_dec(elem);
   }
   total += len;  /* for spaces */
 
-  buf = (char *)malloc(total + 1);
+  buf = (char *)lcl_malloc(total + 1);
   if (!buf) return;
 
   p = buf;
   for (i = 0; i < len; i++) {
-    lcl_value *elem = NULL;
+    lcl_value *elem = lcl_list_peek(value, i);
     const char *s;
     size_t slen;
     int braced;
 
     if (i > 0) *p++ = ' ';
 
-    if (lcl_list_get(value, i, &elem) != LCL_OK) continue;
-    s = lcl_value_to_string(elem);
-    slen = strlen(s);
+    if (!elem) continue;
+    s = lcl_value_to_string_n(elem, &slen);
     braced = needs_braces(s);
 
     if (braced) *p++ = '{';
     memcpy(p, s, slen);
     p += slen;
     if (braced) *p++ = '}';
-
-    lcl_ref_dec(elem);
   }
   *p = '\0';
 
@@ -121,23 +242,24 @@ static void lcl_reify_str_dict(lcl_value *value) {
   int first = 1;
 
   /* First pass: calculate size */
-  while (lcl_dict_iter((const lcl_value **)&value, &it, &key, &val) == LCL_OK) {
-    const char *vs = lcl_value_to_string(val);
-    total += strlen(key) + strlen(vs) + 2;  /* key, value, spaces */
+  while (lcl_dict_next(value, &it, &key, &val) == LCL_OK) {
+    size_t vlen;
+    const char *vs = lcl_value_to_string_n(val, &vlen);
+
+    total += lcl_sym_len(key) + vlen + 2;  /* key, value, spaces */
     if (needs_braces(key)) total += 2;
     if (needs_braces(vs)) total += 2;
-    lcl_ref_dec(val);
   }
 
-  buf = (char *)malloc(total + 1);
+  buf = (char *)lcl_malloc(total + 1);
   if (!buf) return;
 
   p = buf;
   it.i = 0;
-  while (lcl_dict_iter((const lcl_value **)&value, &it, &key, &val) == LCL_OK) {
-    const char *vs = lcl_value_to_string(val);
-    size_t klen = strlen(key);
-    size_t vlen = strlen(vs);
+  while (lcl_dict_next(value, &it, &key, &val) == LCL_OK) {
+    size_t vlen;
+    const char *vs = lcl_value_to_string_n(val, &vlen);
+    size_t klen = lcl_sym_len(key);
     int kbraced = needs_braces(key);
     int vbraced = needs_braces(vs);
 
@@ -155,8 +277,6 @@ static void lcl_reify_str_dict(lcl_value *value) {
     memcpy(p, vs, vlen);
     p += vlen;
     if (vbraced) *p++ = '}';
-
-    lcl_ref_dec(val);
   }
   *p = '\0';
 
@@ -186,13 +306,13 @@ const char *lcl_value_to_string(lcl_value *value) {
 
       if (tag) {
         size_t len = strlen(tag) + 10;  /* "<opaque:>" + tag + null */
-        value->str_repr = (char *)malloc(len);
+        value->str_repr = (char *)lcl_malloc(len);
 
         if (value->str_repr) {
           sprintf(value->str_repr, "<opaque:%s>", tag);
         }
       } else {
-        value->str_repr = (char *)malloc(9);
+        value->str_repr = (char *)lcl_malloc(9);
 
         if (value->str_repr) {
           memcpy(value->str_repr, "<opaque>", 9);
@@ -202,7 +322,7 @@ const char *lcl_value_to_string(lcl_value *value) {
 
     default:
       /* PROC, CPROC, NS, CELL - not directly stringifiable */
-      value->str_repr = (char *)malloc(4);
+      value->str_repr = (char *)lcl_malloc(4);
       if (!value->str_repr) return "";
       memcpy(value->str_repr, "<?>", 4);
       break;
@@ -212,25 +332,46 @@ const char *lcl_value_to_string(lcl_value *value) {
   return value->str_repr ? value->str_repr : "";
 }
 
-lcl_value *lcl_value_new_string(const char *str) {
-  lcl_value *value = (lcl_value *)calloc(1, sizeof(*value));
+/* The string and its length; strings know theirs without a strlen */
+const char *lcl_value_to_string_n(lcl_value *value, size_t *len) {
+  const char *s = lcl_value_to_string(value);
 
-  if (!value) return NULL;
+  *len = value && value->type == LCL_STRING ? value->as.str.len : strlen(s);
 
-  if (str) {
-    size_t n = strlen(str);
-    value->str_repr = (char *)malloc(n + 1);
+  return s;
+}
 
-    if (!value->str_repr) {
-      free(value);
-      return NULL;
-    }
+/* Drop value's string form, before what it holds changes in place */
+void lcl_value_clear_string(lcl_value *value) {
+  if (value->str_repr != value->as.str.sso) {
+    lcl_free(value->str_repr);
+  }
 
-    memcpy(value->str_repr, str, n + 1);
+  value->str_repr = NULL;
+}
+
+/* value's string as a hash key.  Strings keep the hash once it is known,
+ * and literals from compiled words arrive with it already set. */
+hash_key lcl_value_key(lcl_value *value) {
+  hash_key k;
+
+  if (!value || value->type != LCL_STRING) {
+    return hash_key_make(lcl_value_to_string(value));
+  }
+
+  k.s = lcl_value_to_string(value);
+
+  if (!value->as.str.hash) {
+    value->as.str.hash = hash_table_hash_n(k.s, value->as.str.len);
   }
-  
-  value->type = LCL_STRING;
-  value->refc = 1;
 
-  return value;  
+  k.len = value->as.str.len;
+  k.hash = value->as.str.hash;
+  k.sym = 0;
+
+  return k;
+}
+
+lcl_value *lcl_value_new_string(const char *str) {
+  return lcl_string_new(str);
 }
@@ -0,0 +1,180 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "hash-table.h"
+#include "lcl-alloc.h"
+#include "lcl-sym.h"
+#include "lcl-thread.h"
+
+typedef struct lcl_symbol {
+  struct lcl_symbol *chain;  /* next symbol in the same bucket */
+  unsigned long hash;
+  lcl_atomic refc;
+  size_t len;
+  char s[1];                 /* the text, stored inline */
+} lcl_symbol;
+
+/* Interpreters on any thread intern and release symbols.  The table is
+ * only touched with the lock held; a symbol's count is atomic, so taking
+ * and dropping references to a symbol already held needs no lock.  The
+ * last reference takes the lock to unlink it, unless an intern found it
+ * again first.  Being shared, symbols are never charged to the
+ * interpreter that asked for them: their memory comes from the default
+ * heap. */
+static lcl_mutex lock = LCL_MUTEX_INIT;
+static lcl_symbol **buckets;
+static size_t nbuckets;
+static size_t count;
+
+static lcl_symbol *sym_of(const char *sym) {
+  return (lcl_symbol *)(sym - offsetof(lcl_symbol, s));
+}
+
+static int grow(void) {
+  size_t n = nbuckets ? nbuckets * 2 : 256;
+  lcl_symbol **b = (lcl_symbol **)lcl_calloc(n, sizeof(*b));
+  size_t i;
+
+  if (!b) return 0;
+
+  for (i = 0; i < nbuckets; i++) {
+    lcl_symbol *y = buckets[i];
+
+    while (y) {
+      lcl_symbol *next = y->chain;
+      size_t slot = y->hash & (n - 1);
+
+      y->chain = b[slot];
+      b[slot] = y;
+      y = next;
+    }
+  }
+
+  lcl_free(buckets);
+  buckets = b;
+  nbuckets = n;
+
+  return 1;
+}
+
+static const char *intern(const char *s, size_t n, unsigned long h) {
+  lcl_symbol *y;
+
+  if (nbuckets) {
+    for (y = buckets[h & (nbuckets - 1)]; y; y = y->chain) {
+      if (y->s == s ||
+          (y->hash == h && y->len == n && memcmp(y->s, s, n) == 0)) {
+        lcl_atomic_inc(&y->refc);
+        return y->s;
+      }
+    }
+  }
+
+  if (count >= nbuckets && !grow()) return NULL;
+
+  y = (lcl_symbol *)lcl_malloc(offsetof(lcl_symbol, s) + n + 1);
+  if (!y) return NULL;
+
+  y->hash = h;
+  y->refc = 1;
+  y->len = n;
+  memcpy(y->s, s, n);
+  y->s[n] = '\0';
+
+  y->chain = buckets[h & (nbuckets - 1)];
+  buckets[h & (nbuckets - 1)] = y;
+  count++;
+
+  return y->s;
+}
+
+/* Intern n bytes of s whose hash_table_hash_n is h */
+const char *lcl_sym_intern_key(const char *s, size_t n, unsigned long h) {
+  lcl_heap *prev = lcl_heap_enter(lcl_heap_default());
+  const char *sym;
+
+  lcl_mutex_lock(&lock);
+  sym = intern(s, n, h);
+  lcl_mutex_unlock(&lock);
+
+  lcl_heap_leave(prev);
+
+  return sym;
+}
+
+const char *lcl_sym_intern_n(const char *s, size_t n) {
+  return lcl_sym_intern_key(s, n, hash_table_hash_n(s, n));
+}
+
+const char *lcl_sym_intern(const char *s) {
+  return lcl_sym_intern_n(s, strlen(s));
+}
+
+const char *lcl_sym_ref(const char *sym) {
+  if (!sym) return NULL;
+
+  lcl_atomic_inc(&sym_of(sym)->refc);
+
+  return sym;
+}
+
+/* Unlink y, whose count reached 0, unless it is back in use or another
+ * release got to it first.  y is only compared, never read, until it is
+ * found in the table, since it may already be gone. */
+static void release(lcl_symbol *y, unsigned long h) {
+  lcl_symbol **pp;
+
+  if (!nbuckets) return;
+
+  pp = &buckets[h & (nbuckets - 1)];
+
+  while (*pp && *pp != y) {
+    pp = &(*pp)->chain;
+  }
+
+  if (!*pp || lcl_atomic_get(&y->refc) != 0) return;
+
+  *pp = y->chain;
+  lcl_free(y);
+
+  /* Give the table back once nothing is interned */
+  if (--count == 0) {
+    lcl_free(buckets);
+    buckets = NULL;
+    nbuckets = 0;
+  }
+}
+
+void lcl_sym_release(const char *sym) {
+  lcl_symbol *y;
+  unsigned long h;
+
+  if (!sym) return;
+
+  y = sym_of(sym);
+  h = y->hash;
+
+  if (lcl_atomic_dec(&y->refc) > 0) return;
+
+  lcl_mutex_lock(&lock);
+  release(y, h);
+  lcl_mutex_unlock(&lock);
+}
+
+unsigned long lcl_sym_hash(const char *sym) {
+  return sym_of(sym)->hash;
+}
+
+size_t lcl_sym_len(const char *sym) {
+  return sym_of(sym)->len;
+}
+
+size_t lcl_sym_count(void) {
+  size_t n;
+
+  lcl_mutex_lock(&lock);
+  n = count;
+  lcl_mutex_unlock(&lock);
+
+  return n;
+}
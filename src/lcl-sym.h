@@ -0,0 +1,27 @@
+#ifndef LCL_SYM_H
+#define LCL_SYM_H
+
+#include <stdlib.h>
+
+/* Interned names.  All symbols with the same text are the same pointer,
+ * so they compare with ==, and each carries the hash_table_hash of its
+ * text.  A symbol reads as an ordinary NUL-terminated string.
+ *
+ * Hash table keys, variable names in compiled words and frame layout
+ * names are symbols.  The table is shared by every interpreter in the
+ * process, on whatever thread, and guarded by a lock (lcl-thread.h); the
+ * text, hash and length of a symbol never change and are read without
+ * it.  Symbols are reference counted and leave the table with their last
+ * reference.  The count is atomic, so lcl_sym_ref, and lcl_sym_release
+ * short of the last reference, take no lock; a key that is a symbol
+ * already is stored with hash_key_intern, which only takes a reference. */
+const char *lcl_sym_intern(const char *s);
+const char *lcl_sym_intern_n(const char *s, size_t n);
+const char *lcl_sym_intern_key(const char *s, size_t n, unsigned long hash);
+const char *lcl_sym_ref(const char *sym);
+void lcl_sym_release(const char *sym);
+unsigned long lcl_sym_hash(const char *sym);
+size_t lcl_sym_len(const char *sym);
+size_t lcl_sym_count(void);
+
+#endif
@@ -0,0 +1,57 @@
+#include "lcl-thread.h"
+
+#if defined(LCL_NO_THREADS)
+
+void lcl_mutex_lock(lcl_mutex *m) {
+  (void)m;
+}
+
+void lcl_mutex_unlock(lcl_mutex *m) {
+  (void)m;
+}
+
+void lcl_once(lcl_once_flag *flag, void (*fn)(void)) {
+  if (*flag) return;
+
+  *flag = 1;
+  fn();
+}
+
+#elif defined(_WIN32)
+
+void lcl_mutex_lock(lcl_mutex *m) {
+  AcquireSRWLockExclusive(m);
+}
+
+void lcl_mutex_unlock(lcl_mutex *m) {
+  ReleaseSRWLockExclusive(m);
+}
+
+static BOOL CALLBACK once_call(PINIT_ONCE once, PVOID fn, PVOID *ctx) {
+  (void)once;
+  (void)ctx;
+
+  (*(void (**)(void))fn)();
+
+  return TRUE;
+}
+
+void lcl_once(lcl_once_flag *flag, void (*fn)(void)) {
+  InitOnceExecuteOnce(flag, once_call, &fn, NULL);
+}
+
+#else
+
+void lcl_mutex_lock(lcl_mutex *m) {
+  pthread_mutex_lock(m);
+}
+
+void lcl_mutex_unlock(lcl_mutex *m) {
+  pthread_mutex_unlock(m);
+}
+
+void lcl_once(lcl_once_flag *flag, void (*fn)(void)) {
+  pthread_once(flag, fn);
+}
+
+#endif
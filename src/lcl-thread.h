@@ -0,0 +1,73 @@
+#ifndef LCL_THREAD_H
+#define LCL_THREAD_H
+
+/* The little the library needs from the platform's threads: a lock for
+ * the few tables shared by every interpreter, counters any thread may
+ * change without it, one-time setup of shared constants, and storage
+ * private to each thread.  Interpreters on different threads share
+ * nothing else.
+ *
+ * Build with LCL_NO_THREADS for a library that is only ever used from
+ * one thread; the lock, the counters and the once then cost nothing. */
+
+#if defined(LCL_NO_THREADS)
+
+typedef int lcl_mutex;
+typedef int lcl_once_flag;
+#define LCL_MUTEX_INIT 0
+#define LCL_ONCE_INIT 0
+#define LCL_THREAD_LOCAL
+
+typedef unsigned long lcl_atomic;
+#define lcl_atomic_inc(p) (++*(p))
+#define lcl_atomic_dec(p) (--*(p))
+#define lcl_atomic_get(p) (*(p))
+
+#elif defined(_WIN32)
+
+#include <windows.h>
+
+typedef SRWLOCK lcl_mutex;
+typedef INIT_ONCE lcl_once_flag;
+#define LCL_MUTEX_INIT SRWLOCK_INIT
+#define LCL_ONCE_INIT INIT_ONCE_STATIC_INIT
+#define LCL_THREAD_LOCAL __declspec(thread)
+
+typedef volatile LONG lcl_atomic;
+#define lcl_atomic_inc(p) InterlockedIncrement(p)
+#define lcl_atomic_dec(p) InterlockedDecrement(p)
+#define lcl_atomic_get(p) InterlockedCompareExchange((p), 0, 0)
+
+#else
+
+#include <pthread.h>
+
+typedef pthread_mutex_t lcl_mutex;
+typedef pthread_once_t lcl_once_flag;
+#define LCL_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+#define LCL_ONCE_INIT PTHREAD_ONCE_INIT
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LCL_THREAD_LOCAL __thread
+
+typedef unsigned long lcl_atomic;
+#define lcl_atomic_inc(p) __atomic_add_fetch((p), 1, __ATOMIC_RELAXED)
+#define lcl_atomic_dec(p) __atomic_sub_fetch((p), 1, __ATOMIC_ACQ_REL)
+#define lcl_atomic_get(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#else
+#error "define LCL_THREAD_LOCAL and lcl_atomic for this compiler, or build with LCL_NO_THREADS"
+#endif
+
+#endif
+
+/* lcl_atomic_inc and lcl_atomic_dec change a counter and give its new
+ * value; lcl_atomic_get reads it */
+
+void lcl_mutex_lock(lcl_mutex *m);
+void lcl_mutex_unlock(lcl_mutex *m);
+
+/* Run fn exactly once however many threads get here first; the others
+ * wait until it has returned */
+void lcl_once(lcl_once_flag *flag, void (*fn)(void));
+
+#endif
@@ -16,6 +16,40 @@ typedef enum lcl_type {
   LCL_OPAQUE
 } lcl_type;
 
+/* Integers in this range are shared constants (lcl_int_new).  Build with
+ * other bounds to change it. */
+#ifndef LCL_SMALL_INT_MIN
+#define LCL_SMALL_INT_MIN (-256)
+#endif
+#ifndef LCL_SMALL_INT_MAX
+#define LCL_SMALL_INT_MAX 1024
+#endif
+
+/* refc of a constant: lcl_ref_inc and lcl_ref_dec leave it alone */
+#define LCL_REFC_IMMORTAL (-1)
+
+/* Value headers per slab chunk (lcl-slab.c) unless lcl_slab_set_chunk
+ * says otherwise */
+#ifndef LCL_SLAB_CHUNK
+#define LCL_SLAB_CHUNK 256
+#endif
+
+/* What a string value knows of its numeric forms (as.str.num), found the
+ * first time it is converted and kept, since its text cannot change */
+#define LCL_STR_INT       1u  /* as.str.n.i holds its integer */
+#define LCL_STR_FLOAT     2u  /* as.str.n.f holds its double */
+#define LCL_STR_NOT_INT   4u  /* parsed, not an integer */
+#define LCL_STR_NOT_FLOAT 8u  /* parsed, not a number */
+
+/* How a list holds its elements.  A list whose elements are all ints, or
+ * all floats, keeps the bare numbers and boxes them when read; anything
+ * else stored in it turns it back into a list of values. */
+typedef enum {
+  LCL_LIST_VALUES,
+  LCL_LIST_INTS,
+  LCL_LIST_FLOATS
+} lcl_list_kind;
+
 typedef void (*lcl_finalizer)(void *ptr);
 
 typedef int (*lcl_cproc)(lcl_frame *env,
@@ -23,17 +57,38 @@ typedef int (*lcl_cproc)(lcl_frame *env,
                          lcl_value **argv,
                          lcl_value **out);
 
+/* Strings of up to this many bytes are kept in the value itself
+ * (as.str.sso), as are the string forms of ints and floats, which leave
+ * that part of the union unused.  The default fills a 72-byte value. */
+#ifndef LCL_SSO_MAX
+#define LCL_SSO_MAX 19
+#endif
+
 struct lcl_value {
   lcl_type type;
   int refc;
-  char *str_repr;
+  lcl_slab *slab;  /* the header goes back here, or to lcl_free if NULL */
+  char *str_repr;  /* may point at as.str.sso */
   union {
+    struct {
+      size_t len;          /* of str_repr */
+      unsigned long hash;  /* of str_repr, or 0 until asked for */
+      union {
+        long i;
+        double f;
+      } n;
+      unsigned num;        /* LCL_STR_* forms held in n */
+      char sso[LCL_SSO_MAX + 1];
+    } str;
     long i;
     double f;
     struct {
-      lcl_value **items;
+      lcl_value **items;  /* LCL_LIST_VALUES */
+      long *ints;         /* LCL_LIST_INTS */
+      double *floats;     /* LCL_LIST_FLOATS */
       int len;
       int cap;
+      lcl_list_kind kind;
     } list;
     struct {
       hash_table *dictionary;
@@ -66,16 +121,74 @@ typedef struct {
 lcl_value *lcl_ref_inc(lcl_value *value);
 void lcl_ref_dec(lcl_value *value);
 
+/* A zeroed header from the current slab, and its return; every
+ * constructor and the last lcl_ref_dec go through these rather than
+ * calloc and free */
+lcl_value *lcl_value_alloc(void);
+void lcl_value_free(lcl_value *v);
+
+/* An interpreter's slab.  Closing it says no more values will be made
+ * from it; it is freed with the last of them. */
+lcl_slab *lcl_slab_new(void);
+void lcl_slab_close(lcl_slab *sl);
+
+/* Make sl current on this thread and return the slab that was, for
+ * lcl_slab_leave; lcl_interp_enter does both for an interpreter */
+lcl_slab *lcl_slab_enter(lcl_slab *sl);
+void lcl_slab_leave(lcl_slab *prev);
+
+/* This thread's current slab, or NULL while no interpreter runs there,
+ * and the frames it keeps.  A slab is not freed while frames made from
+ * it are live; lcl-frame.c calls lcl_slab_release once the last goes. */
+lcl_slab *lcl_slab_current(void);
+lcl_frame_cache *lcl_slab_frames(lcl_slab *sl);
+void lcl_slab_release(lcl_slab *sl);
+
+void lcl_slab_set_chunk(lcl_interp *interp, size_t values);
+void lcl_slab_get_stats(lcl_interp *interp, lcl_slab_stats *out);
+
 lcl_value *lcl_string_new(const char *str);
+lcl_value *lcl_string_empty(void);
+lcl_value *lcl_string_new_n(const char *str, size_t n);
 const char *lcl_value_to_string(lcl_value *value);
+const char *lcl_value_to_string_n(lcl_value *value, size_t *len);
+void lcl_value_clear_string(lcl_value *value);
+hash_key lcl_value_key(lcl_value *value);
 
 lcl_value *lcl_int_new(const long n);
-lcl_value *lcl_float_new(const float f);
+lcl_value *lcl_float_new(const double f);
 lcl_result lcl_value_to_int(lcl_value *value, long *out);
 lcl_result lcl_value_to_float(lcl_value *value, float *out);
+lcl_result lcl_value_to_double(lcl_value *value, double *out);
+
+/* A number read from a value: an integer when it is one, else a double */
+typedef struct {
+  int is_int;
+  long i;
+  double f;
+} lcl_number;
+
+lcl_result lcl_value_to_number(lcl_value *value, lcl_number *out);
+lcl_value *lcl_number_new(const lcl_number *n);
+void lcl_number_add(lcl_number *acc, const lcl_number *b);
+void lcl_number_sub(lcl_number *acc, const lcl_number *b);
+void lcl_number_mul(lcl_number *acc, const lcl_number *b);
+lcl_result lcl_number_div(lcl_number *acc, const lcl_number *b);
+/* What lcl_number_cmp returns when either side is NaN: every ordering
+ * and == are false for it, != true */
+#define LCL_CMP_UNORDERED 2
+
+int lcl_number_cmp(const lcl_number *a, const lcl_number *b);
 
 lcl_value *lcl_list_new(void);
+lcl_value *lcl_list_adopt_ints(long *data, size_t n);
+lcl_value *lcl_list_adopt_floats(double *data, size_t n);
 lcl_result lcl_list_get(const lcl_value *list, size_t i, lcl_value **out);
+
+/* Element i borrowed, or NULL, for packed lists as well as out of range
+ * (lcl-list.c).  Not public: a host could not tell the two NULLs apart,
+ * so it has lcl_list_get. */
+lcl_value *lcl_list_peek(const lcl_value *list, size_t i);
 lcl_result lcl_list_push(lcl_value **list_io, lcl_value *value);
 lcl_result lcl_list_set(lcl_value **list_io, size_t i, lcl_value *value);
 size_t lcl_list_len(const lcl_value *list);
@@ -84,19 +197,27 @@ lcl_value *lcl_dict_new(void);
 size_t lcl_dict_len(const lcl_value *dict);
 lcl_result lcl_dict_get(const lcl_value *dict, const char *key,
                         lcl_value **out);
+lcl_result lcl_dict_get_key(const lcl_value *dict, const hash_key *k,
+                            lcl_value **out);
+lcl_value *lcl_dict_peek(const lcl_value *dict, const char *key);
+lcl_value *lcl_dict_peek_key(const lcl_value *dict, const hash_key *k);
 lcl_result lcl_dict_put(lcl_value **dict_io, const char *key,
                         lcl_value *value);
 lcl_result lcl_dict_del(lcl_value **dict_io, const char *key);
 lcl_result lcl_dict_iter(const lcl_value **dict_io, lcl_dict_it *it, const char **key,
                          lcl_value **value);
+lcl_result lcl_dict_next(const lcl_value *dict, lcl_dict_it *it,
+                         const char **key, lcl_value **value);
 
 lcl_value *lcl_cell_new(lcl_value *init);
 lcl_result lcl_cell_get(lcl_value *cell, lcl_value **out);
+lcl_value *lcl_cell_peek(const lcl_value *cell);
 lcl_result lcl_cell_set(lcl_value *cell, lcl_value *v);
 
 lcl_value *lcl_ns_new(const char *qname);
 lcl_result lcl_ns_def(lcl_value *ns, const char *name, lcl_value *value);
 lcl_result lcl_ns_get(lcl_value *ns, const char *name, lcl_value **out);
+lcl_result lcl_ns_get_key(lcl_value *ns, const hash_key *k, lcl_value **out);
 const char *lcl_ns_split(const char *q, char *lhs, size_t nlhs, const char **rhs);
 
 const char *lcl_value_to_string(lcl_value *value);
@@ -0,0 +1,412 @@
+#include "lcl-thread.h"
+#include "lcl-vec.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    defined(__SSE2__)
+#define LCL_VEC_X86 1
+#include <immintrin.h>
+#endif
+
+/* ============================================================================
+ * Scalar
+ * ============================================================================ */
+
+static double sum_scalar(const double *x, size_t n) {
+  double s = 0.0;
+  size_t i;
+
+  for (i = 0; i < n; i++) s += x[i];
+
+  return s;
+}
+
+static double min_scalar(const double *x, size_t n) {
+  double m = x[0];
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    if (x[i] != x[i]) return x[i];
+    if (x[i] < m) m = x[i];
+  }
+
+  return m;
+}
+
+static double max_scalar(const double *x, size_t n) {
+  double m = x[0];
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    if (x[i] != x[i]) return x[i];
+    if (x[i] > m) m = x[i];
+  }
+
+  return m;
+}
+
+static double dot_scalar(const double *x, const double *y, size_t n) {
+  double s = 0.0;
+  size_t i;
+
+  for (i = 0; i < n; i++) s += x[i] * y[i];
+
+  return s;
+}
+
+static void add_scalar(double *out, const double *x, const double *y,
+                       size_t n) {
+  size_t i;
+
+  for (i = 0; i < n; i++) out[i] = x[i] + y[i];
+}
+
+static void mul_scalar(double *out, const double *x, const double *y,
+                       size_t n) {
+  size_t i;
+
+  for (i = 0; i < n; i++) out[i] = x[i] * y[i];
+}
+
+#ifdef LCL_VEC_X86
+
+/* ============================================================================
+ * SSE2, two lanes; always there on x86-64
+ * ============================================================================ */
+
+static double hsum2(__m128d v) {
+  return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+static double sum_sse2(const double *x, size_t n) {
+  __m128d acc = _mm_setzero_pd();
+  size_t i = 0;
+  double s;
+
+  for (; i + 2 <= n; i += 2) acc = _mm_add_pd(acc, _mm_loadu_pd(x + i));
+
+  s = hsum2(acc);
+  for (; i < n; i++) s += x[i];
+
+  return s;
+}
+
+static double min_sse2(const double *x, size_t n) {
+  __m128d m, v, nan;
+  size_t i = 2;
+  double r, hi;
+
+  if (n < 2) return min_scalar(x, n);
+
+  m = _mm_loadu_pd(x);
+  nan = _mm_cmpunord_pd(m, m);
+  for (; i + 2 <= n; i += 2) {
+    v = _mm_loadu_pd(x + i);
+    nan = _mm_or_pd(nan, _mm_cmpunord_pd(v, v));
+    m = _mm_min_pd(v, m);
+  }
+
+  if (_mm_movemask_pd(nan)) return min_scalar(x, n);
+
+  r = _mm_cvtsd_f64(m);
+  hi = _mm_cvtsd_f64(_mm_unpackhi_pd(m, m));
+  if (hi < r) r = hi;
+  for (; i < n; i++) {
+    if (x[i] != x[i]) return x[i];
+    if (x[i] < r) r = x[i];
+  }
+
+  return r;
+}
+
+static double max_sse2(const double *x, size_t n) {
+  __m128d m, v, nan;
+  size_t i = 2;
+  double r, hi;
+
+  if (n < 2) return max_scalar(x, n);
+
+  m = _mm_loadu_pd(x);
+  nan = _mm_cmpunord_pd(m, m);
+  for (; i + 2 <= n; i += 2) {
+    v = _mm_loadu_pd(x + i);
+    nan = _mm_or_pd(nan, _mm_cmpunord_pd(v, v));
+    m = _mm_max_pd(v, m);
+  }
+
+  if (_mm_movemask_pd(nan)) return max_scalar(x, n);
+
+  r = _mm_cvtsd_f64(m);
+  hi = _mm_cvtsd_f64(_mm_unpackhi_pd(m, m));
+  if (hi > r) r = hi;
+  for (; i < n; i++) {
+    if (x[i] != x[i]) return x[i];
+    if (x[i] > r) r = x[i];
+  }
+
+  return r;
+}
+
+static double dot_sse2(const double *x, const double *y, size_t n) {
+  __m128d acc = _mm_setzero_pd();
+  size_t i = 0;
+  double s;
+
+  for (; i + 2 <= n; i += 2) {
+    acc = _mm_add_pd(acc, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+  }
+
+  s = hsum2(acc);
+  for (; i < n; i++) s += x[i] * y[i];
+
+  return s;
+}
+
+static void add_sse2(double *out, const double *x, const double *y, size_t n) {
+  size_t i = 0;
+
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+  }
+
+  for (; i < n; i++) out[i] = x[i] + y[i];
+}
+
+static void mul_sse2(double *out, const double *x, const double *y, size_t n) {
+  size_t i = 0;
+
+  for (; i + 2 <= n; i += 2) {
+    _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+  }
+
+  for (; i < n; i++) out[i] = x[i] * y[i];
+}
+
+/* ============================================================================
+ * AVX2, four lanes; compiled for that target and used only if the CPU
+ * reports it
+ * ============================================================================ */
+
+#define LCL_AVX2 __attribute__((target("avx2")))
+
+LCL_AVX2 static double hsum4(__m256d v) {
+  __m128d lo = _mm256_castpd256_pd128(v);
+  __m128d hi = _mm256_extractf128_pd(v, 1);
+
+  return hsum2(_mm_add_pd(lo, hi));
+}
+
+LCL_AVX2 static double sum_avx2(const double *x, size_t n) {
+  __m256d a0 = _mm256_setzero_pd();
+  __m256d a1 = _mm256_setzero_pd();
+  size_t i = 0;
+  double s;
+
+  /* two accumulators, so consecutive adds do not wait on each other */
+  for (; i + 8 <= n; i += 8) {
+    a0 = _mm256_add_pd(a0, _mm256_loadu_pd(x + i));
+    a1 = _mm256_add_pd(a1, _mm256_loadu_pd(x + i + 4));
+  }
+
+  for (; i + 4 <= n; i += 4) a0 = _mm256_add_pd(a0, _mm256_loadu_pd(x + i));
+
+  s = hsum4(_mm256_add_pd(a0, a1));
+  for (; i < n; i++) s += x[i];
+
+  return s;
+}
+
+LCL_AVX2 static double min_avx2(const double *x, size_t n) {
+  __m256d m, v, nan;
+  __m128d h;
+  size_t i = 4;
+  double r;
+
+  if (n < 4) return min_scalar(x, n);
+
+  m = _mm256_loadu_pd(x);
+  nan = _mm256_cmp_pd(m, m, _CMP_UNORD_Q);
+  for (; i + 4 <= n; i += 4) {
+    v = _mm256_loadu_pd(x + i);
+    nan = _mm256_or_pd(nan, _mm256_cmp_pd(v, v, _CMP_UNORD_Q));
+    m = _mm256_min_pd(v, m);
+  }
+
+  if (_mm256_movemask_pd(nan)) return min_scalar(x, n);
+
+  h = _mm_min_pd(_mm256_extractf128_pd(m, 1), _mm256_castpd256_pd128(m));
+  r = _mm_cvtsd_f64(_mm_min_sd(_mm_unpackhi_pd(h, h), h));
+  for (; i < n; i++) {
+    if (x[i] != x[i]) return x[i];
+    if (x[i] < r) r = x[i];
+  }
+
+  return r;
+}
+
+LCL_AVX2 static double max_avx2(const double *x, size_t n) {
+  __m256d m, v, nan;
+  __m128d h;
+  size_t i = 4;
+  double r;
+
+  if (n < 4) return max_scalar(x, n);
+
+  m = _mm256_loadu_pd(x);
+  nan = _mm256_cmp_pd(m, m, _CMP_UNORD_Q);
+  for (; i + 4 <= n; i += 4) {
+    v = _mm256_loadu_pd(x + i);
+    nan = _mm256_or_pd(nan, _mm256_cmp_pd(v, v, _CMP_UNORD_Q));
+    m = _mm256_max_pd(v, m);
+  }
+
+  if (_mm256_movemask_pd(nan)) return max_scalar(x, n);
+
+  h = _mm_max_pd(_mm256_extractf128_pd(m, 1), _mm256_castpd256_pd128(m));
+  r = _mm_cvtsd_f64(_mm_max_sd(_mm_unpackhi_pd(h, h), h));
+  for (; i < n; i++) {
+    if (x[i] != x[i]) return x[i];
+    if (x[i] > r) r = x[i];
+  }
+
+  return r;
+}
+
+LCL_AVX2 static double dot_avx2(const double *x, const double *y, size_t n) {
+  __m256d a0 = _mm256_setzero_pd();
+  __m256d a1 = _mm256_setzero_pd();
+  size_t i = 0;
+  double s;
+
+  for (; i + 8 <= n; i += 8) {
+    a0 = _mm256_add_pd(a0, _mm256_mul_pd(_mm256_loadu_pd(x + i),
+                                         _mm256_loadu_pd(y + i)));
+    a1 = _mm256_add_pd(a1, _mm256_mul_pd(_mm256_loadu_pd(x + i + 4),
+                                         _mm256_loadu_pd(y + i + 4)));
+  }
+
+  for (; i + 4 <= n; i += 4) {
+    a0 = _mm256_add_pd(a0, _mm256_mul_pd(_mm256_loadu_pd(x + i),
+                                         _mm256_loadu_pd(y + i)));
+  }
+
+  s = hsum4(_mm256_add_pd(a0, a1));
+  for (; i < n; i++) s += x[i] * y[i];
+
+  return s;
+}
+
+LCL_AVX2 static void add_avx2(double *out, const double *x, const double *y,
+                              size_t n) {
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(x + i),
+                                            _mm256_loadu_pd(y + i)));
+  }
+
+  for (; i < n; i++) out[i] = x[i] + y[i];
+}
+
+LCL_AVX2 static void mul_avx2(double *out, const double *x, const double *y,
+                              size_t n) {
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(x + i),
+                                            _mm256_loadu_pd(y + i)));
+  }
+
+  for (; i < n; i++) out[i] = x[i] * y[i];
+}
+
+#endif /* LCL_VEC_X86 */
+
+/* ============================================================================
+ * Dispatch
+ * ============================================================================ */
+
+typedef struct {
+  double (*sum)(const double *, size_t);
+  double (*min)(const double *, size_t);
+  double (*max)(const double *, size_t);
+  double (*dot)(const double *, const double *, size_t);
+  void (*add)(double *, const double *, const double *, size_t);
+  void (*mul)(double *, const double *, const double *, size_t);
+} vec_kernels;
+
+static const vec_kernels scalar_kernels = {
+  sum_scalar, min_scalar, max_scalar, dot_scalar, add_scalar, mul_scalar
+};
+
+#ifdef LCL_VEC_X86
+static const vec_kernels sse2_kernels = {
+  sum_sse2, min_sse2, max_sse2, dot_sse2, add_sse2, mul_sse2
+};
+
+static const vec_kernels avx2_kernels = {
+  sum_avx2, min_avx2, max_avx2, dot_avx2, add_avx2, mul_avx2
+};
+#endif
+
+/* Chosen once, on first use by any thread, unless lcl_vec_select came
+ * first */
+static const vec_kernels *kernels;
+static lcl_once_flag kernels_once = LCL_ONCE_INIT;
+
+int lcl_vec_select(int level) {
+  switch (level) {
+  case LCL_VEC_SCALAR:
+    kernels = &scalar_kernels;
+    return 1;
+#ifdef LCL_VEC_X86
+  case LCL_VEC_SSE2:
+    kernels = &sse2_kernels;
+    return 1;
+  case LCL_VEC_AVX2:
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("avx2")) return 0;
+
+    kernels = &avx2_kernels;
+    return 1;
+#endif
+  default:
+    return 0;
+  }
+}
+
+static void kernels_init(void) {
+  if (!kernels && !lcl_vec_select(LCL_VEC_AVX2) &&
+      !lcl_vec_select(LCL_VEC_SSE2)) {
+    lcl_vec_select(LCL_VEC_SCALAR);
+  }
+}
+
+static const vec_kernels *vec(void) {
+  lcl_once(&kernels_once, kernels_init);
+
+  return kernels;
+}
+
+double lcl_vec_sum(const double *x, size_t n) {
+  return vec()->sum(x, n);
+}
+
+double lcl_vec_min(const double *x, size_t n) {
+  return vec()->min(x, n);
+}
+
+double lcl_vec_max(const double *x, size_t n) {
+  return vec()->max(x, n);
+}
+
+double lcl_vec_dot(const double *x, const double *y, size_t n) {
+  return vec()->dot(x, y, n);
+}
+
+void lcl_vec_add(double *out, const double *x, const double *y, size_t n) {
+  vec()->add(out, x, y, n);
+}
+
+void lcl_vec_mul(double *out, const double *x, const double *y, size_t n) {
+  vec()->mul(out, x, y, n);
+}
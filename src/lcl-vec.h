@@ -0,0 +1,36 @@
+#ifndef LCL_VEC_H
+#define LCL_VEC_H
+
+#include <stdlib.h>
+
+/* Kernels over arrays of doubles, for the numeric List:: commands.  On
+ * x86 with GCC or Clang they use SSE2, or AVX2 when the CPU has it
+ * (checked once, at run time); elsewhere they are plain loops.  Vector
+ * paths add in a different order than a left-to-right loop, so sums may
+ * differ from one in the last bits. */
+
+/* Kernel sets */
+#define LCL_VEC_SCALAR 0
+#define LCL_VEC_SSE2   1
+#define LCL_VEC_AVX2   2
+
+/* Use one kernel set from now on, if this build and CPU have it, and
+ * return 1; else return 0 and change nothing.  Without a call the best
+ * available set is used.  Not locked: call it while no other thread is
+ * running an interpreter. */
+int lcl_vec_select(int level);
+
+double lcl_vec_sum(const double *x, size_t n);
+
+/* n must be at least 1.  Every kernel set gives the first NaN in x, if
+ * there is one, whatever order its lanes compare in. */
+double lcl_vec_min(const double *x, size_t n);
+double lcl_vec_max(const double *x, size_t n);
+
+double lcl_vec_dot(const double *x, const double *y, size_t n);
+
+/* out may be x or y */
+void lcl_vec_add(double *out, const double *x, const double *y, size_t n);
+void lcl_vec_mul(double *out, const double *x, const double *y, size_t n);
+
+#endif
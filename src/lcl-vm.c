@@ -0,0 +1,543 @@
+#include <string.h>
+
+#include "lcl-alloc.h"
+#include "lcl-eval.h"
+#include "lcl-values.h"
+#include "lcl-vm.h"
+
+/**
+   Register code
+
+   Every word and command leaves its value in a register; a command's
+   callee lives in its base register with the arguments right above it,
+   so CALL passes &r[a + 1] as argv without copying.  Registers that do
+   not hold a value are NULL, which lets an error path release whatever
+   is live with one sweep.
+**/
+
+typedef enum {
+  OP_LIT,    /* r[a] = string of literal piece p */
+  OP_VAR,    /* r[a] = value of variable p (cells unwrapped) */
+  OP_CAT,    /* r[a] = concatenation of r[a .. a+b) as strings */
+  OP_EMPTY,  /* r[a] = "" */
+  OP_DROP,   /* release r[a] */
+  OP_CMD,    /* start top-level command b; releases the previous result */
+  OP_HEAD,   /* resolve callee in r[a] for a command of b words */
+  OP_NAME,   /* like HEAD, for command cmd whose name is a literal */
+  OP_CALL,   /* r[a] = r[a](r[a+1 .. a+1+b)) */
+  OP_END
+} lcl_opcode;
+
+typedef struct {
+  int op;
+  int a;
+  int b;
+  int c;          /* HEAD: where to continue if no CALL is needed;
+                     VAR: slot of the name in `layout`, or -1 */
+  const void *p;  /* literal piece, variable name or raw argument words */
+  lcl_layout *layout;  /* VAR: layout c was resolved against */
+  const lcl_command *cmd;  /* NAME: owner of the call-site cache */
+} lcl_insn;
+
+struct lcl_code {
+  lcl_arena *arena;  /* the program's; it holds this and both arrays */
+  lcl_insn *insn;
+  int ninsn;
+  int cap;
+  const lcl_word **raw;  /* argument words of every command, in order */
+  int nraw;
+  int nregs;
+};
+
+/* Registers live on the C stack up to this many, and on the
+ * interpreter's argument stack beyond */
+#define LCL_VM_LOCAL_REGS 16
+
+static int count_raw(const lcl_program *p) {
+  int n = 0;
+  int i, j, k;
+
+  for (i = 0; i < p->ncmd; i++) {
+    const lcl_command *cmd = &p->cmd[i];
+
+    if (cmd->argc > 1) {
+      n += cmd->argc - 1;
+    }
+
+    for (j = 0; j < cmd->argc; j++) {
+      const lcl_word *w = &cmd->w[j];
+
+      for (k = 0; k < w->np; k++) {
+        if (w->wp[k].kind == LCL_WP_SUBCMD) {
+          n += count_raw(w->wp[k].as.sub.program);
+        }
+      }
+    }
+  }
+
+  return n;
+}
+
+static int emit(lcl_code *c, int op, int a, int b, const void *p) {
+  lcl_insn *in;
+
+  if (c->ninsn >= c->cap) {
+    int newcap = c->cap ? c->cap * 2 : 16;
+    void *nv = lcl_arena_grow(c->arena, c->insn,
+                              (size_t)c->cap * sizeof(*c->insn),
+                              (size_t)newcap * sizeof(*c->insn));
+
+    if (!nv) return -1;
+
+    c->insn = (lcl_insn *)nv;
+    c->cap = newcap;
+  }
+
+  if (a >= c->nregs) {
+    c->nregs = a + 1;
+  }
+
+  in = &c->insn[c->ninsn];
+  in->op = op;
+  in->a = a;
+  in->b = b;
+  in->c = 0;
+  in->p = p;
+  in->layout = NULL;
+  in->cmd = NULL;
+
+  return c->ninsn++;
+}
+
+static int compile_command(lcl_code *c, const lcl_command *cmd, int reg);
+
+/* A bracketed sub-program, run inline; its value ends up in r[reg] */
+static int compile_inline(lcl_code *c, const lcl_program *p, int reg) {
+  int i;
+
+  if (p->ncmd == 0) {
+    return emit(c, OP_EMPTY, reg, 0, NULL) >= 0;
+  }
+
+  for (i = 0; i < p->ncmd; i++) {
+    if (i && emit(c, OP_DROP, reg, 0, NULL) < 0) {
+      return 0;
+    }
+
+    if (!compile_command(c, &p->cmd[i], reg)) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static int compile_piece(lcl_code *c, const lcl_word_piece *wp, int reg) {
+  switch (wp->kind) {
+  case LCL_WP_LIT:
+    return emit(c, OP_LIT, reg, 0, wp) >= 0;
+  case LCL_WP_VAR:
+    return emit(c, OP_VAR, reg, 0, wp->as.var.name) >= 0;
+  case LCL_WP_SUBCMD:
+    return compile_inline(c, wp->as.sub.program, reg);
+  }
+
+  return 0;
+}
+
+static int compile_word(lcl_code *c, const lcl_word *w, int reg) {
+  int i;
+
+  if (w->np == 0) {
+    return emit(c, OP_EMPTY, reg, 0, NULL) >= 0;
+  }
+
+  /* A single piece keeps its value's type, as in lcl_eval_word */
+  if (w->np == 1) {
+    return compile_piece(c, &w->wp[0], reg);
+  }
+
+  for (i = 0; i < w->np; i++) {
+    if (!compile_piece(c, &w->wp[i], reg + i)) {
+      return 0;
+    }
+  }
+
+  return emit(c, OP_CAT, reg, w->np, NULL) >= 0;
+}
+
+static int compile_command(lcl_code *c, const lcl_command *cmd, int reg) {
+  const lcl_word **raw = NULL;
+  int head;
+  int i;
+
+  if (cmd->argc == 0) {
+    return emit(c, OP_EMPTY, reg, 0, NULL) >= 0;
+  }
+
+  if (cmd->argc > 1) {
+    raw = c->raw + c->nraw;
+
+    for (i = 1; i < cmd->argc; i++) {
+      c->raw[c->nraw++] = &cmd->w[i];
+    }
+  }
+
+  /* A literal name is only materialised if its call-site cache misses */
+  if (lcl_word_is_name(&cmd->w[0])) {
+    head = emit(c, OP_NAME, reg, cmd->argc, raw);
+  } else if (compile_word(c, &cmd->w[0], reg)) {
+    head = emit(c, OP_HEAD, reg, cmd->argc, raw);
+  } else {
+    return 0;
+  }
+
+  if (head < 0) return 0;
+
+  c->insn[head].cmd = cmd;
+
+  for (i = 1; i < cmd->argc; i++) {
+    if (!compile_word(c, &cmd->w[i], reg + i)) {
+      return 0;
+    }
+  }
+
+  if (emit(c, OP_CALL, reg, cmd->argc - 1, NULL) < 0) {
+    return 0;
+  }
+
+  c->insn[head].c = c->ninsn;
+
+  return 1;
+}
+
+lcl_code *lcl_code_compile(lcl_program *p) {
+  lcl_code *c = (lcl_code *)lcl_arena_alloc(&p->arena, sizeof(*c));
+  int nraw;
+  int i;
+
+  if (!c) return NULL;
+
+  memset(c, 0, sizeof(*c));
+  c->arena = &p->arena;
+  nraw = count_raw(p);
+
+  if (nraw > 0) {
+    c->raw = (const lcl_word **)lcl_arena_alloc(c->arena,
+                                                (size_t)nraw * sizeof(*c->raw));
+
+    if (!c->raw) {
+      lcl_code_free(c);
+      return NULL;
+    }
+  }
+
+  /* The result of the running top-level command is always r[0] */
+  c->nregs = 1;
+
+  for (i = 0; i < p->ncmd; i++) {
+    if (emit(c, OP_CMD, 0, i, NULL) < 0 ||
+        !compile_command(c, &p->cmd[i], 0)) {
+      lcl_code_free(c);
+      return NULL;
+    }
+  }
+
+  if (emit(c, OP_END, 0, 0, NULL) < 0) {
+    lcl_code_free(c);
+    return NULL;
+  }
+
+  return c;
+}
+
+void lcl_code_free(lcl_code *code) {
+  int i;
+
+  if (!code) return;
+
+  for (i = 0; i < code->ninsn; i++) {
+    lcl_layout_ref_dec(code->insn[i].layout);
+  }
+}
+
+static lcl_value *concat(lcl_value **r, int n) {
+  char small[LCL_SSO_MAX + 1];
+  size_t total = 0;
+  size_t len;
+  char *buf;
+  char *p;
+  lcl_value *v;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    lcl_value_to_string_n(r[i], &len);
+    total += len;
+  }
+
+  /* a result short enough to live in its value needs no buffer */
+  buf = total < sizeof(small) ? small : (char *)lcl_malloc(total);
+
+  if (!buf) return NULL;
+
+  p = buf;
+  *p = '\0';
+
+  for (i = 0; i < n; i++) {
+    const char *s = lcl_value_to_string_n(r[i], &len);
+
+    memcpy(p, s, len);
+    p += len;
+  }
+
+  v = lcl_string_new_n(buf, total);
+  if (buf != small) lcl_free(buf);
+
+  return v;
+}
+
+#if defined(__GNUC__)
+#define LCL_VM_COMPUTED_GOTO 1
+#endif
+
+#ifdef LCL_VM_COMPUTED_GOTO
+#define VM_DISPATCH()  goto *labels[ip->op];
+#define VM_CASE(op)    L_##op:
+#define VM_NEXT()      do { ip++; goto *labels[ip->op]; } while (0)
+#define VM_JUMP(t)     do { ip = code->insn + (t); goto *labels[ip->op]; } while (0)
+#else
+#define VM_DISPATCH()  dispatch: switch (ip->op)
+#define VM_CASE(op)    case op:
+#define VM_NEXT()      do { ip++; goto dispatch; } while (0)
+#define VM_JUMP(t)     do { ip = code->insn + (t); goto dispatch; } while (0)
+#endif
+
+int lcl_vm_exec(lcl_interp *interp, const lcl_program *pr, lcl_value **out) {
+#ifdef LCL_VM_COMPUTED_GOTO
+  static const void *labels[] = {
+    &&L_OP_LIT, &&L_OP_VAR, &&L_OP_CAT, &&L_OP_EMPTY, &&L_OP_DROP,
+    &&L_OP_CMD, &&L_OP_HEAD, &&L_OP_NAME, &&L_OP_CALL, &&L_OP_END
+  };
+#endif
+  const lcl_code *code = pr->code;
+  const lcl_insn *ip = code->insn;
+  lcl_value *local[LCL_VM_LOCAL_REGS];
+  lcl_value **r = local;
+  lcl_value *val;
+  lcl_value *callee;
+  int cur = 0;
+  int rc = LCL_RC_OK;
+  int i;
+
+  if (code->nregs > LCL_VM_LOCAL_REGS) {
+    r = lcl_stack_push(interp, (size_t)code->nregs);
+
+    if (!r) return LCL_RC_ERR;
+  } else {
+    memset(local, 0, sizeof(local));
+  }
+
+  val = NULL;
+
+  VM_DISPATCH() {
+    VM_CASE(OP_LIT) {
+      const lcl_word_piece *wp = (const lcl_word_piece *)ip->p;
+
+      r[ip->a] = lcl_ref_inc(wp->as.lit.value);
+
+      VM_NEXT();
+    }
+
+    VM_CASE(OP_VAR) {
+      lcl_frame *f = interp->env.frame;
+
+      /* In a proc frame the name's slot is resolved once per layout and
+       * read directly; unbound slots fall back to the full lookup. */
+      if (f->layout) {
+        if (ip->layout != f->layout) {
+          lcl_insn *in = (lcl_insn *)ip;
+
+          lcl_layout_ref_dec(in->layout);
+          in->layout = lcl_layout_ref_inc(f->layout);
+          in->c = lcl_layout_slot(f->layout, (const char *)ip->p);
+        }
+
+        if (ip->c >= 0 && f->slots[ip->c]) {
+          val = lcl_ref_inc(f->slots[ip->c]);
+        }
+      }
+
+      if (!val && lcl_env_get_sym(&interp->env, (const char *)ip->p,
+                                  &val) != LCL_OK) {
+        rc = LCL_RC_ERR;
+        goto fail;
+      }
+
+      /* Unwrap cell if needed */
+      if (val->type == LCL_CELL) {
+        lcl_value *inner = lcl_ref_inc(lcl_cell_peek(val));
+
+        lcl_ref_dec(val);
+        val = inner;
+
+        if (!val) {
+          rc = LCL_RC_ERR;
+          goto fail;
+        }
+      }
+
+      r[ip->a] = val;
+      val = NULL;
+
+      VM_NEXT();
+    }
+
+    VM_CASE(OP_CAT) {
+      val = concat(r + ip->a, ip->b);
+
+      for (i = 0; i < ip->b; i++) {
+        if (r[ip->a + i]) lcl_ref_dec(r[ip->a + i]);
+        r[ip->a + i] = NULL;
+      }
+
+      if (!val) {
+        rc = LCL_RC_ERR;
+        goto fail;
+      }
+
+      r[ip->a] = val;
+      val = NULL;
+
+      VM_NEXT();
+    }
+
+    VM_CASE(OP_EMPTY) {
+      r[ip->a] = lcl_string_empty();
+
+      if (!r[ip->a]) {
+        rc = LCL_RC_ERR;
+        goto fail;
+      }
+
+      VM_NEXT();
+    }
+
+    VM_CASE(OP_DROP) {
+      if (r[ip->a]) {
+        lcl_ref_dec(r[ip->a]);
+        r[ip->a] = NULL;
+      }
+
+      VM_NEXT();
+    }
+
+    VM_CASE(OP_CMD) {
+      if (r[0]) {
+        lcl_ref_dec(r[0]);
+        r[0] = NULL;
+      }
+
+      cur = ip->b;
+
+      VM_NEXT();
+    }
+
+    VM_CASE(OP_NAME) {
+      lcl_call_cache *cc = (lcl_call_cache *)&ip->cmd->cache;
+
+      callee = lcl_call_cache_get(&interp->env, cc);
+
+      if (callee) goto resolved;
+
+      r[ip->a] = lcl_ref_inc(ip->cmd->w[0].wp[0].as.lit.value);
+
+      rc = lcl_resolve_callee(interp, r[ip->a], ip->b, cc, &callee, &val);
+      r[ip->a] = NULL;
+
+      goto head_done;
+    }
+
+    VM_CASE(OP_HEAD) {
+      callee = NULL;
+      rc = lcl_resolve_callee(interp, r[ip->a], ip->b, NULL, &callee, &val);
+      r[ip->a] = NULL;
+
+    head_done:
+      if (rc != LCL_RC_OK) goto fail;
+
+      if (!callee) {
+        /* Single-word command naming no procedure: its value is itself */
+        r[ip->a] = val;
+        val = NULL;
+
+        VM_JUMP(ip->c);
+      }
+
+    resolved:
+
+      if (callee->type == LCL_CPROC &&
+          callee->as.c_proc.fn->kind == LCL_CK_SPECIAL) {
+        rc = callee->as.c_proc.fn->fn.spec(interp, ip->b - 1,
+                                           (const lcl_word **)ip->p, &val);
+        lcl_ref_dec(callee);
+
+        if (rc != LCL_RC_OK) goto fail;
+
+        r[ip->a] = val;
+        val = NULL;
+
+        VM_JUMP(ip->c);
+      }
+
+      r[ip->a] = callee;
+
+      VM_NEXT();
+    }
+
+    VM_CASE(OP_CALL) {
+      lcl_value **argv = r + ip->a + 1;
+
+      rc = lcl_invoke(interp, r[ip->a], ip->b, argv, &val);
+
+      for (i = 0; i < ip->b; i++) {
+        if (argv[i]) lcl_ref_dec(argv[i]);
+        argv[i] = NULL;
+      }
+
+      lcl_ref_dec(r[ip->a]);
+      r[ip->a] = NULL;
+
+      if (rc != LCL_RC_OK) goto fail;
+
+      r[ip->a] = val;
+      val = NULL;
+
+      VM_NEXT();
+    }
+
+    VM_CASE(OP_END) {
+      *out = r[0];
+
+      if (r != local) lcl_stack_pop(interp, (size_t)code->nregs);
+
+      return LCL_RC_OK;
+    }
+  }
+
+fail:
+  /* Propagate RETURN - let caller (e.g., lcl_call_user_proc) handle it */
+  if (rc != LCL_RC_RETURN) {
+    interp->err_line = pr->cmd[cur].line;
+    interp->err_file = pr->file;
+  }
+
+  for (i = 0; i < code->nregs; i++) {
+    if (r[i]) lcl_ref_dec(r[i]);
+  }
+
+  if (r != local) lcl_stack_pop(interp, (size_t)code->nregs);
+
+  *out = val;
+
+  return rc;
+}
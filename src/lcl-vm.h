@@ -0,0 +1,19 @@
+#ifndef LCL_VM_H
+#define LCL_VM_H
+
+#include "lcl-compile.h"
+
+/* Flat register code for one program.  It is built the first time the
+ * program runs and kept on it (p->code), in p's arena; bracketed
+ * sub-programs are inlined, and special forms still receive the raw
+ * words of their command. */
+lcl_code *lcl_code_compile(lcl_program *p);
+
+/* Drops the code's references; its memory goes with the arena */
+void lcl_code_free(lcl_code *code);
+
+/* Run p's code in the current frame.  Same contract as lcl_eval_program,
+ * minus the depth accounting, which the caller does. */
+int lcl_vm_exec(lcl_interp *interp, const lcl_program *p, lcl_value **out);
+
+#endif
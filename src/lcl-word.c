@@ -2,20 +2,23 @@
 #include <memory.h>
 #include <string.h>
 
+#include "lcl-expr.h"
 #include "lcl-lex.h"
+#include "lcl-sym.h"
+#include "lcl-values.h"
 #include "str-compat.h"
 
-/** TODO this needs to be better **/
-static int lcl_word_push_word_piece(lcl_word *word,
+static int lcl_word_push_word_piece(lcl_arena *a, lcl_word *word,
                                     lcl_word_piece wp) {
   int idx;
 
   if (word->np >= word->cap) {
-    int newcap = (word->cap > 0) ? word->cap * 2 : 4;
+    int newcap = (word->cap > 0) ? word->cap * 2 : 1;
 
     {
-      size_t bytes = (size_t)newcap * sizeof(*word->wp);
-      void *p = realloc(word->wp, bytes);
+      void *p = lcl_arena_grow(a, word->wp,
+                               (size_t)word->cap * sizeof(*word->wp),
+                               (size_t)newcap * sizeof(*word->wp));
 
       if (!p) return 0;
 
@@ -34,68 +37,86 @@ static int lcl_word_push_word_piece(lcl_word *word,
 void lcl_word_piece_free(lcl_word_piece *wp) {
   switch (wp->kind) {
   case LCL_WP_LIT:
-    free(wp->as.lit.s);
+    lcl_ref_dec(wp->as.lit.value);
     break;
   case LCL_WP_VAR:
-    free(wp->as.var.name);
+    lcl_sym_release(wp->as.var.name);
     break;
   case LCL_WP_SUBCMD:
-    lcl_program_free(wp->as.sub.program);
+    lcl_program_ref_dec(wp->as.sub.program);
     break;
   default:
     break;
   }
-
-  free(wp);
 }
 
 void lcl_word_free(lcl_word *w) {
-  lcl_word_piece_free(w->wp);
-  free(w);
+  int i;
+
+  for (i = 0; i < w->np; i++) {
+    lcl_word_piece_free(&w->wp[i]);
+  }
+
+  lcl_program_ref_dec(w->program);
+  lcl_expr_free(w->expr);
 }
 
-int lcl_word_add_lit(lcl_word *w, const char *s, size_t n) {
+/* The literal becomes its string value here, once, rather than each time
+ * the word is evaluated; evaluation only takes a reference.  Nothing
+ * modifies a string value in place, so one can be shared, and numbers
+ * parsed from it stay cached on it for every later run. */
+int lcl_word_add_lit(lcl_arena *a, lcl_word *w, const char *s, size_t n) {
   lcl_word_piece wp;
-  wp.kind = LCL_WP_LIT;
-  wp.as.lit.s = (char *)malloc(n + 1);
+  lcl_value *v = lcl_string_new_n(s, n);
 
-  if (!wp.as.lit.s) {
+  if (!v) {
     return 0;
   }
 
-  memcpy(wp.as.lit.s, s, n);
-  wp.as.lit.s[n] = '\0';
+  /* The shared empty string has its hash already */
+  if (n) v->as.str.hash = hash_table_hash_n(s, n);
+
+  wp.kind = LCL_WP_LIT;
+  wp.as.lit.s = v->str_repr;
   wp.as.lit.n = n;
+  wp.as.lit.value = v;
 
-  lcl_word_push_word_piece(w, wp);
+  if (!lcl_word_push_word_piece(a, w, wp)) {
+    lcl_ref_dec(v);
+    return 0;
+  }
 
   return 1;
 }
 
-int lcl_word_add_var(lcl_word *w, const char *name) {
+int lcl_word_add_var(lcl_arena *a, lcl_word *w, const char *name) {
+  return lcl_word_add_var_n(a, w, name, strlen(name));
+}
+
+int lcl_word_add_var_n(lcl_arena *a, lcl_word *w, const char *name,
+                       size_t n) {
   lcl_word_piece wp;
-  size_t n = strlen(name);
 
   wp.kind = LCL_WP_VAR;
-  wp.as.var.name = (char *)malloc(n + 1);
+  wp.as.var.name = lcl_sym_intern_n(name, n);
 
   if (!wp.as.var.name) {
     return 0;
   }
 
-  memcpy(wp.as.var.name, name, n + 1);
-
-  lcl_word_push_word_piece(w, wp);
+  if (!lcl_word_push_word_piece(a, w, wp)) {
+    lcl_sym_release(wp.as.var.name);
+    return 0;
+  }
 
-  return 1;  
+  return 1;
 }
 
-int lcl_word_add_sub(lcl_word *w, lcl_program *sub) {
+/* On failure sub is still the caller's */
+int lcl_word_add_sub(lcl_arena *a, lcl_word *w, lcl_program *sub) {
   lcl_word_piece wp;
   wp.kind = LCL_WP_SUBCMD;
   wp.as.sub.program = sub;
 
-  lcl_word_push_word_piece(w, wp);
-
-  return 1;
+  return lcl_word_push_word_piece(a, w, wp);
 }
@@ -1,10 +1,15 @@
+#include <float.h>
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "lcl-alloc.h"
 #include "lcl-compile.h"
 #include "lcl-eval.h"
 #include "lcl-values.h"
 #include "lcl-stdlib.h"
+#include "lcl-sym.h"
+#include "lcl-vec.h"
 
 /**
    Testing
@@ -174,6 +179,8 @@ static int lcl_program_dump(const lcl_program *P, char **out_str) {
 int  lcl_program_dump(const lcl_program *P, char **out_str);
 lcl_program *lcl_compile(const char *src, const char *file);
 void lcl_program_free(lcl_program *P);
+int lcl_eval_file(lcl_interp *interp, const char *path, lcl_value **out);
+lcl_result lcl_compile_file(const char *path, const char *out_path);
 
 /* ---- dumb assert macros (C89-friendly) ---- */
 #define ASSERT_TRUE(cond) do { if (!(cond)) { \
@@ -258,6 +265,1160 @@ static int test_unmatched_brace_error(void) {
   return compile_and_dump(src, NULL);
 }
 
+static int test_compile_cache_hits(void) {
+  lcl_interp *interp = lcl_interp_new();
+  lcl_value *v = NULL;
+  int i;
+
+  ASSERT_TRUE(interp != NULL);
+  lcl_register_core(interp);
+
+  for (i = 0; i < 3; i++) {
+    ASSERT_TRUE(lcl_eval_string(interp, "eval {+ 1 2}; subst {a[+ 1 1]}", &v)
+                == LCL_RC_OK);
+    lcl_ref_dec(v);
+  }
+
+  /* the string and the subst template each miss once, then hit */
+  ASSERT_TRUE(interp->cache.stats.misses == 2);
+  ASSERT_TRUE(interp->cache.stats.hits == 4);
+
+  lcl_cache_set_limit(&interp->cache, 0);
+  ASSERT_TRUE(interp->cache.stats.entries == 0);
+  ASSERT_TRUE(interp->cache.stats.bytes == 0);
+
+  lcl_interp_free(interp);
+  return 1;
+}
+
+static int eval_expect(lcl_interp *interp, const char *src, const char *expect) {
+  lcl_value *v = NULL;
+  int ok;
+
+  ASSERT_TRUE(lcl_eval_string(interp, src, &v) == LCL_RC_OK);
+  ok = strcmp(lcl_value_to_string(v), expect) == 0;
+
+  if (!ok) {
+    printf("    got:    %s\n", lcl_value_to_string(v));
+    printf("    expect: %s\n", expect);
+  }
+
+  lcl_ref_dec(v);
+  return ok;
+}
+
+static int test_body_cache(void) {
+  lcl_program *P = lcl_program_compile("while 0 {puts x}", "test.lcl");
+  lcl_interp *interp = lcl_interp_new();
+  lcl_program *a, *b;
+  int ok;
+
+  ASSERT_TRUE(P != NULL && interp != NULL);
+  lcl_register_core(interp);
+
+  /* a braced body is compiled once and kept on its word */
+  a = lcl_word_program(interp, &P->cmd[0].w[2], "test.lcl");
+  b = lcl_word_program(interp, &P->cmd[0].w[2], "test.lcl");
+  ok = a != NULL && a == b && P->cmd[0].w[2].program == a;
+  lcl_program_ref_dec(a);
+  lcl_program_ref_dec(b);
+  lcl_program_free(P);
+
+  /* a proc defined again runs its new body, not the cached old one */
+  ok = ok &&
+       eval_expect(interp,
+                   "proc f {x} { if [< $x 0] { return neg } else { return old } }; "
+                   "f 1", "old") &&
+       eval_expect(interp,
+                   "proc f {x} { if [< $x 0] { return neg } else { return new } }; "
+                   "f 1", "new") &&
+       eval_expect(interp, "f -1", "neg") &&
+       eval_expect(interp,
+                   "var n 0; while [< $n 3] { set! n [+ $n 1] }; "
+                   "while [< $n 5] { set! n [+ $n 1] }; $n", "5");
+
+  lcl_interp_free(interp);
+  return ok;
+}
+
+static int test_call_site_cache_invalidation(void) {
+  lcl_interp *interp = lcl_interp_new();
+  int ok;
+
+  ASSERT_TRUE(interp != NULL);
+  lcl_register_core(interp);
+
+  ok = eval_expect(interp, "proc h {} { return a }; proc c {} { h }; c; c", "a") &&
+       eval_expect(interp, "proc h {} { return b }; c", "b") &&
+       eval_expect(interp, "proc p {h} { c }; p 1", "1") &&
+       eval_expect(interp, "c", "b");
+
+  lcl_interp_free(interp);
+  return ok;
+}
+
+static int test_control_flow(void) {
+  lcl_interp *interp = lcl_interp_new();
+  lcl_value *v = NULL;
+  int ok;
+
+  ASSERT_TRUE(interp != NULL);
+  lcl_register_core(interp);
+
+  /* return leaves every loop around it; break and continue only the
+   * innermost */
+  ok = eval_expect(interp,
+                   "proc r {} { foreach x [list 1 2 3] { while 1 { "
+                   "if [== $x 2] { return found$x }; break } }; "
+                   "return none }; r",
+                   "found2") &&
+       eval_expect(interp,
+                   "var out [list]; foreach x [list 1 2] { "
+                   "foreach y [list a b c] { if [== $y b] { break }; "
+                   "set! out [List::push $out $x$y] } }; "
+                   "String::join $out ,",
+                   "1a,2a") &&
+       eval_expect(interp,
+                   "var s 0; for-range i 0 6 { "
+                   "if [== [% $i 2] 0] { continue }; set! s [+ $s $i] }; $s",
+                   "9") &&
+       eval_expect(interp,
+                   "var k 0; while 1 { set! k [+ $k 1]; "
+                   "if [< $k 4] { continue }; break }; $k",
+                   "4");
+
+  /* a [return x] inside a word returns x from the proc */
+  ok = ok &&
+       eval_expect(interp, "proc g {} { let y [return inner]; return outer }; g",
+                   "inner") &&
+       eval_expect(interp,
+                   "proc h {} { for-range i 0 3 { "
+                   "let y [+ 1 [return early$i]] }; return late }; h",
+                   "early0");
+
+  /* an error unwinds every call and loop, and stops the script */
+  ok = ok &&
+       lcl_eval_string(interp,
+                       "proc down {n} { if [== $n 0] { + a 1 } else { "
+                       "foreach x [list 1] { down [- $n 1] } } }; down 40",
+                       &v) == LCL_RC_ERR &&
+       interp->depth == 0;
+  lcl_ref_dec(v);
+  v = NULL;
+
+  ok = ok &&
+       lcl_eval_string(interp, "var z 0; set! z [+ a 1]; set! z 9", &v)
+       == LCL_RC_ERR &&
+       eval_expect(interp, "$z", "0") &&
+       eval_expect(interp, "+ 1 2", "3");
+  lcl_ref_dec(v);
+
+  lcl_interp_free(interp);
+  return ok;
+}
+
+static int test_slot_layouts(void) {
+  lcl_interp *interp = lcl_interp_new();
+  lcl_value *p = NULL;
+  lcl_layout *l;
+  int ok;
+
+  ASSERT_TRUE(interp != NULL);
+  lcl_register_core(interp);
+
+  /* params and let/var names are slots of the proc's frame */
+  ASSERT_TRUE(eval_expect(interp,
+                          "let x global; proc p2 {a} { let x local; "
+                          "var y 1; list $a $x $y }; p2 0",
+                          "0 local 1"));
+  ASSERT_TRUE(lcl_env_get_value(&interp->env, "p2", &p) == LCL_OK);
+  l = p->as.procedure.proc->layout;
+  ok = l != NULL && l->nparams == 1 && lcl_layout_slot(l, "a") == 0 &&
+       lcl_layout_slot(l, "x") > 0 && lcl_layout_slot(l, "y") > 0;
+  lcl_ref_dec(p);
+
+  /* slots shadow outer names without touching them */
+  ok = ok &&
+       eval_expect(interp, "$x", "global") &&
+       eval_expect(interp, "proc p1 {x} { $x }; p1 param", "param") &&
+       eval_expect(interp,
+                   "proc p3 {a} { let f [lambda {a} { + $a 100 }]; "
+                   "list [$f 1] $a }; p3 5",
+                   "101 5");
+
+  /* closures capture slot-resident locals, cells included */
+  ok = ok &&
+       eval_expect(interp,
+                   "proc mk {} { var n 0; lambda {} { set! n [+ $n 1]; $n } }; "
+                   "let c [mk]; $c; $c",
+                   "2") &&
+       eval_expect(interp,
+                   "proc cap {a} { let b [+ $a 1]; lambda {} { list $a $b } }; "
+                   "[cap 1]",
+                   "1 2");
+
+  /* code compiled apart from the body finds slots by name, and names
+   * the layout lacks fall back to the frame's own bindings */
+  ok = ok &&
+       eval_expect(interp, "proc e1 {a} { eval {+ $a 1} }; e1 41", "42") &&
+       eval_expect(interp, "proc e2 {} { eval {let q 5}; + $q 1 }; e2", "6") &&
+       eval_expect(interp, "proc e3 {} { var w 1; eval {set! w 7}; $w }; e3",
+                   "7") &&
+       eval_expect(interp, "proc e4 {a} { subst {a=$a} }; e4 9", "a=9") &&
+       eval_expect(interp, "let G 10; proc rg {} { + $G 1 }; rg", "11") &&
+       eval_expect(interp,
+                   "namespace eval ns { let v 3; proc f {x} { + $x $v } }; "
+                   "ns::f 1",
+                   "4");
+
+  lcl_interp_free(interp);
+  return ok;
+}
+
+static int test_literals_shared(void) {
+  lcl_program *P = lcl_program_compile("puts 42 x", "test.lcl");
+  lcl_interp *interp = lcl_interp_new();
+  lcl_value *a = NULL, *b = NULL;
+  lcl_value *lit;
+  long n = 0;
+  int ok;
+
+  ASSERT_TRUE(P != NULL && interp != NULL);
+
+  /* each evaluation hands out the word's one value, number included */
+  lit = P->cmd[0].w[1].wp[0].as.lit.value;
+  ok = lcl_eval_word_to_str(interp, &P->cmd[0].w[1], &a) == LCL_RC_OK &&
+       lcl_eval_word_to_str(interp, &P->cmd[0].w[1], &b) == LCL_RC_OK &&
+       a == lit && b == lit &&
+       lcl_value_to_int(a, &n) == LCL_OK && n == 42 &&
+       (lit->as.str.num & LCL_STR_INT);
+
+  lcl_ref_dec(a);
+  lcl_ref_dec(b);
+  lcl_interp_free(interp);
+  lcl_program_free(P);
+
+  return ok;
+}
+
+static int test_program_arena(void) {
+  lcl_arena a;
+  lcl_program *P = lcl_program_compile("a b [c d]; e {f g} $h", "test.lcl");
+  lcl_interp *interp = lcl_interp_new();
+  lcl_value *lit = NULL;
+  char *x, *y;
+  int ok;
+
+  /* the newest block grows in place; an older one moves, contents kept */
+  lcl_arena_init(&a);
+  x = (char *)lcl_arena_alloc(&a, 4);
+  memcpy(x, "abc", 4);
+  ok = lcl_arena_grow(&a, x, 4, 64) == x;
+  y = (char *)lcl_arena_alloc(&a, 8);
+  x = (char *)lcl_arena_grow(&a, x, 64, 128);
+  ok = ok && x != NULL && x != y && strcmp(x, "abc") == 0;
+  lcl_arena_free(&a);
+  ASSERT_TRUE(ok && a.chunk == NULL && a.bytes == 0);
+
+  /* a literal handed out lives on after its program is freed */
+  ASSERT_TRUE(P != NULL && interp != NULL);
+  ASSERT_TRUE(P->ncmd == 2 && P->cmd[0].argc == 3 && P->cmd[1].argc == 3);
+  ASSERT_TRUE(lcl_eval_word_to_str(interp, &P->cmd[1].w[1], &lit)
+              == LCL_RC_OK);
+  lcl_program_free(P);
+  ok = strcmp(lcl_value_to_string(lit), "f g") == 0;
+
+  lcl_ref_dec(lit);
+  lcl_interp_free(interp);
+
+  return ok;
+}
+
+static int test_constants_shared(void) {
+  lcl_value *a = lcl_int_new(7);
+  lcl_value *b = lcl_int_new(7);
+  lcl_value *big = lcl_int_new(LCL_SMALL_INT_MAX + 1L);
+  lcl_value *e = lcl_string_new("");
+  lcl_value *m = lcl_int_new(LCL_SMALL_INT_MIN);
+  long i;
+  int ok;
+
+  /* constants arrive complete, so readers on other threads never fill
+   * anything in */
+  ASSERT_TRUE(m->str_repr != NULL && a->str_repr != NULL);
+  ASSERT_TRUE(e->as.str.hash != 0 &&
+              e->as.str.num == (LCL_STR_NOT_INT | LCL_STR_NOT_FLOAT));
+  ASSERT_TRUE(lcl_value_to_int(e, &i) == LCL_ERROR);
+  ASSERT_TRUE(e->as.str.num == (LCL_STR_NOT_INT | LCL_STR_NOT_FLOAT));
+
+  /* releasing a constant more often than it was made must not free it */
+  lcl_ref_dec(a);
+  lcl_ref_dec(a);
+
+  ok = a == b && b->as.i == 7 && strcmp(lcl_value_to_string(b), "7") == 0 &&
+       big->refc == 1 && e == lcl_string_empty() &&
+       m->as.i == LCL_SMALL_INT_MIN && m->str_repr[0] == '-';
+
+  lcl_ref_dec(big);
+  lcl_ref_dec(e);
+
+  return ok;
+}
+
+static int test_integer_arithmetic(void) {
+  lcl_interp *interp = lcl_interp_new();
+  int ok;
+
+  ASSERT_TRUE(interp != NULL);
+  lcl_register_core(interp);
+
+  /* past 2^24, where single floats lose count, and past a long */
+  ok = eval_expect(interp, "+ 16777216 1", "16777217") &&
+       eval_expect(interp, "< 16777216 16777217", "1") &&
+       eval_expect(interp, "* 4611686018427387904 4", "1.8446744073709552e+19") &&
+       eval_expect(interp, "/ 8 2", "4") &&
+       eval_expect(interp, "/ 7 2", "3") &&
+       eval_expect(interp, "/ 7 2.0", "3.5") &&
+       eval_expect(interp, "- 1 0.5", "0.5") &&
+       eval_expect(interp, "+ 9223372036854775807 0", "9223372036854775807") &&
+       eval_expect(interp, "+ 9223372036854775808 0", "9.223372036854776e+18") &&
+       eval_expect(interp, "+ 99999999999999999999 1", "1e+20") &&
+       eval_expect(interp, "- -9223372036854775809 0",
+                   "-9.223372036854776e+18");
+
+  /* NaN is unordered: every comparison with it is false, but != */
+  ok = ok && eval_expect(interp, ">= nan 1", "0") &&
+       eval_expect(interp, "<= nan 1", "0") &&
+       eval_expect(interp, "< 1 nan", "0") &&
+       eval_expect(interp, "> nan nan", "0") &&
+       eval_expect(interp, "let n nan; expr {$n >= 1 || $n < 1}", "0") &&
+       eval_expect(interp, "expr {$n == $n}", "0") &&
+       eval_expect(interp, "expr {$n != $n}", "1") &&
+       eval_expect(interp, "if [<= $n 1] { list a } else { list b }", "b");
+
+  /* an int against a double is exact, even where the int has no double */
+  ok = ok &&
+       eval_expect(interp, "> 9007199254740993 9007199254740992.0", "1") &&
+       eval_expect(interp, "< 9007199254740992.0 9007199254740993", "1") &&
+       eval_expect(interp, "<= 9007199254740993 9007199254740992.0", "0") &&
+       eval_expect(interp, "expr {9007199254740993 > 9007199254740992.0}",
+                   "1") &&
+       eval_expect(interp, "< 9223372036854775807 9223372036854775808.0",
+                   "1") &&
+       eval_expect(interp, "> -9223372036854775808 -inf", "1") &&
+       eval_expect(interp, "< -3 -2.5", "1") &&
+       eval_expect(interp, "< -2 -2.5", "0") &&
+       eval_expect(interp, ">= 3 3.0", "1");
+
+  lcl_interp_free(interp);
+  return ok;
+}
+
+static int test_expr(void) {
+  lcl_interp *interp = lcl_interp_new();
+  lcl_program *p;
+  lcl_value *v = NULL;
+  int ok;
+
+  ASSERT_TRUE(interp != NULL);
+  lcl_register_core(interp);
+
+  ok = eval_expect(interp, "let a 6; var b 7; expr {$a * $b + 10 / 3}", "45") &&
+       eval_expect(interp, "expr {(1 + 2) * -3 % 4}", "-1") &&
+       eval_expect(interp, "expr {$a < $b && $b <= 7 || 0}", "1") &&
+       eval_expect(interp, "expr {!($a == 6.0) + (${b} != 7)}", "0") &&
+       eval_expect(interp, "expr {[+ 1 1] * 1.5}", "3") &&
+       eval_expect(interp, "expr {9223372036854775807 + 1}",
+                   "9.223372036854776e+18") &&
+       eval_expect(interp, "expr {9223372036854775808}",
+                   "9.223372036854776e+18") &&
+       eval_expect(interp, "expr {-9223372036854775808 / -1}",
+                   "9.223372036854776e+18") &&
+       eval_expect(interp, "expr {(-9223372036854775807 - 1) / -1}",
+                   "9.223372036854776e+18") &&
+       eval_expect(interp, "expr $a + 1", "7") &&
+       eval_expect(interp, "proc sq {x} { expr {$x * $x} }; sq 2.5", "6.25") &&
+       eval_expect(interp, "expr {0 && [nosuchcommand]}", "0");
+
+  ok = ok && lcl_eval_string(interp, "expr {1 +}", &v) != LCL_RC_OK &&
+       lcl_eval_string(interp, "expr {1 / 0}", &v) != LCL_RC_OK &&
+       lcl_eval_string(interp, "expr {$nosuchvar}", &v) != LCL_RC_OK;
+
+  /* a braced expression is compiled once, onto its word */
+  p = lcl_program_compile("set! b [+ $b 1]; expr {$b * 2}", NULL);
+  ok = ok && p && lcl_eval_program(interp, p, &v) == LCL_RC_OK &&
+       strcmp(lcl_value_to_string(v), "16") == 0 && p->cmd[1].w[1].expr;
+  lcl_ref_dec(v);
+  v = NULL;
+
+  ok = ok && lcl_eval_program(interp, p, &v) == LCL_RC_OK &&
+       strcmp(lcl_value_to_string(v), "18") == 0;
+  lcl_ref_dec(v);
+
+  lcl_program_free(p);
+  lcl_interp_free(interp);
+  return ok;
+}
+
+static int test_fused_conditions(void) {
+  lcl_interp *interp = lcl_interp_new();
+  lcl_value *v = NULL;
+  int ok;
+
+  ASSERT_TRUE(interp != NULL);
+  lcl_register_core(interp);
+
+  ok = eval_expect(interp,
+                   "var i 0; while {< $i 5} { set! i [+ $i 1] }; + $i 0", "5") &&
+       eval_expect(interp,
+                   "var j 0; while {[<= $j 5]} { set! j [+ $j 1] }; + $j 0",
+                   "6") &&
+       eval_expect(interp, "if [== [list 1 2] [list 1 2]] {list y} else {list n}",
+                   "y") &&
+       eval_expect(interp, "if [!= 1.0 1] {list y} else {list n}", "n") &&
+       eval_expect(interp, "if [not 0] {list y} else {list n}", "y") &&
+       eval_expect(interp,
+                   "proc f {n} { var c 0; for {var k 0} {>= $n $k} "
+                   "{set! k [+ $k 1]} { set! c [+ $c 1] }; return $c }; f 3",
+                   "4");
+
+  /* errors and rebinding behave as without fusion */
+  ok = ok && lcl_eval_string(interp, "if [< a 1] {list y}", &v) != LCL_RC_OK;
+
+  ok = ok && eval_expect(interp,
+                         "proc < {a b} { return 0 }; var m 0; "
+                         "while {< $m 3} { set! m [+ $m 1] }; + $m 0", "0");
+
+  lcl_interp_free(interp);
+  return ok;
+}
+
+static int test_for_range(void) {
+  lcl_interp *interp = lcl_interp_new();
+  lcl_value *v = NULL;
+  int ok;
+
+  ASSERT_TRUE(interp != NULL);
+  lcl_register_core(interp);
+
+  ok = eval_expect(interp,
+                   "var s [list]; for-range i 0 4 { set! s [List::push $s $i] }; "
+                   "getvar s", "0 1 2 3") &&
+       eval_expect(interp,
+                   "var d [list]; for-range i 10 0 -4 { set! d [List::push $d $i] }; "
+                   "getvar d", "10 6 2") &&
+       eval_expect(interp,
+                   "var c [list]; for-range i 0 9 { if [== $i 1] { continue }; "
+                   "if [== $i 4] { break }; set! c [List::push $c $i] }; getvar c",
+                   "0 2 3") &&
+       eval_expect(interp,
+                   "proc f {} { for-range i 5000 6000 { if [== $i 5005] "
+                   "{ return $i } } }; f", "5005");
+
+  /* each closure keeps the value its iteration saw, even though the
+   * counter's box is otherwise reused */
+  ok = ok && eval_expect(interp,
+                         "var fs [list]; for-range k 7000 7003 "
+                         "{ set! fs [List::push $fs [lambda {} { return $k }]] }; "
+                         "[get $fs 0]", "7000");
+
+  /* nor may it be reused once the body rebinds the counter, leaving the
+   * box with another holder */
+  ok = ok && eval_expect(interp,
+                         "var first 0; for-range i 8000 8003 "
+                         "{ if [== $i 8000] { set! first $i }; let i z }; "
+                         "getvar first", "8000") &&
+       eval_expect(interp,
+                   "proc g {} { var first 0; for-range i 8000 8003 "
+                   "{ if [== $i 8000] { set! first $i }; let i z }; "
+                   "getvar first }; g", "8000");
+
+  ok = ok && lcl_eval_string(interp, "for-range i 0 1.5 {}", &v) != LCL_RC_OK &&
+       lcl_eval_string(interp, "for-range i 0 5 0 {}", &v) != LCL_RC_OK;
+
+  lcl_interp_free(interp);
+  return ok;
+}
+
+static int test_value_slab(void) {
+  lcl_interp *interp = lcl_interp_new();
+  lcl_interp *other = lcl_interp_new();
+  lcl_interp *prev;
+  lcl_slab_stats before, after, theirs;
+  lcl_value *a, *b, *kept, *host;
+
+  ASSERT_TRUE(interp != NULL && other != NULL);
+  lcl_register_core(interp);
+  lcl_register_core(other);
+
+  /* a freed header is the next one its interpreter hands out */
+  prev = lcl_interp_enter(interp);
+  a = lcl_float_new(1.5);
+  ASSERT_TRUE(a != NULL && a->slab == interp->slab);
+  lcl_ref_dec(a);
+  b = lcl_float_new(2.5);
+  ASSERT_TRUE(b == a);
+  ASSERT_TRUE(b->as.f == 2.5 && b->str_repr == NULL);
+  lcl_ref_dec(b);
+  lcl_interp_leave(prev);
+
+  /* the host's own values come from no slab */
+  host = lcl_float_new(3.5);
+  ASSERT_TRUE(host != NULL && host->slab == NULL);
+  lcl_ref_dec(host);
+
+  /* a call leaves no headers behind, and touches no other slab */
+  ASSERT_TRUE(eval_expect(interp,
+                          "proc f {} { var s [list]; for-range i 2000 3000 "
+                          "{ set! s [List::push $s [list $i]] }; len $s }",
+                          ""));
+  ASSERT_TRUE(eval_expect(interp, "f", "1000"));
+  lcl_slab_get_stats(interp, &before);
+  lcl_slab_get_stats(other, &theirs);
+  ASSERT_TRUE(eval_expect(interp, "f", "1000"));
+  lcl_slab_get_stats(interp, &after);
+  ASSERT_TRUE(after.live == before.live);
+  ASSERT_TRUE(after.allocs - before.allocs >= 1000);
+  ASSERT_TRUE(after.allocs - before.allocs == after.frees - before.frees);
+  ASSERT_TRUE(after.chunks > 0 && after.chunk == LCL_SLAB_CHUNK);
+  lcl_slab_get_stats(other, &after);
+  ASSERT_TRUE(after.allocs == theirs.allocs && after.live == theirs.live);
+
+  /* a value the host keeps outlives its interpreter, and its slab goes
+   * when it does */
+  ASSERT_TRUE(lcl_eval_string(interp, "list a b [f]", &kept) == LCL_RC_OK);
+  lcl_interp_free(interp);
+  ASSERT_TRUE(strcmp(lcl_value_to_string(kept), "a b 1000") == 0);
+  lcl_ref_dec(kept);
+
+  lcl_interp_free(other);
+  return 1;
+}
+
+static int test_frame_reuse(void) {
+  lcl_interp *interp = lcl_interp_new();
+  lcl_interp *other = lcl_interp_new();
+  lcl_interp *prev;
+  lcl_frame *a, *b, *c;
+  lcl_value *v, *got = NULL;
+  char name[8];
+  int i, ok = 1;
+
+  ASSERT_TRUE(interp != NULL && other != NULL);
+  lcl_register_core(interp);
+
+  /* a dropped frame is the next one its interpreter hands out, and no
+   * other interpreter's */
+  prev = lcl_interp_enter(interp);
+  a = lcl_frame_new(interp->env.frame);
+  ASSERT_TRUE(a != NULL && a->slab == interp->slab);
+  c = lcl_frame_new(interp->env.frame);
+  lcl_frame_ref_dec(a);
+  lcl_interp_leave(prev);
+
+  prev = lcl_interp_enter(other);
+  b = lcl_frame_new(other->env.frame);
+  ASSERT_TRUE(b != a && b->slab == other->slab);
+  lcl_frame_ref_dec(b);
+  lcl_interp_leave(prev);
+
+  prev = lcl_interp_enter(interp);
+  b = lcl_frame_new(interp->env.frame);
+  lcl_frame_ref_dec(c);
+  lcl_interp_leave(prev);
+  ASSERT_TRUE(b == a);
+  ASSERT_TRUE(b->refc == 1 && b->locals == NULL && b->npairs == 0);
+
+  /* names stay in pairs until there are too many for them */
+  for (i = 0; i < 10; i++) {
+    sprintf(name, "v%d", i);
+    v = lcl_int_new(i);
+    ok = ok && lcl_frame_put(b, name, v);
+    lcl_ref_dec(v);
+    ok = ok && (i < LCL_FRAME_PAIRS ? b->locals == NULL
+                                    : b->locals != NULL && b->npairs == 0);
+  }
+  ASSERT_TRUE(ok);
+
+  v = lcl_int_new(42);
+  ASSERT_TRUE(lcl_frame_put(b, "v1", v));
+  lcl_ref_dec(v);
+
+  for (i = 0; i < 10; i++) {
+    sprintf(name, "v%d", i);
+    ok = ok && lcl_frame_lookup(b, name, &got) &&
+         got->as.i == (i == 1 ? 42 : i);
+    if (got) lcl_ref_dec(got);
+    got = NULL;
+  }
+  ASSERT_TRUE(ok);
+  ASSERT_TRUE(!lcl_frame_lookup(b, "v10", &got));
+  lcl_frame_ref_dec(b);
+
+  /* recursion and closures see their own bindings */
+  ASSERT_TRUE(eval_expect(interp,
+                          "proc fact {n} { if [< $n 2] { return 1 }; "
+                          "* $n [fact [- $n 1]] }",
+                          ""));
+  ASSERT_TRUE(eval_expect(interp, "fact 10", "3628800"));
+  ASSERT_TRUE(eval_expect(interp,
+                          "proc adder {k} { lambda {x} { + $x $k } }",
+                          ""));
+  ASSERT_TRUE(eval_expect(interp,
+                          "let a3 [adder 3]; let a5 [adder 5]; "
+                          "+ [$a3 1] [$a5 1]",
+                          "10"));
+
+  /* a closure the host keeps holds its frame past the interpreter */
+  got = NULL;
+  ASSERT_TRUE(lcl_eval_string(interp, "adder 7", &got) == LCL_RC_OK);
+  lcl_interp_free(interp);
+  ASSERT_TRUE(got->type == LCL_PROC);
+  lcl_ref_dec(got);
+
+  lcl_interp_free(other);
+  return 1;
+}
+
+static int test_borrowed_accessors(void) {
+  lcl_value *list = lcl_list_new();
+  lcl_value *ints = lcl_list_new();
+  lcl_value *dict = lcl_dict_new();
+  lcl_value *s = lcl_string_new("hello");
+  lcl_value *n = lcl_int_new(7);
+  lcl_value *cell, *v;
+  lcl_dict_it it = {0};
+  const char *key;
+  int rc, seen = 0;
+
+  ASSERT_TRUE(lcl_list_push(&list, s) == LCL_OK);
+  ASSERT_TRUE(lcl_list_push(&ints, n) == LCL_OK);
+  ASSERT_TRUE(lcl_dict_put(&dict, "k", s) == LCL_OK);
+  cell = lcl_cell_new(s);
+  rc = s->refc;
+
+  /* peeks hand back the stored value and leave its count alone */
+  ASSERT_TRUE(lcl_list_peek(list, 0) == s);
+  ASSERT_TRUE(lcl_list_peek(list, 1) == NULL);
+  ASSERT_TRUE(lcl_dict_peek(dict, "k") == s);
+  ASSERT_TRUE(lcl_dict_peek(dict, "nope") == NULL);
+  ASSERT_TRUE(lcl_cell_peek(cell) == s && lcl_cell_peek(s) == NULL);
+
+  while (lcl_dict_next(dict, &it, &key, &v) == LCL_OK) {
+    seen += strcmp(key, "k") == 0 && v == s;
+  }
+  ASSERT_TRUE(seen == 1);
+  ASSERT_TRUE(s->refc == rc);
+
+  /* a packed list has nothing to lend */
+  ASSERT_TRUE(ints->as.list.kind == LCL_LIST_INTS);
+  ASSERT_TRUE(lcl_list_peek(ints, 0) == NULL);
+
+  lcl_ref_dec(cell);
+  lcl_ref_dec(dict);
+  lcl_ref_dec(ints);
+  lcl_ref_dec(list);
+  lcl_ref_dec(n);
+  lcl_ref_dec(s);
+
+  return 1;
+}
+
+static int test_dispatch_allocs(void) {
+  lcl_interp *interp = lcl_interp_new();
+  lcl_interp *prev;
+  lcl_memory_stats st0, st1, st2;
+  lcl_value *v = NULL;
+  lcl_value **a, **b;
+  int ok;
+
+  ASSERT_TRUE(interp != NULL);
+  lcl_register_core(interp);
+
+  /* slices stay put while later ones spill into another block */
+  prev = lcl_interp_enter(interp);
+  a = lcl_stack_push(interp, LCL_STACK_BLOCK - 10);
+  b = lcl_stack_push(interp, 20);
+  ASSERT_TRUE(a != NULL && b != NULL && a[0] == NULL && b[19] == NULL);
+  lcl_stack_pop(interp, 20);
+  lcl_stack_pop(interp, LCL_STACK_BLOCK - 10);
+
+  lcl_interp_memory_stats(interp, &st0);
+  ASSERT_TRUE(lcl_stack_push(interp, LCL_STACK_BLOCK - 10) == a);
+  ASSERT_TRUE(lcl_stack_push(interp, 20) == b);
+  lcl_stack_pop(interp, 20);
+  lcl_stack_pop(interp, LCL_STACK_BLOCK - 10);
+  lcl_interp_memory_stats(interp, &st1);
+  ASSERT_TRUE(st1.allocs == st0.allocs);
+
+  /* a spare block too small for a slice goes with the spares behind it,
+   * leaving only the block that fits */
+  lcl_interp_memory_stats(interp, &st0);
+  ASSERT_TRUE(lcl_stack_push(interp, LCL_STACK_BLOCK - 10) == a);
+  ASSERT_TRUE(lcl_stack_push(interp, LCL_STACK_BLOCK) != NULL);
+  ASSERT_TRUE(lcl_stack_push(interp, LCL_STACK_BLOCK) != NULL);
+  lcl_stack_pop(interp, LCL_STACK_BLOCK);
+  lcl_stack_pop(interp, LCL_STACK_BLOCK);
+  lcl_interp_memory_stats(interp, &st1);
+  ASSERT_TRUE(lcl_stack_push(interp, 300) != NULL);
+  lcl_stack_pop(interp, 300);
+  lcl_stack_pop(interp, LCL_STACK_BLOCK - 10);
+  lcl_interp_memory_stats(interp, &st2);
+  lcl_interp_leave(prev);
+  ASSERT_TRUE(st1.live > st0.live && st2.live - st0.live < st1.live - st0.live);
+
+  /* once warm, calls and loops take nothing from the heap */
+  ASSERT_TRUE(eval_expect(interp,
+                          "proc add3 {a b c} { + $a $b $c }; "
+                          "proc run {n} { var acc 0; for-range i 0 $n { "
+                          "set! acc [add3 $acc $i 1]; "
+                          "if [== [% $i 2] 0] { set! acc [- $acc 1] } }; "
+                          "$acc }",
+                          ""));
+  ASSERT_TRUE(eval_expect(interp, "run 1000", "500000"));
+
+  lcl_interp_memory_stats(interp, &st0);
+  ok = lcl_eval_string(interp, "run 1000", &v) == LCL_RC_OK &&
+       v->as.i == 500000;
+  lcl_interp_memory_stats(interp, &st1);
+  ok = ok && st1.allocs == st0.allocs;
+  lcl_ref_dec(v);
+
+  lcl_interp_free(interp);
+  return ok;
+}
+
+/* Passes through to malloc, counting blocks held in *ctx */
+static void *count_alloc(void *ctx, size_t n) {
+  void *p = malloc(n);
+
+  if (p) (*(long *)ctx)++;
+  return p;
+}
+
+static void *count_resize(void *ctx, void *p, size_t n) {
+  (void)ctx;
+  return realloc(p, n);
+}
+
+static void count_release(void *ctx, void *p) {
+  (*(long *)ctx)--;
+  free(p);
+}
+
+static int test_memory_limits(void) {
+  static long held;  /* may be used after the interp goes */
+  lcl_allocator a;
+  lcl_memory_stats st;
+  lcl_interp *interp, *other;
+  lcl_value *v = NULL;
+  int rc, ok;
+
+  a.alloc = count_alloc;
+  a.resize = count_resize;
+  a.release = count_release;
+  a.ctx = &held;
+  a.limit = 0;
+
+  /* without a limit it only keeps count */
+  other = lcl_interp_new();
+  interp = lcl_interp_new_with_allocator(&a);
+  ASSERT_TRUE(other != NULL && interp != NULL);
+  lcl_register_core(other);
+  lcl_register_core(interp);
+  ASSERT_TRUE(eval_expect(interp,
+                          "len [String::split [String::join [list a b c] ,] ,]",
+                          "3"));
+  ASSERT_TRUE(eval_expect(interp, "let tenant_name 1", "1"));
+  ASSERT_TRUE(eval_expect(other, "let tenant_name 2", "2"));
+
+  lcl_interp_memory_stats(interp, &st);
+  ASSERT_TRUE(held > 0 && st.live > 0 && st.peak >= st.live &&
+              st.limit == 0 && st.failures == 0 && st.allocs > 0);
+  lcl_interp_free(interp);
+
+  /* everything it took goes back with it, even the name the other
+   * interpreter still holds */
+  ASSERT_TRUE(held == 0);
+  lcl_interp_free(other);
+
+  /* a runaway script stops at the limit and the interpreter goes on */
+  a.limit = 64 * 1024;
+  interp = lcl_interp_new_with_allocator(&a);
+  ASSERT_TRUE(interp != NULL);
+  lcl_register_core(interp);
+
+  rc = lcl_eval_string(interp,
+                       "proc fill {} { var xs [list]; "
+                       "for-range i 0 1000000 { "
+                       "set! xs [List::push $xs \"item $i\"] }; len $xs }; "
+                       "fill",
+                       &v);
+  lcl_ref_dec(v);
+
+  lcl_interp_memory_stats(interp, &st);
+  ok = rc == LCL_RC_ERR && st.failures > 0 && st.peak <= st.limit &&
+       eval_expect(interp, "+ 1 2", "3");
+
+  lcl_interp_free(interp);
+  return ok;
+}
+
+static int test_number_formatting(void) {
+  lcl_value *vals[8];
+  const char *want[8] = {
+    "-9223372036854775808", "123456789", "0.1", "0.3333333333333333", "-2.5e-07",
+    "5e-324", "-1e-310", "2.2250738585072014e-308"
+  };
+  int ok = 1;
+  int i;
+
+  vals[0] = lcl_int_new(LONG_MIN);
+  vals[1] = lcl_int_new(123456789L);
+  vals[2] = lcl_float_new(0.1);
+  vals[3] = lcl_float_new(1.0 / 3.0);
+  vals[4] = lcl_float_new(-2.5e-7);
+  vals[5] = lcl_float_new(4.9406564584124654e-324);  /* least subnormal */
+  vals[6] = lcl_float_new(-1e-310);
+  vals[7] = lcl_float_new(DBL_MIN);
+
+  for (i = 0; i < 8; i++) {
+    /* numbers get their string only when asked */
+    ok = ok && vals[i]->str_repr == NULL &&
+         strcmp(lcl_value_to_string(vals[i]), want[i]) == 0;
+    lcl_ref_dec(vals[i]);
+  }
+
+  return ok;
+}
+
+static int test_string_numbers_cached(void) {
+  lcl_value *num = lcl_string_new("12");
+  lcl_value *word = lcl_string_new("abc");
+  long i = 0;
+  double f = 0;
+  int ok;
+
+  ok = lcl_value_to_int(num, &i) == LCL_OK && i == 12 &&
+       lcl_value_to_double(num, &f) == LCL_OK && f == 12.0 &&
+       num->as.str.num == LCL_STR_INT &&
+       lcl_value_to_int(word, &i) != LCL_OK &&
+       lcl_value_to_double(word, &f) != LCL_OK &&
+       word->as.str.num == (LCL_STR_NOT_INT | LCL_STR_NOT_FLOAT);
+
+  /* a cached answer is the same answer */
+  ok = ok && lcl_value_to_int(num, &i) == LCL_OK && i == 12 &&
+       lcl_value_to_int(word, &i) != LCL_OK;
+
+  lcl_ref_dec(num);
+  lcl_ref_dec(word);
+
+  return ok;
+}
+
+static int test_short_strings_inline(void) {
+  lcl_interp *interp = lcl_interp_new();
+  lcl_value *s = lcl_string_new("hello");
+  lcl_value *big = lcl_int_new(-1234567890123L);
+  lcl_value *f = lcl_float_new(0.1);
+  lcl_value *v = NULL;
+  char longer[LCL_SSO_MAX + 2];
+  size_t n = 0;
+  int ok;
+
+  memset(longer, 'x', sizeof(longer) - 1);
+  longer[sizeof(longer) - 1] = '\0';
+
+  ASSERT_TRUE(interp != NULL);
+  lcl_register_core(interp);
+
+  /* text kept in the value, number forms included, length known */
+  ok = s->str_repr == s->as.str.sso && s->as.str.len == 5 &&
+       strcmp(lcl_value_to_string(big), "-1234567890123") == 0 &&
+       big->str_repr == big->as.str.sso && big->as.i == -1234567890123L &&
+       strcmp(lcl_value_to_string(f), "0.1") == 0 && f->as.f == 0.1 &&
+       strcmp(lcl_value_to_string_n(s, &n), "hello") == 0 && n == 5;
+  lcl_ref_dec(s);
+  lcl_ref_dec(big);
+  lcl_ref_dec(f);
+
+  /* one byte more goes to the heap */
+  s = lcl_string_new(longer);
+  ok = ok && s->str_repr != s->as.str.sso &&
+       s->as.str.len == LCL_SSO_MAX + 1 && strcmp(s->str_repr, longer) == 0;
+  lcl_ref_dec(s);
+
+  ok = ok &&
+       eval_expect(interp, "get \"hello\" 1", "e") &&
+       eval_expect(interp, "len [String::split \"a,bb,ccc\" \",\"]", "3") &&
+       eval_expect(interp, "len abcdefghijklmnopqrstuvwxyz", "26");
+
+  ASSERT_TRUE(lcl_eval_string(interp, "String::upper abcdefghijklmnopqrstuvwxyz",
+                              &v) == LCL_RC_OK);
+  ok = ok && strcmp(lcl_value_to_string_n(v, &n),
+                    "ABCDEFGHIJKLMNOPQRSTUVWXYZ") == 0 && n == 26;
+  lcl_ref_dec(v);
+
+  lcl_interp_free(interp);
+  return ok;
+}
+
+static int test_packed_lists(void) {
+  lcl_value *list = lcl_list_new();
+  lcl_value *big = lcl_int_new(5000000000L);
+  lcl_value *word = lcl_string_new("x");
+  lcl_value *got = NULL;
+  int ok;
+
+  /* ints stay bare until something else is stored */
+  ok = lcl_list_push(&list, big) == LCL_OK &&
+       lcl_list_push(&list, big) == LCL_OK &&
+       list->as.list.kind == LCL_LIST_INTS &&
+       lcl_list_get(list, 1, &got) == LCL_OK && got != big &&
+       got->type == LCL_INT && got->as.i == 5000000000L &&
+       strcmp(lcl_value_to_string(list), "5000000000 5000000000") == 0;
+  lcl_ref_dec(got);
+
+  ok = ok && lcl_list_set(&list, 0, word) == LCL_OK &&
+       list->as.list.kind == LCL_LIST_VALUES &&
+       strcmp(lcl_value_to_string(list), "x 5000000000") == 0;
+
+  lcl_ref_dec(list);
+  lcl_ref_dec(big);
+  lcl_ref_dec(word);
+
+  return ok;
+}
+
+static int test_list_kernels(void) {
+  lcl_interp *interp = lcl_interp_new();
+  lcl_value *v = NULL;
+  double x[37], y[37], sum, dot, mn, mx, add[37], want[37];
+  double zero = 0.0, nan, r;
+  int level, i, j, ok;
+
+  ASSERT_TRUE(interp != NULL);
+  lcl_register_core(interp);
+
+  ok = eval_expect(interp, "List::sum [list 1 2 3 4]", "10") &&
+       eval_expect(interp, "List::sum [list 1 2.5 3]", "6.5") &&
+       eval_expect(interp, "List::sum [list]", "0") &&
+       eval_expect(interp, "List::min [list 5 2 9]", "2") &&
+       eval_expect(interp, "List::max [list 5 2.5 9.5]", "9.5") &&
+       eval_expect(interp, "List::mean [list 1 2 3 4]", "2.5") &&
+       eval_expect(interp, "List::dot [list 1 2 3] [list 4 5 6]", "32") &&
+       eval_expect(interp, "List::add [list 1 2 3] [list 4 5 6]", "5 7 9") &&
+       eval_expect(interp, "List::mul [list 1 2 3] [list 4 5.5 6]",
+                   "4 11 18") &&
+       eval_expect(interp, "List::sum [list 9223372036854775807 1]",
+                   "9.223372036854776e+18") &&
+       eval_expect(interp, "List::max [list 1 nan 3]", "nan") &&
+       eval_expect(interp, "List::min [list 1 2 3 4 5 6 7 nan]", "nan");
+
+  ok = ok && lcl_eval_string(interp, "List::min [list]", &v) != LCL_RC_OK &&
+       lcl_eval_string(interp, "List::dot [list 1] [list 1 2]", &v) !=
+           LCL_RC_OK &&
+       lcl_eval_string(interp, "List::sum [list a b]", &v) != LCL_RC_OK;
+
+  lcl_interp_free(interp);
+
+  /* every kernel level gives the same answers, odd tails included; the
+   * values are exact in binary so summation order cannot matter */
+  for (i = 0; i < 37; i++) {
+    x[i] = (double)(i * 7 % 11) - 4.5;
+    y[i] = (double)(i % 5) * 0.25;
+  }
+
+  lcl_vec_select(LCL_VEC_SCALAR);
+  sum = lcl_vec_sum(x, 37);
+  dot = lcl_vec_dot(x, y, 37);
+  mn = lcl_vec_min(x, 37);
+  mx = lcl_vec_max(x, 37);
+  lcl_vec_add(want, x, y, 37);
+
+  for (level = LCL_VEC_SSE2; level <= LCL_VEC_AVX2; level++) {
+    if (!lcl_vec_select(level)) continue;
+
+    lcl_vec_add(add, x, y, 37);
+
+    ok = ok && lcl_vec_sum(x, 37) == sum && lcl_vec_dot(x, y, 37) == dot &&
+         lcl_vec_min(x, 37) == mn && lcl_vec_max(x, 37) == mx &&
+         memcmp(add, want, sizeof(add)) == 0;
+  }
+
+  /* a NaN anywhere gives the first NaN, at every level; the two differ
+   * in sign so it shows which one came back */
+  nan = zero / zero;
+
+  for (level = LCL_VEC_SCALAR; level <= LCL_VEC_AVX2; level++) {
+    if (!lcl_vec_select(level)) continue;
+
+    for (j = 0; j < 37; j++) {
+      memcpy(want, x, sizeof(x));
+      want[j] = nan;
+      if (j + 3 < 37) want[j + 3] = -nan;
+
+      r = lcl_vec_min(want, 37);
+      ok = ok && r != r && memcmp(&r, &want[j], sizeof(r)) == 0;
+      r = lcl_vec_max(want, 37);
+      ok = ok && r != r && memcmp(&r, &want[j], sizeof(r)) == 0;
+      r = lcl_vec_min(want + j, 1);
+      ok = ok && r != r;
+    }
+  }
+
+  if (!lcl_vec_select(LCL_VEC_AVX2) && !lcl_vec_select(LCL_VEC_SSE2)) {
+    lcl_vec_select(LCL_VEC_SCALAR);
+  }
+
+  return ok;
+}
+
+static int test_symbols_interned(void) {
+  const char *a = lcl_sym_intern("alpha");
+  const char *b = lcl_sym_intern_n("alphabet", 5);
+  hash_table *ht = hash_table_new();
+  lcl_value *v = lcl_int_new(1);
+  lcl_value *got = NULL;
+  const char *c;
+  hash_key k;
+  size_t before;
+  int ok;
+
+  ASSERT_TRUE(a != NULL && a == b);
+  ASSERT_TRUE(lcl_sym_hash(a) == hash_table_hash("alpha"));
+
+  /* keys put by plain string are found by symbol, and vice versa */
+  k = hash_key_sym(a);
+  ok = hash_table_put(ht, "alpha", v) &&
+       hash_table_get_key(ht, &k, &got) && got == v;
+  lcl_ref_dec(got);
+
+  hash_table_free(ht);
+
+  /* a table put by symbol only takes a reference, and the symbol goes
+   * with the last one; interning it again makes it anew */
+  before = lcl_sym_count();
+  c = lcl_sym_intern("gamma");
+  k = hash_key_sym(c);
+  ht = hash_table_new();
+  ok = ok && hash_table_put_key(ht, &k, v) && lcl_sym_count() == before + 1;
+  lcl_sym_release(c);
+  ok = ok && hash_table_get(ht, "gamma", &got) && got == v;
+  lcl_ref_dec(got);
+  hash_table_free(ht);
+  ok = ok && lcl_sym_count() == before;
+
+  c = lcl_sym_intern("gamma");
+  ok = ok && c != NULL && lcl_sym_count() == before + 1;
+  lcl_sym_release(c);
+
+  lcl_ref_dec(v);
+  lcl_sym_release(a);
+  lcl_sym_release(b);
+
+  return ok;
+}
+
+static int test_hash_key(void) {
+  hash_table *ht = hash_table_new();
+  lcl_value *v = lcl_int_new(2);
+  lcl_value *got = NULL;
+  hash_key k = hash_key_make("beta");
+  int ok;
+
+  ASSERT_TRUE(k.len == 4 && k.hash == hash_table_hash("beta"));
+
+  ok = hash_table_put_key(ht, &k, v) && hash_table_get(ht, "beta", &got) &&
+       got == v;
+  lcl_ref_dec(got);
+
+  ok = ok && hash_table_delete_key(ht, &k) &&
+       !hash_table_get_key(ht, &k, &got);
+
+  hash_table_free(ht);
+  lcl_ref_dec(v);
+
+  return ok;
+}
+
+static int write_text(const char *path, const char *text) {
+  FILE *f = fopen(path, "w");
+
+  if (!f) return 0;
+
+  fputs(text, f);
+  return fclose(f) == 0;
+}
+
+static long file_size(const char *path) {
+  FILE *f = fopen(path, "rb");
+  long n;
+
+  if (!f) return -1;
+
+  n = fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+  fclose(f);
+  return n;
+}
+
+static int eval_file_expect(const char *path, const char *expect) {
+  lcl_interp *interp = lcl_interp_new();
+  lcl_value *v = NULL;
+  int ok;
+
+  lcl_register_core(interp);
+  ok = lcl_eval_file(interp, path, &v) == LCL_RC_OK &&
+       strcmp(lcl_value_to_string(v), expect) == 0;
+
+  if (!ok) {
+    printf("    %s: got %s, expect %s\n", path,
+           v ? lcl_value_to_string(v) : "(error)", expect);
+  }
+
+  lcl_ref_dec(v);
+  lcl_interp_free(interp);
+  return ok;
+}
+
+static int test_image_round_trip(void) {
+  const char *src = "lcl-test-image.lcl";
+  const char *img = "lcl-test-image.lclc";
+  int ok;
+
+  ASSERT_TRUE(write_text(src,
+    "proc f {x} { if [> $x 1] { + $x [f [- $x 1]] } else { return 1 } }\n"
+    "f 4\n"));
+  ASSERT_TRUE(lcl_compile_file(src, NULL) == LCL_OK);
+
+  /* the image runs on its own, and in place of its unchanged source */
+  ok = eval_file_expect(img, "10") && eval_file_expect(src, "10");
+
+  /* once the source changes, the stale image is ignored, even when it
+   * keeps its length */
+  ok = ok && write_text(src, "+ 1 1\n") && eval_file_expect(src, "2");
+  ok = ok && lcl_compile_file(src, NULL) == LCL_OK &&
+       write_text(src, "+ 1 2\n") && eval_file_expect(src, "3");
+
+  /* nested bodies do not repeat their text at each level */
+  ok = ok &&
+       write_text(src,
+                  "proc g {} { if 1 { if 1 { if 1 { if 1 { return "
+                  "{the quick brown fox jumps over the lazy dog, "
+                  "the quick brown fox jumps over the lazy dog} "
+                  "} } } } }\n"
+                  "String::upper [g]\n") &&
+       lcl_compile_file(src, NULL) == LCL_OK &&
+       file_size(img) < file_size(src) * 3 &&
+       eval_file_expect(img,
+                        "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG, "
+                        "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG");
+
+  remove(src);
+  remove(img);
+  return ok;
+}
+
 int run_test(void) {
   int total = 0;
   int passed = 0;
@@ -276,6 +1437,31 @@ int run_test(void) {
   RUN(test_quotes_and_subst);
   RUN(test_nested_subcmd);
   RUN(test_unmatched_brace_error);
+  RUN(test_compile_cache_hits);
+  RUN(test_body_cache);
+  RUN(test_call_site_cache_invalidation);
+  RUN(test_control_flow);
+  RUN(test_slot_layouts);
+  RUN(test_literals_shared);
+  RUN(test_program_arena);
+  RUN(test_constants_shared);
+  RUN(test_integer_arithmetic);
+  RUN(test_expr);
+  RUN(test_fused_conditions);
+  RUN(test_for_range);
+  RUN(test_value_slab);
+  RUN(test_frame_reuse);
+  RUN(test_borrowed_accessors);
+  RUN(test_dispatch_allocs);
+  RUN(test_memory_limits);
+  RUN(test_number_formatting);
+  RUN(test_string_numbers_cached);
+  RUN(test_short_strings_inline);
+  RUN(test_packed_lists);
+  RUN(test_list_kernels);
+  RUN(test_symbols_interned);
+  RUN(test_hash_key);
+  RUN(test_image_round_trip);
 
   printf("\n%d/%d tests passed\n", passed, total);
   return (passed == total) ? 0 : 1;  